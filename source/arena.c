@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+struct arena_block {
+    arena_block* next;
+    size_t size;
+    size_t used;
+    size_t pad;
+    unsigned char data[];
+};
+
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+void arena_init(arena* a, size_t block_size)
+{
+    memset(a, 0, sizeof(*a));
+    a->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+}
+
+static arena_block* arena_new_block(arena* a, size_t size)
+{
+    if(size < a->block_size) size = a->block_size;
+
+    arena_block* block = malloc(sizeof(arena_block) + size);
+    if(block == NULL) return NULL;
+
+    block->next = a->head;
+    block->size = size;
+    block->used = 0;
+    a->head = block;
+    a->reserved += size;
+
+    return block;
+}
+
+void* arena_alloc(arena* a, size_t size)
+{
+    arena_block* block = a->head;
+
+    size = ARENA_ROUND(size ? size : 1);
+
+    if(block == NULL || block->size - block->used < size)
+    {
+        block = arena_new_block(a, size);
+        if(block == NULL) return NULL;
+    }
+
+    void* ptr = &block->data[block->used];
+    block->used += size;
+
+    a->used += size;
+    if(a->used > a->peak) a->peak = a->used;
+
+    return ptr;
+}
+
+void* arena_calloc(arena* a, size_t size)
+{
+    void* ptr = arena_alloc(a, size);
+    if(ptr) memset(ptr, 0, size);
+
+    return ptr;
+}
+
+void* arena_realloc(arena* a, void* ptr, size_t old_size, size_t new_size)
+{
+    arena_block* block = a->head;
+
+    if(ptr == NULL) return arena_alloc(a, new_size);
+
+    old_size = ARENA_ROUND(old_size);
+    new_size = ARENA_ROUND(new_size);
+
+    // the latest allocation can grow in place
+    if(block && (unsigned char*)ptr + old_size == &block->data[block->used] && block->size - block->used >= new_size - old_size && new_size >= old_size)
+    {
+        block->used += new_size - old_size;
+        a->used += new_size - old_size;
+        if(a->used > a->peak) a->peak = a->used;
+
+        return ptr;
+    }
+
+    void* new_ptr = arena_alloc(a, new_size);
+    if(new_ptr) memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+
+    return new_ptr;
+}
+
+arena_mark arena_save(arena* a)
+{
+    arena_mark mark;
+
+    mark.block = a->head;
+    mark.block_used = a->head ? a->head->used : 0;
+    mark.used = a->used;
+
+    return mark;
+}
+
+void arena_restore(arena* a, arena_mark mark)
+{
+    while(a->head && a->head != mark.block)
+    {
+        arena_block* block = a->head;
+
+        a->head = block->next;
+        a->reserved -= block->size;
+        free(block);
+    }
+
+    if(a->head) a->head->used = mark.block_used;
+    a->used = mark.used;
+}
+
+void arena_reset(arena* a)
+{
+    // keep the first block around for the next session, unless it was sized for one large allocation
+    while(a->head && (a->head->next || a->head->size != a->block_size))
+    {
+        arena_block* block = a->head;
+
+        a->head = block->next;
+        a->reserved -= block->size;
+        free(block);
+    }
+
+    if(a->head) a->head->used = 0;
+    a->used = 0;
+}
+
+void arena_free(arena* a)
+{
+    arena_reset(a);
+
+    if(a->head)
+    {
+        a->reserved -= a->head->size;
+        free(a->head);
+        a->head = NULL;
+    }
+}
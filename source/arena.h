@@ -0,0 +1,42 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE 0x40000
+#define ARENA_ALIGN 8
+
+typedef struct arena_block arena_block;
+
+// Bump allocator for one install session. Allocations are never freed one by one: a scratch
+// scope releases everything allocated since its mark, and arena_reset() releases everything.
+// An arena is not thread-safe, each one is meant to be used by a single thread at a time.
+typedef struct {
+    arena_block* head;
+    size_t block_size;
+    size_t used;
+    size_t peak;
+    size_t reserved;
+} arena;
+
+typedef struct {
+    arena_block* block;
+    size_t block_used;
+    size_t used;
+} arena_mark;
+
+void arena_init(arena* a, size_t block_size);
+// Returns ARENA_ALIGN-aligned memory, or NULL when the heap is exhausted.
+void* arena_alloc(arena* a, size_t size);
+void* arena_calloc(arena* a, size_t size);
+// Grows ptr in place when it's the latest allocation, otherwise copies it.
+void* arena_realloc(arena* a, void* ptr, size_t old_size, size_t new_size);
+
+arena_mark arena_save(arena* a);
+void arena_restore(arena* a, arena_mark mark);
+
+// Releases everything, keeping the first block for the next session.
+void arena_reset(arena* a);
+void arena_free(arena* a);
+
+#endif // _ARENA_H_
@@ -0,0 +1,279 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <3ds.h>
+
+#include "backup.h"
+#include "crc32c.h"
+#include "install.h"
+#include "lz4.h"
+#include "saveio.h"
+#include "trace.h"
+
+typedef struct {
+    FILE* f;
+    u64 offset;
+    u8* buffer;
+    u8* packed;
+    u32* table;
+    backup_entry* entries;
+    u32 count;
+} backup_writer;
+
+void backup_path(u64 program_id, char* out, size_t out_size)
+{
+    snprintf(out, out_size, "%s/%016llX.bak", BACKUP_DIR, (unsigned long long)program_id);
+}
+
+static Result backup_file(backup_writer* w, const char* path, u64 size)
+{
+    if(w->count == BACKUP_MAX_FILES) return 5;
+
+    backup_entry* entry = &w->entries[w->count];
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->path, path, sizeof(entry->path) - 1);
+    entry->offset = w->offset;
+    entry->size = size;
+
+    int span = trace_begin("backup_file", path);
+    Handle file = 0;
+    Result ret = saveio_open(&file, path, FS_OPEN_READ);
+    if(R_FAILED(ret))
+    {
+        trace_end(span, 0);
+        return ret;
+    }
+
+    install_progress.done = 0;
+    install_progress.total = size;
+
+    u32 crc = 0;
+    for(u64 offset = 0; !ret && offset < size; offset += BACKUP_BLOCK_SIZE)
+    {
+        u32 bytes_read = 0;
+        u32 chunk = size - offset > BACKUP_BLOCK_SIZE ? BACKUP_BLOCK_SIZE : size - offset;
+
+        ret = saveio_read(file, &bytes_read, offset, w->buffer, chunk);
+        if(R_SUCCEEDED(ret) && bytes_read != chunk) ret = -1;
+        if(ret) break;
+
+        crc = crc32c_update(crc, w->buffer, chunk);
+
+        // blocks that don't shrink are stored, so a restore never needs more than BACKUP_BLOCK_SIZE for one
+        u32 packed = lz4_compress(w->buffer, chunk, w->packed, w->table);
+        u32 header = packed;
+        const u8* data = w->packed;
+        if(packed >= chunk)
+        {
+            packed = chunk;
+            header = chunk | BACKUP_BLOCK_STORED;
+            data = w->buffer;
+        }
+
+        if(fwrite(&header, sizeof(header), 1, w->f) != 1 || fwrite(data, 1, packed, w->f) != packed) ret = 2;
+
+        w->offset += sizeof(header) + packed;
+        entry->packed_size += sizeof(header) + packed;
+        install_progress.done = offset + chunk;
+        if(job_cancelled()) ret = INSTALL_CANCELLED;
+    }
+
+    saveio_close(file);
+    trace_end(span, entry->packed_size);
+    if(ret) return ret;
+
+    entry->crc = crc;
+    w->count++;
+    return 0;
+}
+
+static Result backup_walk(const char* path, bool directory, u64 size, void* arg)
+{
+    if(directory) return saveio_list(path, backup_walk, arg);
+
+    return backup_file(arg, path, size);
+}
+
+Result backup_save(const char* path, u64 program_id)
+{
+    char tmp_path[256];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    mkdir("sdmc:/salt_sploit_installer", 0777);
+    mkdir(BACKUP_DIR, 0777);
+
+    arena_mark scratch = arena_save(&install_arena);
+    backup_writer w;
+    memset(&w, 0, sizeof(w));
+    w.buffer = arena_alloc(&install_arena, BACKUP_BLOCK_SIZE);
+    w.packed = arena_alloc(&install_arena, LZ4_BOUND(BACKUP_BLOCK_SIZE));
+    w.table = arena_alloc(&install_arena, sizeof(u32) * LZ4_TABLE_SIZE);
+    w.entries = arena_alloc(&install_arena, sizeof(backup_entry) * BACKUP_MAX_FILES);
+    if(!w.buffer || !w.packed || !w.table || !w.entries)
+    {
+        arena_restore(&install_arena, scratch);
+        return 3;
+    }
+
+    w.f = fopen(tmp_path, "wb");
+    if(w.f == NULL)
+    {
+        arena_restore(&install_arena, scratch);
+        return 1;
+    }
+
+    backup_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BACKUP_MAGIC, sizeof(header.magic));
+    header.program_id = program_id;
+
+    Result ret = fwrite(&header, sizeof(header), 1, w.f) == 1 ? 0 : 2;
+    w.offset = sizeof(header);
+
+    if(!ret)
+    {
+        ret = saveio_open_archive();
+        if(R_SUCCEEDED(ret))
+        {
+            ret = saveio_list("/", backup_walk, &w);
+            saveio_close_archive();
+        }
+    }
+
+    if(!ret)
+    {
+        backup_footer footer = { w.offset, w.count, BACKUP_INDEX_MAGIC };
+        if(fwrite(w.entries, sizeof(backup_entry), w.count, w.f) != w.count || fwrite(&footer, sizeof(footer), 1, w.f) != 1) ret = 2;
+    }
+
+    if(fclose(w.f) && !ret) ret = 2;
+    arena_restore(&install_arena, scratch);
+
+    // the previous backup stays until this one is complete
+    if(ret) remove(tmp_path);
+    else
+    {
+        remove(path);
+        if(rename(tmp_path, path)) ret = 2;
+    }
+
+    return ret;
+}
+
+static Result read_index(FILE* f, backup_entry* entries, u32* count)
+{
+    backup_header header;
+    backup_footer footer;
+
+    if(fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, BACKUP_MAGIC, sizeof(header.magic))) return 4;
+
+    if(fseek(f, -(long)sizeof(footer), SEEK_END) || fread(&footer, sizeof(footer), 1, f) != 1) return 4;
+    if(footer.magic != BACKUP_INDEX_MAGIC || footer.count > BACKUP_MAX_FILES) return 4;
+
+    if(fseek(f, footer.index_offset, SEEK_SET) || fread(entries, sizeof(backup_entry), footer.count, f) != footer.count) return 4;
+
+    for(u32 i = 0; i < footer.count; i++) entries[i].path[sizeof(entries[i].path) - 1] = 0;
+
+    *count = footer.count;
+    return 0;
+}
+
+Result backup_list(const char* path, backup_entry* entries, u32* count)
+{
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    Result ret = read_index(f, entries, count);
+    fclose(f);
+
+    return ret;
+}
+
+// An empty file can't go through write_savedata().
+static Result restore_empty_file(const char* path)
+{
+    Result ret = saveio_open_archive();
+    if(R_FAILED(ret)) return ret;
+
+    saveio_remove(path);
+    ret = saveio_create(path, 0);
+    if(R_SUCCEEDED(ret)) ret = saveio_commit();
+
+    saveio_close_archive();
+    return ret;
+}
+
+static Result restore_file(FILE* f, const backup_entry* entry, u8* packed)
+{
+    if(entry->size == 0) return restore_empty_file(entry->path);
+
+    u8* data = malloc(entry->size);
+    if(data == NULL) return 3;
+
+    Result ret = fseek(f, entry->offset, SEEK_SET) ? 4 : 0;
+
+    u32 crc = 0;
+    for(u32 done = 0; !ret && done < entry->size;)
+    {
+        u32 header;
+        if(fread(&header, sizeof(header), 1, f) != 1)
+        {
+            ret = 4;
+            break;
+        }
+
+        u32 packed_size = header & ~BACKUP_BLOCK_STORED;
+        u32 chunk = entry->size - done > BACKUP_BLOCK_SIZE ? BACKUP_BLOCK_SIZE : entry->size - done;
+        if(packed_size > LZ4_BOUND(BACKUP_BLOCK_SIZE) || fread(packed, 1, packed_size, f) != packed_size)
+        {
+            ret = 4;
+            break;
+        }
+
+        if(header & BACKUP_BLOCK_STORED)
+        {
+            if(packed_size != chunk) ret = 4;
+            else memcpy(data + done, packed, chunk);
+        }
+        else if(lz4_decompress(packed, packed_size, data + done, chunk) != (int)chunk) ret = 4;
+
+        if(!ret) crc = crc32c_update(crc, data + done, chunk);
+        done += chunk;
+    }
+
+    if(!ret && crc != entry->crc) ret = 6;
+    if(!ret) ret = write_savedata(entry->path, data, entry->size);
+
+    free(data);
+    return ret;
+}
+
+Result backup_restore(const char* path, int index)
+{
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    // this runs outside of an install, so it allocates from the heap
+    backup_entry* entries = malloc(sizeof(backup_entry) * BACKUP_MAX_FILES);
+    u8* packed = malloc(LZ4_BOUND(BACKUP_BLOCK_SIZE));
+    u32 count = 0;
+
+    Result ret = entries && packed ? read_index(f, entries, &count) : 3;
+    if(!ret && index >= (int)count) ret = 5;
+
+    for(u32 i = index < 0 ? 0 : index; !ret && i < count; i++)
+    {
+        ret = restore_file(f, &entries[i], packed);
+        if(index >= 0) break;
+    }
+
+    if(!ret) status_set("Restored %lu file(s) from\n    %s", (unsigned long)(index < 0 ? count : 1), path);
+
+    free(packed);
+    free(entries);
+    fclose(f);
+
+    return ret;
+}
@@ -0,0 +1,55 @@
+#ifndef _BACKUP_H_
+#define _BACKUP_H_
+
+#include <3ds.h>
+
+#define BACKUP_DIR "sdmc:/salt_sploit_installer/backup"
+#define BACKUP_MAGIC "SALTBAK1"
+#define BACKUP_INDEX_MAGIC 0x58444E49 // "INDX"
+#define BACKUP_MAX_FILES 64
+
+// Files are compressed in blocks of this size, which is also all a restore reads at once.
+#define BACKUP_BLOCK_SIZE 0x10000
+// Set in a block's size word when the block is stored as is.
+#define BACKUP_BLOCK_STORED 0x80000000
+
+// A backup is:
+//   backup_header
+//   every file's blocks, each a u32 size (| BACKUP_BLOCK_STORED) followed by its LZ4 or raw data
+//   backup_entry for every file
+//   backup_footer
+// so a single file can be restored by reading the footer, its entry and its blocks only.
+typedef struct {
+    char magic[8];
+    u64 program_id;
+} backup_header;
+
+typedef struct {
+    char path[256];
+    u64 offset;
+    u32 size;
+    u32 packed_size;
+    u32 crc;
+    u32 reserved;
+} backup_entry;
+
+typedef struct {
+    u64 index_offset;
+    u32 count;
+    u32 magic;
+} backup_footer;
+
+// Where the backup of program_id goes, one per title.
+void backup_path(u64 program_id, char* out, size_t out_size);
+
+// Streams every file of the save archive into a backup at path, replacing the previous one only once it's complete.
+// Allocates from install_arena.
+Result backup_save(const char* path, u64 program_id);
+
+// Reads the backup's index, entries is BACKUP_MAX_FILES long.
+Result backup_list(const char* path, backup_entry* entries, u32* count);
+
+// Writes file index of the backup, or every file when index is -1, back to the save.
+Result backup_restore(const char* path, int index);
+
+#endif // _BACKUP_H_
@@ -21,6 +21,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "blz.h"
+
 /*----------------------------------------------------------------------------*/
 #define CMD_DECODE    0x00       // decode
 #define CMD_ENCODE    0x01       // encode
@@ -37,39 +39,210 @@
 #define RAW_MAXIM     0x00FFFFFF // 3-bytes length, 16MB - 1
 
 #define BLZ_MINIM     0x00000004 // header only (empty RAW file)
+#define BLZ_PROGRESS  0x00001000 // bytes between progress callbacks
+
 #define BLZ_MAXIM     0x01400000 // 0x0120000A, padded to 20MB:
                                  // * length, RAW_MAXIM
                                  // * flags, (RAW_MAXIM + 7) / 8
                                  // * header, 11
                                  // 0x00FFFFFF + 0x00200000 + 12 + padding
 
+/*----------------------------------------------------------------------------*/
+// Kernels for the match search, BLZ_Invert and the buffer passes, picked at
+// compile time: AVX2 or SSE2 on a host build, 32-bit words with the ARMv6
+// REV/CLZ and SIMD instructions on the ARM11 (or anywhere with BLZ_WORD), and
+// the original byte loops with BLZ_SCALAR. They all give the same output.
+#if defined(BLZ_SCALAR)
+#define BLZ_KERNELS   "scalar"
+#elif defined(BLZ_WORD) || !defined(__SSE2__)
+#define BLZ_KERNELS   "word"
+#define BLZ_LANES     4          // candidate positions per word
+#define BLZ_LANE_BITS 3          // a lane is a byte of the mask
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define BLZ_KERNELS   "avx2"
+#define BLZ_LANES     32
+#define BLZ_LANE_BITS 0
+#else
+#include <emmintrin.h>
+#define BLZ_KERNELS   "sse2"
+#define BLZ_LANES     16
+#define BLZ_LANE_BITS 0
+#endif
+
 /*----------------------------------------------------------------------------*/
 #define BREAK(text)   { printf(text); return; }
 #define EXIT(text)    { printf(text); exit(-1); }
 
 /*----------------------------------------------------------------------------*/
-char *Memory(int length, int size);
-
-unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *new_len, int best);
-void  BLZ_Invert(unsigned char *buffer, int length);
+static char *Memory(const BLZ_Context *context, int length, int size);
+static void  Release(const BLZ_Context *context, void *buffer);
 
 /*----------------------------------------------------------------------------*/
-char *Memory(int length, int size) {
+static char *Memory(const BLZ_Context *context, int length, int size) {
   char *fb;
 
-  fb = (char *) calloc(length * size, size);
-  if (fb == NULL) EXIT("\nMemory error\n");
+  if (context && context->a) fb = (char *) arena_calloc(context->a, length * size);
+  else                      fb = (char *) calloc(length * size, size);
 
   return(fb);
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *new_len, int best) {
+static void Release(const BLZ_Context *context, void *buffer) {
+  if (!context || !context->a) free(buffer);
+}
+
+/*----------------------------------------------------------------------------*/
+const char *BLZ_Kernels(void) {
+  return(BLZ_KERNELS);
+}
+
+#ifndef BLZ_SCALAR
+/*----------------------------------------------------------------------------*/
+static inline unsigned int Load32(const unsigned char *p) {
+  unsigned int w;
+
+  memcpy(&w, p, 4); // a single unaligned LDR on the ARM11
+
+  return(w);
+}
+
+/*----------------------------------------------------------------------------*/
+static inline void Store32(unsigned char *p, unsigned int w) {
+  memcpy(p, &w, 4);
+}
+
+/*----------------------------------------------------------------------------*/
+// Index of the first differing byte of two little-endian words, x being their
+// XOR: REV puts that byte on top, where CLZ finds it.
+static inline unsigned int FirstDiff(unsigned int x) {
+  return(__builtin_clz(__builtin_bswap32(x)) >> 3);
+}
+
+/*----------------------------------------------------------------------------*/
+// 0xFF in every byte of w that equals the same byte of c.
+static inline unsigned int Equal8(unsigned int w, unsigned int c) {
+#if defined(__arm__) && defined(__ARM_FEATURE_SIMD32)
+  unsigned int m;
+
+  // USUB8 sets GE for each byte where 0 - (w ^ c) doesn't borrow, SEL turns the
+  // GE flags into a byte mask
+  __asm__("usub8 %0, %1, %2\n\tsel %0, %3, %1" : "=&r" (m) : "r" (0), "r" (w ^ c), "r" (0xFFFFFFFF) : "cc");
+
+  return(m);
+#else
+  unsigned int x = w ^ c;
+
+  // high bit set for zero bytes, exact since no byte can borrow from another
+  return(~(((x & 0x7F7F7F7F) + 0x7F7F7F7F) | x) & 0x80808080);
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+// Length of the common prefix of a and b, up to max (at most BLZ_F) bytes.
+static inline unsigned int Match(const unsigned char *a, const unsigned char *b, unsigned int max) {
+  unsigned int len = 0, x;
+
+#if BLZ_LANES > 4
+  // a match is never longer than BLZ_F, so 16 bytes is as wide as it gets
+  if (max >= 16) {
+    x = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) a),
+                                          _mm_loadu_si128((const __m128i *) b))) & 0xFFFF;
+    if (x) return(__builtin_ctz(x));
+    len = 16;
+  }
+#endif
+
+  for (; len + 4 <= max; len += 4) {
+    x = Load32(a + len) ^ Load32(b + len);
+    if (x) return(len + FirstDiff(x));
+  }
+
+  while (len < max && a[len] == b[len]) len++;
+
+  return(len);
+}
+
+/*----------------------------------------------------------------------------*/
+// One mask bit (BLZ_LANE_BITS = 0) or byte (3) per position, from pos + BLZ_LANES
+// - 1 in the lowest lane to pos in the highest, set where the first two bytes
+// at raw - position match those at raw. Needs pos + BLZ_LANES - 1 bytes before
+// raw and 2 from it.
+static inline unsigned int Candidates(const unsigned char *raw, unsigned int pos) {
+  const unsigned char *p = raw - pos - (BLZ_LANES - 1);
+
+#if BLZ_LANES == 32
+  __m256i m0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) p), _mm256_set1_epi8(raw[0]));
+  __m256i m1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + 1)), _mm256_set1_epi8(raw[1]));
+
+  return((unsigned int) _mm256_movemask_epi8(_mm256_and_si256(m0, m1)));
+#elif BLZ_LANES == 16
+  __m128i m0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), _mm_set1_epi8(raw[0]));
+  __m128i m1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 1)), _mm_set1_epi8(raw[1]));
+
+  return((unsigned int) _mm_movemask_epi8(_mm_and_si128(m0, m1)));
+#else
+  return(Equal8(Load32(p), raw[0] * 0x01010101) & Equal8(Load32(p + 1), raw[1] * 0x01010101));
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+// The longest match for raw, the closest one among equals, as the original
+// byte-by-byte SEARCH finds it. Only positions whose first two bytes match can
+// beat BLZ_THRESHOLD, so BLZ_LANES positions are ruled out at once and only
+// the candidates are extended.
+static inline void Search(const unsigned char *raw, const unsigned char *raw_buffer, const unsigned char *raw_end,
+                          unsigned int *l, unsigned int *p) {
+  unsigned int max, pos, len, cap, mask, lane, cand;
+
+  *l = BLZ_THRESHOLD;
+
+  cap = raw_end - raw;
+  if (cap <= BLZ_THRESHOLD) return;
+  if (cap > BLZ_F) cap = BLZ_F;
+
+  max = raw - raw_buffer >= BLZ_N ? BLZ_N : raw - raw_buffer;
+
+  for (pos = 3; pos + BLZ_LANES - 1 <= max; pos += BLZ_LANES) {
+    mask = Candidates(raw, pos);
+
+    // highest lane first, which is the closest position
+    while (mask) {
+      lane = (31 - __builtin_clz(mask)) >> BLZ_LANE_BITS;
+      mask &= (1u << (lane << BLZ_LANE_BITS)) - 1;
+
+      cand = pos + BLZ_LANES - 1 - lane;
+      len = Match(raw, raw - cand, cand < cap ? cand : cap);
+      if (len > *l) {
+        *p = cand;
+        if ((*l = len) == BLZ_F) return;
+      }
+    }
+  }
+
+  for (; pos <= max; pos++) {
+    len = Match(raw, raw - pos, pos < cap ? pos : cap);
+    if (len > *l) {
+      *p = pos;
+      if ((*l = len) == BLZ_F) return;
+    }
+  }
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *new_len, int best,
+                        const BLZ_Context *context) {
   unsigned char *pak_buffer, *pak, *raw, *raw_end, *flg = NULL, *tmp;
-  unsigned int   pak_len, inc_len, hdr_len, enc_len, len, pos, max;
+  unsigned int   pak_len, inc_len, hdr_len, enc_len;
   unsigned int   len_best, pos_best, len_next, pos_next, len_post, pos_post;
-  unsigned int   pak_tmp, raw_tmp;
+  unsigned int   pak_tmp, raw_tmp, next_progress;
   unsigned char  mask;
+  BLZ_ProgressCallback progress = context ? context->progress : NULL;
+
+#ifdef BLZ_SCALAR
+  unsigned int   len, pos, max;
 
 #define SEARCH(l,p) { \
   l = BLZ_THRESHOLD;                                          \
@@ -88,12 +261,16 @@ unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *ne
     }                                                         \
   }                                                           \
 }
+#else
+#define SEARCH(l,p) Search(raw, raw_buffer, raw_end, &l, &p)
+#endif
 
   pak_tmp = 0;
   raw_tmp = raw_len;
 
   pak_len = raw_len + ((raw_len + 7) / 8) + 11;
-  pak_buffer = (unsigned char *) Memory(pak_len, sizeof(char));
+  pak_buffer = (unsigned char *) Memory(context, pak_len, sizeof(char));
+  if (pak_buffer == NULL) return(NULL);
 
   BLZ_Invert(raw_buffer, raw_len);
 
@@ -102,8 +279,18 @@ unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *ne
   raw_end = raw_buffer + raw_len;
 
   mask = 0;
+  next_progress = 0;
 
   while (raw < raw_end) {
+    if (progress && raw - raw_buffer >= next_progress) {
+      next_progress += BLZ_PROGRESS;
+      if (progress(context->user, raw - raw_buffer, raw_len)) {
+        BLZ_Invert(raw_buffer, raw_len);
+        Release(context, pak_buffer);
+        return(NULL);
+      }
+    }
+
     if (!(mask >>= BLZ_SHIFT)) {
       *(flg = pak++) = 0;
       mask = BLZ_MASK;
@@ -163,24 +350,41 @@ unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *ne
     raw = raw_buffer;
     raw_end = raw_buffer + raw_len;
 
+#ifdef BLZ_SCALAR
     while (raw < raw_end) *pak++ = *raw++;
 
     while ((pak - pak_buffer) & 3) *pak++ = 0;
+#else
+    memcpy(pak, raw, raw_len);
+    pak += raw_len;
+
+    memset(pak, 0, -raw_len & 3);
+    pak += -raw_len & 3;
+#endif
 
     *(unsigned int *)pak = 0; pak += 4;
   } else {
-    tmp = (unsigned char *) Memory(raw_tmp + pak_tmp + 11, sizeof(char));
+    tmp = (unsigned char *) Memory(context, raw_tmp + pak_tmp + 11, sizeof(char));
+    if (tmp == NULL) {
+      Release(context, pak_buffer);
+      return(NULL);
+    }
 
+#ifdef BLZ_SCALAR
     for (len = 0; len < raw_tmp; len++)
       tmp[len] = raw_buffer[len];
 
     for (len = 0; len < pak_tmp; len++)
       tmp[raw_tmp + len] = pak_buffer[len + pak_len - pak_tmp];
+#else
+    memcpy(tmp, raw_buffer, raw_tmp);
+    memcpy(tmp + raw_tmp, pak_buffer + pak_len - pak_tmp, pak_tmp);
+#endif
 
     pak = pak_buffer;
     pak_buffer = tmp;
 
-    free(pak);
+    Release(context, pak);
 
     pak = pak_buffer + raw_tmp + pak_tmp;
 
@@ -203,12 +407,122 @@ unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *ne
   return(pak_buffer);
 }
 
+/*----------------------------------------------------------------------------*/
+// CUE's decoder, reading the inverted stream backwards instead of inverting it.
+int BLZ_Decode(const unsigned char *pak_buffer, int pak_len, unsigned char *raw_buffer, int raw_len) {
+  const unsigned char *pak;
+  unsigned char *raw;
+  unsigned int   inc_len, hdr_len, enc_len, dec_len, len, pos, dst_len;
+  unsigned char  flags = 0, mask = 0;
+
+  if (pak_len < 4 || pak_len > BLZ_MAXIM) return(-1);
+
+  inc_len = *(const unsigned int *)(pak_buffer + pak_len - 4);
+  if (!inc_len) {
+    // stored, padded to 4 bytes
+    len = pak_len - 4;
+    if (len > (unsigned int) raw_len) len = raw_len;
+    memcpy(raw_buffer, pak_buffer, len);
+    return(len);
+  }
+
+  if (pak_len < 8) return(-1);
+  hdr_len = pak_buffer[pak_len - 5];
+  enc_len = *(const unsigned int *)(pak_buffer + pak_len - 8) & 0x00FFFFFF;
+  if (hdr_len < 8 || hdr_len > 11 || enc_len < hdr_len || enc_len > (unsigned int) pak_len) return(-1);
+
+  dec_len = pak_len - enc_len;
+  dst_len = dec_len + enc_len + inc_len;
+  if (dst_len > (unsigned int) raw_len) return(-1);
+
+  memcpy(raw_buffer, pak_buffer, dec_len);
+
+  pak = pak_buffer + pak_len - hdr_len;
+  raw = raw_buffer + dst_len;
+
+  while (raw > raw_buffer + dec_len) {
+    if (!(mask >>= BLZ_SHIFT)) {
+      if (pak == pak_buffer + dec_len) return(-1);
+      flags = *--pak;
+      mask = BLZ_MASK;
+    }
+
+    if (!(flags & mask)) {
+      if (pak == pak_buffer + dec_len) return(-1);
+      *--raw = *--pak;
+    } else {
+      if (pak - (pak_buffer + dec_len) < 2) return(-1);
+      pos = *--pak << 8;
+      pos |= *--pak;
+      len = (pos >> 12) + BLZ_THRESHOLD + 1;
+      pos = (pos & 0xFFF) + 3;
+      if (len > (unsigned int)(raw - (raw_buffer + dec_len))) len = raw - (raw_buffer + dec_len);
+      if (pos > (unsigned int)(raw_buffer + dst_len - raw)) return(-1);
+      while (len--) { raw--; *raw = *(raw + pos); }
+    }
+  }
+
+  return(dst_len);
+}
+
 /*----------------------------------------------------------------------------*/
 void BLZ_Invert(unsigned char *buffer, int length) {
   unsigned char *bottom, ch;
 
   bottom = buffer + length - 1;
 
+  // each step swaps a block from either end while the blocks don't overlap,
+  // the wider kernels leave the rest to the narrower ones
+#if BLZ_LANES == 32
+  const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                           15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+  while (bottom - buffer >= 63) {
+    __m256i top = _mm256_loadu_si256((const __m256i *) buffer);
+    __m256i end = _mm256_loadu_si256((const __m256i *) (bottom - 31));
+
+    // PSHUFB only reverses within each half, the permute swaps the halves
+    top = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(top, reverse), 0x4E);
+    end = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(end, reverse), 0x4E);
+    _mm256_storeu_si256((__m256i *) buffer, end);
+    _mm256_storeu_si256((__m256i *) (bottom - 31), top);
+
+    buffer += 32;
+    bottom -= 32;
+  }
+#endif
+
+#if BLZ_LANES >= 16
+  while (bottom - buffer >= 31) {
+    __m128i v[2] = { _mm_loadu_si128((const __m128i *) buffer), _mm_loadu_si128((const __m128i *) (bottom - 15)) };
+
+    // SSE2 has no byte shuffle: reverse the dwords, then the words, then the bytes of each word
+    for (int i = 0; i < 2; i++) {
+      v[i] = _mm_shuffle_epi32(v[i], _MM_SHUFFLE(0, 1, 2, 3));
+      v[i] = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v[i], _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+      v[i] = _mm_or_si128(_mm_slli_epi16(v[i], 8), _mm_srli_epi16(v[i], 8));
+    }
+
+    _mm_storeu_si128((__m128i *) buffer, v[1]);
+    _mm_storeu_si128((__m128i *) (bottom - 15), v[0]);
+
+    buffer += 16;
+    bottom -= 16;
+  }
+#endif
+
+#ifndef BLZ_SCALAR
+  while (bottom - buffer >= 7) {
+    unsigned int top = Load32(buffer), end = Load32(bottom - 3);
+
+    Store32(buffer, __builtin_bswap32(end));
+    Store32(bottom - 3, __builtin_bswap32(top));
+
+    buffer += 4;
+    bottom -= 4;
+  }
+#endif
+
   while (buffer < bottom) {
     ch = *buffer;
     *buffer++ = *bottom;
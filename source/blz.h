@@ -3,9 +3,34 @@
 
 #include <3ds.h>
 
+#include "arena.h"
+
 #define BLZ_NORMAL    0          // normal mode
 #define BLZ_BEST      1          // best mode
 
-unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *new_len, int best);
+// Called by BLZ_Code() as the input is consumed, with the context's user pointer.
+// Returning non-zero aborts the compression, in which case BLZ_Code() returns NULL.
+typedef int (*BLZ_ProgressCallback)(void *user, unsigned int done, unsigned int total);
+
+// What one BLZ_Code() call works with, so that several can run at once.
+typedef struct BLZ_Context {
+  // when set, BLZ_Code() allocates from this arena instead of the heap
+  arena *a;
+  // may be NULL
+  BLZ_ProgressCallback progress;
+  void *user;
+} BLZ_Context;
+
+// context may be NULL, for heap allocations without progress.
+unsigned char *BLZ_Code(unsigned char *raw_buffer, int raw_len, unsigned int *new_len, int best,
+                        const BLZ_Context *context);
+// Decodes pak_len bytes of BLZ_Code() output into raw_buffer. Returns the decoded length, or -1 when the
+// input is corrupt or more than raw_len bytes. A payload that was stored is padded to 4 bytes, only raw_len
+// bytes of it are returned.
+int BLZ_Decode(const unsigned char *pak_buffer, int pak_len, unsigned char *raw_buffer, int raw_len);
+// Reverses buffer in place.
+void BLZ_Invert(unsigned char *buffer, int length);
+// The kernels BLZ_Code() and BLZ_Invert() were built with: "avx2", "sse2", "word" or "scalar".
+const char *BLZ_Kernels(void);
 
 #endif // _EXEFS_H_
@@ -0,0 +1,170 @@
+#include <string.h>
+
+#include <3ds.h>
+
+#include "codec.h"
+#include "blz.h"
+
+// input encoded between two progress callbacks, and between two chunks of the streams that encode as they go
+#define CODEC_STEP 0x1000
+
+// BLZ compresses from the end, so it only starts once the whole input is there.
+
+static u32 blz_bound(u32 size)
+{
+    return size + (size + 7) / 8 + 11;
+}
+
+static Result blz_begin(codec_stream* s)
+{
+    // BLZ's size field is 24 bits
+    return s->raw_size > 0xFFFFFF ? 4 : 0;
+}
+
+// BLZ_Code() fails the same way when it's stopped and when it's out of memory, this tells them apart.
+typedef struct {
+    codec_progress progress;
+    bool cancelled;
+} blz_progress_state;
+
+static int blz_progress_callback(void* user, unsigned int done, unsigned int total)
+{
+    blz_progress_state* state = user;
+    state->cancelled = state->progress(done, total) != 0;
+    return state->cancelled;
+}
+
+static Result blz_update(codec_stream* s, bool final)
+{
+    if(!final) return 0;
+
+    unsigned int out_size = 0;
+    blz_progress_state state = { s->progress, false };
+    BLZ_Context context = { s->a, s->progress ? blz_progress_callback : NULL, &state };
+    s->out = BLZ_Code(s->raw, s->raw_size, &out_size, s->level == 2 ? BLZ_BEST : BLZ_NORMAL, &context);
+    s->out_size = out_size;
+
+    if(s->out == NULL) return state.cancelled ? CODEC_CANCELLED : 5;
+    return 0;
+}
+
+static int blz_decode(const u8* src, u32 size, u8* dst, u32 dst_size)
+{
+    return BLZ_Decode(src, size, dst, dst_size);
+}
+
+// LZ10 and LZ11 encode as the input arrives, keeping one match worth of it back until the end.
+
+static u32 lzss_bound(u32 size)
+{
+    return LZSS_BOUND(size);
+}
+
+static Result lzss_begin(codec_stream* s, u8 format)
+{
+    u32* head = arena_calloc(s->a, LZSS_HASH_SIZE * sizeof(u32));
+    u32* prev = arena_calloc(s->a, LZSS_WINDOW * sizeof(u32));
+    s->out = arena_alloc(s->a, LZSS_BOUND(s->raw_size));
+    if(head == NULL || prev == NULL || s->out == NULL) return 5;
+
+    lzss_init(&s->lzss, format, s->level, head, prev);
+    s->out_size = lzss_header(format, s->raw_size, s->out);
+    return s->out_size ? 0 : 4;
+}
+
+static Result lz10_begin(codec_stream* s)
+{
+    return lzss_begin(s, LZSS_LZ10);
+}
+
+static Result lz11_begin(codec_stream* s)
+{
+    return lzss_begin(s, LZSS_LZ11);
+}
+
+static Result lzss_update(codec_stream* s, bool final)
+{
+    while(s->lzss.pos < s->raw_pos)
+    {
+        // a step at a time, for the progress callback
+        u32 available = s->raw_pos - s->lzss.pos > CODEC_STEP ? s->lzss.pos + CODEC_STEP + s->lzss.max_match : s->raw_pos;
+        if(available > s->raw_pos) available = s->raw_pos;
+        bool last = final && available == s->raw_pos;
+
+        u32 pos = s->lzss.pos;
+        s->out_size = lzss_encode(&s->lzss, s->raw, available, last, s->out, s->out_size);
+        if(s->progress && s->progress(s->lzss.pos, s->raw_size)) return CODEC_CANCELLED;
+        if(s->lzss.pos == pos) break;
+    }
+
+    // an empty input still gets its padding
+    if(final) s->out_size = lzss_encode(&s->lzss, s->raw, s->raw_pos, true, s->out, s->out_size);
+    return 0;
+}
+
+static const codec codecs[] = {
+    // BLZ_NORMAL, or BLZ_BEST at level 2
+    [CODEC_BLZ] = { "blz", 1, 2, blz_bound, blz_begin, blz_update, blz_decode },
+    [CODEC_LZ10] = { "lz10", 2, LZSS_LEVELS, lzss_bound, lz10_begin, lzss_update, lzss_decode },
+    [CODEC_LZ11] = { "lz11", 2, LZSS_LEVELS, lzss_bound, lz11_begin, lzss_update, lzss_decode },
+};
+
+int codec_count(void)
+{
+    return sizeof(codecs) / sizeof(codecs[0]);
+}
+
+const codec* codec_get(int id)
+{
+    return id >= 0 && id < codec_count() ? &codecs[id] : NULL;
+}
+
+const codec* codec_find(const char* name)
+{
+    for(int i = 0; i < codec_count(); i++)
+        if(strcmp(codecs[i].name, name) == 0) return &codecs[i];
+
+    return NULL;
+}
+
+const codec* codec_from_flags(u32 flags_bitmask, int* level)
+{
+    const codec* c = codec_get(CODEC_FLAGS_ID(flags_bitmask));
+    if(c) *level = CODEC_FLAGS_LEVEL(flags_bitmask) ? CODEC_FLAGS_LEVEL(flags_bitmask) : c->default_level;
+
+    return c;
+}
+
+Result codec_begin(codec_stream* s, const codec* c, int level, u8* raw, u32 raw_size, arena* a, codec_progress progress)
+{
+    memset(s, 0, sizeof(*s));
+    s->codec = c;
+    s->level = level < 1 ? c->default_level : (level > c->max_level ? c->max_level : level);
+    s->a = a;
+    s->progress = progress;
+    s->raw = raw;
+    s->raw_size = raw_size;
+
+    return c->begin(s);
+}
+
+Result codec_update(codec_stream* s, u32 size)
+{
+    if(size > s->raw_size - s->raw_pos) return 4;
+
+    s->raw_pos += size;
+
+    return s->codec->update(s, false);
+}
+
+Result codec_end(codec_stream* s, u8** out, u32* out_size)
+{
+    if(s->raw_pos != s->raw_size) return 4;
+
+    Result ret = s->codec->update(s, true);
+    if(ret) return ret;
+
+    *out = s->out;
+    *out_size = s->out_size;
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef _CODEC_H_
+#define _CODEC_H_
+
+#include <3ds.h>
+
+#include "arena.h"
+#include "lzss.h"
+
+// The payload codecs an exploit's loader can decode. An exploit with flag 0x1 (compress) in exploitlist_config
+// picks one with bits 5-6 of its flags and the codec's level with bits 7-8, 0 being the codec's default level:
+// 0x1 is BLZ at its default level, 0x41 LZ11 at its default and 0x1C1 LZ11 at level 3.
+#define CODEC_BLZ 0
+#define CODEC_LZ10 1
+#define CODEC_LZ11 2
+
+#define CODEC_FLAGS_ID(flags) (((flags) >> 5) & 0x3)
+#define CODEC_FLAGS_LEVEL(flags) (((flags) >> 7) & 0x3)
+#define CODEC_FLAGS_MASK 0x1E1
+
+// codec_update() / codec_end() result when the progress callback stopped the stream
+#define CODEC_CANCELLED 2
+
+typedef struct codec_stream codec_stream;
+
+// Called as the input is encoded, returning non-zero stops the stream.
+typedef int (*codec_progress)(unsigned int done, unsigned int total);
+
+typedef struct {
+    const char* name;
+    int default_level;
+    int max_level;
+
+    // worst case output for size bytes of input
+    u32 (*bound)(u32 size);
+    Result (*begin)(codec_stream* s);
+    // encodes what it can of the input received so far, all of it when final
+    Result (*update)(codec_stream* s, bool final);
+    // returns the decoded size, or -1 when src is corrupt or doesn't fit in dst_size bytes
+    int (*decode)(const u8* src, u32 size, u8* dst, u32 dst_size);
+} codec;
+
+// An encode of a buffer the caller fills in as many pieces as it likes. The output is the same however it's split.
+struct codec_stream {
+    const codec* codec;
+    int level;
+    arena* a;
+    codec_progress progress;
+
+    // the caller's input buffer, whose size is known up front, and how much of it has arrived
+    u8* raw;
+    u32 raw_size;
+    u32 raw_pos;
+
+    u8* out;
+    u32 out_size;
+
+    lzss_state lzss;
+};
+
+int codec_count(void);
+// NULL when there's no such codec.
+const codec* codec_get(int id);
+const codec* codec_find(const char* name);
+// The codec and level an exploit's flags pick, NULL when its codec bits don't name one.
+const codec* codec_from_flags(u32 flags_bitmask, int* level);
+
+// Starts encoding the raw_size bytes of raw with c at level (0 for its default), allocating from a. raw is read in
+// place, not copied, and has to stay around until codec_end(); BLZ reverses it while it encodes and restores it
+// before returning. progress may be NULL. Returns 4 when c can't encode raw_size bytes and 5 when a is out of
+// memory.
+Result codec_begin(codec_stream* s, const codec* c, int level, u8* raw, u32 raw_size, arena* a, codec_progress progress);
+// Tells the stream the next size bytes of raw have arrived, and encodes as much of them as the codec can already.
+// Returns 4 when that's more than raw_size in all.
+Result codec_update(codec_stream* s, u32 size);
+// Encodes the rest, once all raw_size bytes arrived, and returns the output, which lives in the stream's arena.
+Result codec_end(codec_stream* s, u8** out, u32* out_size);
+
+#endif // _CODEC_H_
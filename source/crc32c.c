@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include "crc32c.h"
+
+#if !defined(_3DS) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#elif !defined(_3DS) && defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARMV8
+#endif
+
+#define CRC32C_POLY 0x82F63B78
+
+static u32 crc32c_table[8][256];
+
+// Slicing-by-8: eight table lookups per aligned 8 bytes instead of one per byte. The ARM11 has no
+// CRC instructions, and this keeps it to word loads from aligned addresses, which it does in one cycle.
+static u32 crc32c_slice8(u32 crc, const u8* p, size_t size)
+{
+    while(size && ((uintptr_t)p & 3))
+    {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        size--;
+    }
+
+    while(size >= 8)
+    {
+        // both devices and hosts this builds for are little-endian
+        u32 lo = *(const u32*)p ^ crc;
+        u32 hi = *(const u32*)(p + 4);
+
+        crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+              crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+              crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+              crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+
+        p += 8;
+        size -= 8;
+    }
+
+    while(size--) crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+#ifdef CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+static u32 crc32c_sse42(u32 crc, const u8* p, size_t size)
+{
+    while(size && ((uintptr_t)p & 7))
+    {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+
+#ifdef __x86_64__
+    u64 crc64 = crc;
+    for(; size >= 8; p += 8, size -= 8) crc64 = _mm_crc32_u64(crc64, *(const u64*)p);
+    crc = crc64;
+#endif
+    for(; size >= 4; p += 4, size -= 4) crc = _mm_crc32_u32(crc, *(const u32*)p);
+    while(size--) crc = _mm_crc32_u8(crc, *p++);
+
+    return crc;
+}
+
+#endif
+
+#ifdef CRC32C_ARMV8
+
+static u32 crc32c_armv8(u32 crc, const u8* p, size_t size)
+{
+    while(size && ((uintptr_t)p & 7))
+    {
+        crc = __crc32cb(crc, *p++);
+        size--;
+    }
+
+    for(; size >= 8; p += 8, size -= 8) crc = __crc32cd(crc, *(const u64*)p);
+    while(size--) crc = __crc32cb(crc, *p++);
+
+    return crc;
+}
+
+#endif
+
+static u32 (*kernel)(u32 crc, const u8* p, size_t size);
+static const char* kernel_name;
+
+void crc32c_init(void)
+{
+    for(u32 i = 0; i < 256; i++)
+    {
+        u32 crc = i;
+        for(int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+        crc32c_table[0][i] = crc;
+    }
+
+    for(u32 i = 0; i < 256; i++)
+    {
+        for(int slice = 1; slice < 8; slice++)
+            crc32c_table[slice][i] = crc32c_table[0][crc32c_table[slice - 1][i] & 0xFF] ^ (crc32c_table[slice - 1][i] >> 8);
+    }
+
+    kernel_name = "slice8";
+    kernel = crc32c_slice8;
+
+#ifdef CRC32C_SSE42
+    if(__builtin_cpu_supports("sse4.2"))
+    {
+        kernel_name = "sse4.2";
+        kernel = crc32c_sse42;
+    }
+#endif
+#ifdef CRC32C_ARMV8
+    kernel_name = "armv8";
+    kernel = crc32c_armv8;
+#endif
+}
+
+u32 crc32c_update(u32 crc, const void* data, size_t size)
+{
+    return ~kernel(~crc, data, size);
+}
+
+const char* crc32c_kernel(void)
+{
+    return kernel_name;
+}
@@ -0,0 +1,16 @@
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+#include <3ds.h>
+
+// CRC-32C (Castagnoli), as used by iSCSI and ext4. crc is 0 for the first call and the previous
+// result afterwards, so crc32c_update(crc32c_update(0, a, n), b, m) is the CRC of a followed by b.
+// Builds the table and picks the kernel. Called once by services_init(), before any other thread runs.
+void crc32c_init(void);
+
+u32 crc32c_update(u32 crc, const void* data, size_t size);
+
+// The kernel crc32c_update() ended up with, for reporting.
+const char* crc32c_kernel(void);
+
+#endif // _CRC32C_H_
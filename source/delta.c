@@ -0,0 +1,176 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "delta.h"
+
+enum {
+    DELTA_STAGE_HEADER,
+    DELTA_STAGE_OP,
+    DELTA_STAGE_ARGS,
+    DELTA_STAGE_DATA,
+    DELTA_STAGE_DONE,
+};
+
+static u32 read_u32le(const u8 *ptr)
+{
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((u32)ptr[3] << 24);
+}
+
+static void delta_output(delta_patcher *p, const u8 *data, u32 size)
+{
+    memcpy(&p->out[p->out_pos], data, size);
+    sha256_update(&p->sha, data, size);
+    p->out_pos += size;
+    if(p->out_pos == p->out_size) p->stage = DELTA_STAGE_DONE;
+    else p->stage = DELTA_STAGE_OP;
+}
+
+static Result delta_parse_header(delta_patcher *p)
+{
+    if(memcmp(p->hdr, DELTA_MAGIC, 8)) return DELTA_ERR_MAGIC;
+
+    if(read_u32le(&p->hdr[8]) != p->base_size) return DELTA_ERR_BASE;
+    if(memcmp(&p->hdr[16], p->base_hash, SHA256_HASH_SIZE)) return DELTA_ERR_BASE;
+
+    p->out_size = read_u32le(&p->hdr[12]);
+    if(p->out_size == 0) return DELTA_ERR_RANGE;
+
+    p->out = p->arena ? arena_alloc(p->arena, p->out_size) : malloc(p->out_size);
+    if(!p->out) return DELTA_ERR_MEMORY;
+
+    sha256_init(&p->sha);
+    p->stage = DELTA_STAGE_OP;
+
+    return 0;
+}
+
+void delta_begin(delta_patcher *p, const void *base, u32 base_size, const u8 *base_hash, arena *a)
+{
+    memset(p, 0, sizeof(*p));
+
+    p->arena = a;
+    p->base = base;
+    p->base_size = base_size;
+    memcpy(p->base_hash, base_hash, SHA256_HASH_SIZE);
+    p->stage = DELTA_STAGE_HEADER;
+}
+
+Result delta_feed(delta_patcher *p, const void *data, u32 size)
+{
+    const u8 *ptr = data;
+    const u8 *end = ptr + size;
+    Result ret;
+    u32 chunk;
+
+    while(ptr < end)
+    {
+        switch(p->stage)
+        {
+            case DELTA_STAGE_HEADER:
+                chunk = DELTA_HEADER_SIZE - p->hdr_pos;
+                if(chunk > end - ptr) chunk = end - ptr;
+
+                memcpy(&p->hdr[p->hdr_pos], ptr, chunk);
+                p->hdr_pos += chunk;
+                ptr += chunk;
+
+                if(p->hdr_pos == DELTA_HEADER_SIZE)
+                {
+                    ret = delta_parse_header(p);
+                    if(ret) return ret;
+                }
+                break;
+
+            case DELTA_STAGE_OP:
+                p->op = *ptr++;
+                if(p->op == DELTA_OP_COPY) p->args_len = 8;
+                else if(p->op == DELTA_OP_ADD) p->args_len = 4;
+                else return DELTA_ERR_OP;
+
+                p->args_pos = 0;
+                p->stage = DELTA_STAGE_ARGS;
+                break;
+
+            case DELTA_STAGE_ARGS:
+                chunk = p->args_len - p->args_pos;
+                if(chunk > end - ptr) chunk = end - ptr;
+
+                memcpy(&p->args[p->args_pos], ptr, chunk);
+                p->args_pos += chunk;
+                ptr += chunk;
+
+                if(p->args_pos < p->args_len) break;
+
+                if(p->op == DELTA_OP_COPY)
+                {
+                    u32 offset = read_u32le(&p->args[0]);
+                    u32 length = read_u32le(&p->args[4]);
+
+                    if(length == 0 || offset > p->base_size || length > p->base_size - offset) return DELTA_ERR_RANGE;
+                    if(length > p->out_size - p->out_pos) return DELTA_ERR_RANGE;
+
+                    delta_output(p, &p->base[offset], length);
+                }
+                else
+                {
+                    p->add_remaining = read_u32le(&p->args[0]);
+                    if(p->add_remaining == 0 || p->add_remaining > p->out_size - p->out_pos) return DELTA_ERR_RANGE;
+
+                    p->stage = DELTA_STAGE_DATA;
+                }
+                break;
+
+            case DELTA_STAGE_DATA:
+                chunk = p->add_remaining;
+                if(chunk > end - ptr) chunk = end - ptr;
+
+                p->add_remaining -= chunk;
+                if(p->add_remaining)
+                {
+                    memcpy(&p->out[p->out_pos], ptr, chunk);
+                    sha256_update(&p->sha, ptr, chunk);
+                    p->out_pos += chunk;
+                }
+                else delta_output(p, ptr, chunk);
+
+                ptr += chunk;
+                break;
+
+            default:
+                // trailing garbage after the last op
+                return DELTA_ERR_RANGE;
+        }
+    }
+
+    return 0;
+}
+
+Result delta_end(delta_patcher *p, void **out, size_t *out_size)
+{
+    u8 hash[SHA256_HASH_SIZE];
+
+    if(p->stage != DELTA_STAGE_DONE)
+    {
+        delta_abort(p);
+        return DELTA_ERR_TRUNCATED;
+    }
+
+    sha256_final(&p->sha, hash);
+    if(memcmp(hash, &p->hdr[16 + SHA256_HASH_SIZE], SHA256_HASH_SIZE))
+    {
+        delta_abort(p);
+        return DELTA_ERR_HASH;
+    }
+
+    *out = p->out;
+    *out_size = p->out_size;
+    p->out = NULL;
+
+    return 0;
+}
+
+void delta_abort(delta_patcher *p)
+{
+    if(p->out && !p->arena) free(p->out);
+    p->out = NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef _DELTA_H_
+#define _DELTA_H_
+
+#include <3ds.h>
+
+#include "sha256.h"
+#include "arena.h"
+
+// Binary delta between two payload builds, served with "226 IM Used" for "A-IM: saltdiff".
+// All integers are little-endian.
+//
+// header:
+//   char magic[8]          "SALTDIF1"
+//   u32  base_size
+//   u32  target_size
+//   u8   base_hash[32]     sha256 of the base (cached) payload
+//   u8   target_hash[32]   sha256 of the patched payload
+// followed by ops until target_size bytes were produced:
+//   u8 0x00, u32 offset, u32 length    copy length bytes from base+offset
+//   u8 0x01, u32 length, u8 data[]     insert length bytes
+
+#define DELTA_MAGIC         "SALTDIF1"
+#define DELTA_HEADER_SIZE   (8 + 4 + 4 + SHA256_HASH_SIZE*2)
+
+#define DELTA_OP_COPY       0x00
+#define DELTA_OP_ADD        0x01
+
+#define DELTA_ERR_MAGIC     -0x10
+#define DELTA_ERR_BASE      -0x11
+#define DELTA_ERR_OP        -0x12
+#define DELTA_ERR_RANGE     -0x13
+#define DELTA_ERR_MEMORY    -0x14
+#define DELTA_ERR_TRUNCATED -0x15
+#define DELTA_ERR_HASH      -0x16
+
+typedef struct {
+    arena *arena;
+
+    const u8 *base;
+    u32 base_size;
+    u8 base_hash[SHA256_HASH_SIZE];
+
+    u8 *out;
+    u32 out_size;
+    u32 out_pos;
+
+    int stage;
+    u8 hdr[DELTA_HEADER_SIZE];
+    u32 hdr_pos;
+    u8 op;
+    u8 args[8];
+    u32 args_pos;
+    u32 args_len;
+    u32 add_remaining;
+
+    sha256_context sha;
+} delta_patcher;
+
+// base_hash is the sha256 of base, which the delta header must match.
+// The patched payload is allocated from a when it's set, from the heap otherwise.
+void delta_begin(delta_patcher *p, const void *base, u32 base_size, const u8 *base_hash, arena *a);
+Result delta_feed(delta_patcher *p, const void *data, u32 size);
+// On success the patched payload is returned in *out, after its hash was verified.
+Result delta_end(delta_patcher *p, void **out, size_t *out_size);
+void delta_abort(delta_patcher *p);
+
+#endif // _DELTA_H_
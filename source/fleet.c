@@ -0,0 +1,420 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3ds.h>
+
+#include "codec.h"
+#include "fleet.h"
+#include "install.h"
+#include "romfsio.h"
+#include "saveio.h"
+#include "services.h"
+#include "trace.h"
+
+typedef struct {
+    char exploitname[64];
+    char titlename[64];
+    u32 flags_bitmask;
+} fleet_exploit;
+
+typedef struct {
+    u64 program_id;
+    int exploit;
+} fleet_program;
+
+// exploitlist_config, read once and sorted by program ID so every installed title is a binary search
+static fleet_exploit exploits[FLEET_MAX_EXPLOITS];
+static fleet_program programs[FLEET_MAX_PROGRAM_IDS];
+static int program_count;
+
+static fleet* running_fleet;
+
+static int compare_programs(const void* a, const void* b)
+{
+    const fleet_program* pa = a;
+    const fleet_program* pb = b;
+
+    if(pa->program_id != pb->program_id) return pa->program_id < pb->program_id ? -1 : 1;
+    return pa->exploit - pb->exploit;
+}
+
+static Result fleet_load_exploits(const char* path)
+{
+    char line[256];
+    int exploit_count = 0;
+
+    romfs_text f;
+    if(romfs_text_open(path, &f)) return 1;
+
+    program_count = 0;
+    memset(line, 0, sizeof(line));
+    while(romfs_text_gets(line, sizeof(line) - 1, &f) && exploit_count < FLEET_MAX_EXPLOITS)
+    {
+        remove_newline(line);
+
+        char* exploitname = strtok(line, " ");
+        char* titlename = strtok(NULL, " ");
+        char* flags = strtok(NULL, " ");
+        if(flags == NULL) continue;
+
+        fleet_exploit* exploit = &exploits[exploit_count];
+        memset(exploit, 0, sizeof(*exploit));
+        snprintf(exploit->exploitname, sizeof(exploit->exploitname), "%s", exploitname);
+        snprintf(exploit->titlename, sizeof(exploit->titlename), "%s", titlename);
+        unsigned long flags_bitmask = 0;
+        sscanf(flags, "0x%lx", &flags_bitmask);
+        exploit->flags_bitmask = flags_bitmask;
+
+        char* strptr;
+        while((strptr = strtok(NULL, " ")) && program_count < FLEET_MAX_PROGRAM_IDS)
+        {
+            unsigned long long program_id = 0;
+            sscanf(strptr, "%016llx", &program_id);
+            if(program_id == 0) continue;
+
+            programs[program_count].program_id = program_id;
+            programs[program_count].exploit = exploit_count;
+            program_count++;
+        }
+
+        exploit_count++;
+    }
+
+    romfs_text_close(&f);
+
+    qsort(programs, program_count, sizeof(programs[0]), compare_programs);
+    return 0;
+}
+
+// The exploit for program_id. Entries are sorted by exploit after program ID, so the lowest match is the first
+// exploit listed for it, same as load_exploitlist_config() picks.
+static const fleet_exploit* fleet_find_exploit(u64 program_id)
+{
+    int low = 0, high = program_count;
+    while(low < high)
+    {
+        int mid = (low + high) / 2;
+        if(programs[mid].program_id < program_id) low = mid + 1;
+        else high = mid;
+    }
+
+    if(low == program_count || programs[low].program_id != program_id) return NULL;
+    return &exploits[programs[low].exploit];
+}
+
+static Result fleet_scan_media(FS_MediaType media_type, fleet* out)
+{
+    u32 count = 0, read = 0;
+
+    Result ret = AM_GetTitleCount(media_type, &count);
+    if(R_FAILED(ret) || count == 0) return ret;
+
+    u64* program_ids = malloc(count * sizeof(u64));
+    if(program_ids == NULL) return -1;
+
+    ret = AM_GetTitleList(&read, media_type, count, program_ids);
+    for(u32 i = 0; R_SUCCEEDED(ret) && i < read && out->count < FLEET_MAX_TITLES; i++)
+    {
+        const fleet_exploit* exploit = fleet_find_exploit(program_ids[i]);
+        if(exploit == NULL) continue;
+
+        fleet_title* title = &out->titles[out->count++];
+        memset(title, 0, sizeof(*title));
+        title->program_id = program_ids[i];
+        title->media_type = media_type;
+        snprintf(title->exploitname, sizeof(title->exploitname), "%s", exploit->exploitname);
+        snprintf(title->titlename, sizeof(title->titlename), "%s", exploit->titlename);
+        title->flags_bitmask = exploit->flags_bitmask;
+    }
+
+    free(program_ids);
+    return ret;
+}
+
+Result fleet_scan(const char* exploitlist_path, fleet* out)
+{
+    memset(out, 0, sizeof(*out));
+
+    Result ret = fleet_load_exploits(exploitlist_path);
+    if(ret) return ret;
+
+    ret = service_require(SERVICE_AM);
+    if(R_SUCCEEDED(ret)) ret = fleet_scan_media(MEDIATYPE_SD, out);
+    if(R_FAILED(ret)) return ret;
+
+    // without a game card inserted there's nothing to list there
+    fleet_scan_media(MEDIATYPE_GAME_CARD, out);
+
+    return 0;
+}
+
+// The version of title to install. A title that isn't running has no product info to read its remaster
+// version from, so it's the first one its config lists, which an installed update still raises.
+static Result fleet_select_version(fleet_title* title, const install_context* ctx)
+{
+    if(title->program_id == ctx->program_id)
+    {
+        title->remaster = ctx->selected_remaster;
+        snprintf(title->displayversion, sizeof(title->displayversion), "%s", ctx->displayversion);
+        title->update_exists = ctx->update_exists;
+        title->update_title = ctx->update_title;
+        return 0;
+    }
+
+    Result ret = load_exploitversion(title->exploitname, &title->program_id, 0, &title->remaster, title->displayversion);
+    if(ret) return ret;
+
+    if(((title->program_id >> 32) & 0xFFFF) == 0)
+    {
+        u64 update_program_id = title->program_id | 0x0000000E00000000ULL;
+        title->update_exists = R_SUCCEEDED(AM_GetTitleInfo(MEDIATYPE_SD, 1, &update_program_id, &title->update_title));
+    }
+
+    return 0;
+}
+
+// An install of title with the firmware and options of ctx.
+static void fleet_target(const fleet_title* title, const install_context* ctx, install_context* out)
+{
+    memset(out, 0, sizeof(*out));
+    snprintf(out->exploitname, sizeof(out->exploitname), "%s", title->exploitname);
+    snprintf(out->titlename, sizeof(out->titlename), "%s", title->titlename);
+    snprintf(out->displayversion, sizeof(out->displayversion), "%s", title->displayversion);
+    out->flags_bitmask = title->flags_bitmask;
+    out->program_id = title->program_id;
+    out->selected_remaster = title->remaster;
+    out->update_exists = title->update_exists;
+    out->update_title = title->update_title;
+
+    memcpy(out->firmware_version, ctx->firmware_version, sizeof(out->firmware_version));
+    // nobody is there to pick a slot, so exploits that have them get every one
+    out->all_slots = !(title->flags_bitmask & 0x10);
+    out->offline = ctx->offline;
+    out->update = ctx->update;
+    out->verify = ctx->verify;
+    out->backup = ctx->backup;
+}
+
+static int fleet_stage(state_t state)
+{
+    for(int stage = 0; stage < install_stage_count; stage++)
+        if(install_stages[stage].state == state) return stage;
+
+    return -1;
+}
+
+static void fleet_report(const fleet_title* title, const char* result)
+{
+    FILE* f = fopen(FLEET_RESULT_PATH, "a");
+    if(f == NULL) return;
+
+    fprintf(f, "program_id=%016llX media=%u exploit=%s version=%s result=%s code=%08lX install_ms=%lu status=",
+        (unsigned long long)title->program_id, title->media_type, title->exploitname, title->displayversion[0] ? title->displayversion : "-",
+        result, (unsigned long)(u32)title->result, (unsigned long)(title->install_us / 1000));
+
+    // status is the last field and kept to one line, same as in the headless results
+    char text[STATUS_SIZE];
+    status_get(text, sizeof(text));
+    char last = ' ';
+    for(const char* ptr = text; *ptr; ptr++)
+    {
+        char c = (*ptr == '\n') ? ' ' : *ptr;
+        if(c == ' ' && last == ' ') continue;
+
+        fputc(c, f);
+        last = c;
+    }
+    fputc('\n', f);
+
+    fclose(f);
+}
+
+// The payload as one of the codec settings processed it.
+typedef struct {
+    u32 codec_flags;
+    void* buffer;
+    size_t size;
+} fleet_payload;
+
+static const fleet_payload* fleet_find_payload(const fleet_payload* processed, int count, u32 flags_bitmask)
+{
+    for(int i = 0; i < count; i++)
+        if(processed[i].codec_flags == (flags_bitmask & CODEC_FLAGS_MASK)) return &processed[i];
+
+    return NULL;
+}
+
+static void fleet_thread(void* arg)
+{
+    install_context* ctx = arg;
+    fleet* f = running_fleet;
+    static install_context target;
+    Result ret = 0, failure = 0;
+
+    int download_stage = fleet_stage(STATE_DOWNLOAD_PAYLOAD);
+    int compress_stage = fleet_stage(STATE_COMPRESS_PAYLOAD);
+    const fleet_title* first = NULL;
+
+    for(int i = 0; i < f->count; i++)
+    {
+        fleet_title* title = &f->titles[i];
+
+        title->result = fleet_select_version(title, ctx);
+        if(title->result)
+        {
+            status_set("Failed to read the versions of %s from its config.", title->exploitname);
+            fleet_report(title, "error");
+            f->failed++;
+            failure = title->result;
+            continue;
+        }
+
+        if(first == NULL) first = title;
+    }
+
+    // the payload only depends on the console: it's downloaded once for every title, then processed once for
+    // each codec and level the exploits want it processed with
+    void* payload = NULL;
+    size_t payload_size = 0;
+    static fleet_payload processed[FLEET_MAX_TITLES];
+    int processed_count = 0;
+
+    if(first)
+    {
+        // the user agent names the first title's exploit
+        fleet_target(first, ctx, &target);
+        ctx->stage = download_stage;
+        ret = install_run_stage(&target, download_stage);
+        payload = target.payload_buffer;
+        payload_size = target.payload_size;
+
+        for(int i = 0; i < f->count && !ret; i++)
+        {
+            fleet_title* title = &f->titles[i];
+            fleet_target(title, ctx, &target);
+            if(title->result || !install_stage_enabled(&target, compress_stage) || fleet_find_payload(processed, processed_count, title->flags_bitmask)) continue;
+
+            target.payload_buffer = payload;
+            target.payload_size = payload_size;
+            ctx->stage = compress_stage;
+            ret = install_run_stage(&target, compress_stage);
+            if(ret == INSTALL_CANCELLED) break;
+            if(ret)
+            {
+                // every title that wants the payload processed this way fails with it, the others go on
+                for(int j = i; j < f->count; j++)
+                {
+                    fleet_title* other = &f->titles[j];
+                    if(other->result || (other->flags_bitmask & CODEC_FLAGS_MASK) != (title->flags_bitmask & CODEC_FLAGS_MASK)) continue;
+
+                    other->result = ret;
+                    fleet_report(other, "error");
+                    f->failed++;
+                }
+                failure = ret;
+                ret = 0;
+                continue;
+            }
+
+            fleet_payload* p = &processed[processed_count++];
+            p->codec_flags = title->flags_bitmask & CODEC_FLAGS_MASK;
+            p->buffer = target.payload_buffer;
+            p->size = target.payload_size;
+        }
+
+        if(R_SUCCEEDED(ret)) ret = service_require(SERVICE_SAVE_SESSION);
+    }
+
+    for(int i = 0; i < f->count && first; i++)
+    {
+        fleet_title* title = &f->titles[i];
+        if(title->result) continue;
+
+        // everything left fails along with the payload
+        if(ret)
+        {
+            title->result = ret;
+            fleet_report(title, "error");
+            f->failed++;
+            failure = ret;
+            continue;
+        }
+
+        fleet_target(title, ctx, &target);
+        const fleet_payload* p = install_stage_enabled(&target, compress_stage) ? fleet_find_payload(processed, processed_count, title->flags_bitmask) : NULL;
+        target.payload_buffer = p ? p->buffer : payload;
+        target.payload_size = p ? p->size : payload_size;
+
+        // fs:USER only reaches the saves the running title has access to, the others are skipped
+        saveio_set_title(title->program_id == ctx->program_id ? 0 : title->program_id, title->media_type);
+        Result open_ret = saveio_open_archive();
+        if(R_FAILED(open_ret))
+        {
+            status_set("This title can't open the save of %016llX.\n    Error code: %08lX", (unsigned long long)title->program_id, (unsigned long)open_ret);
+            title->skipped = true;
+            fleet_report(title, "skipped");
+            f->skipped++;
+            continue;
+        }
+        saveio_close_archive();
+
+        // what one title's stages allocate goes away before the next one, the payload stays
+        arena_mark mark = arena_save(&install_arena);
+        u64 start = trace_now();
+
+        Result title_ret = 0;
+        for(int stage = 0; stage < install_stage_count && !title_ret; stage++)
+        {
+            if(install_stages[stage].state <= STATE_COMPRESS_PAYLOAD || !install_stage_enabled(&target, stage)) continue;
+
+            ctx->stage = stage;
+            title_ret = install_run_stage(&target, stage);
+        }
+
+        title->install_us = trace_ticks_to_us(trace_now() - start);
+        arena_restore(&install_arena, mark);
+
+        title->result = title_ret;
+        fleet_report(title, title_ret ? "error" : "ok");
+        if(title_ret)
+        {
+            f->failed++;
+            failure = title_ret;
+        }
+        else f->installed++;
+
+        if(title_ret == INSTALL_CANCELLED)
+        {
+            ret = title_ret;
+            break;
+        }
+    }
+
+    saveio_set_title(0, 0);
+
+    if(ret != INSTALL_CANCELLED)
+    {
+        status_set("Provisioned %d of %d title(s), %d skipped.\n    Results are in %s", f->installed, f->count, f->skipped, FLEET_RESULT_PATH);
+        ret = failure;
+    }
+
+    install_finish(ctx, ret);
+}
+
+Result fleet_start(fleet* f, install_context* ctx)
+{
+    f->installed = 0;
+    f->skipped = 0;
+    f->failed = 0;
+    for(int i = 0; i < f->count; i++)
+    {
+        f->titles[i].result = 0;
+        f->titles[i].skipped = false;
+        f->titles[i].install_us = 0;
+    }
+
+    running_fleet = f;
+    ctx->stage = fleet_stage(STATE_DOWNLOAD_PAYLOAD);
+    return install_start_job(ctx, fleet_thread);
+}
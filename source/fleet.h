@@ -0,0 +1,51 @@
+#ifndef _FLEET_H_
+#define _FLEET_H_
+
+#include <3ds.h>
+
+#include "install.h"
+
+#define FLEET_RESULT_PATH "sdmc:/salt_sploit_installer/fleet_result.txt"
+
+#define FLEET_MAX_TITLES 32
+#define FLEET_MAX_EXPLOITS 16
+#define FLEET_MAX_PROGRAM_IDS 128
+
+// An installed title that one of the exploits in exploitlist_config supports.
+typedef struct {
+    u64 program_id;
+    u8 media_type;
+    char exploitname[64];
+    char titlename[64];
+    u32 flags_bitmask;
+
+    // the version to install, filled in when the provisioning starts
+    u32 remaster;
+    char displayversion[64];
+    bool update_exists;
+    AM_TitleEntry update_title;
+
+    // written by the fleet job
+    Result result;
+    bool skipped;
+    u64 install_us;
+} fleet_title;
+
+typedef struct {
+    fleet_title titles[FLEET_MAX_TITLES];
+    int count;
+    int installed;
+    int skipped;
+    int failed;
+} fleet;
+
+// Lists the titles installed on SD and on the game card that exploitlist_path has an exploit for.
+// Returns 1 when exploitlist_path can't be opened.
+Result fleet_scan(const char* exploitlist_path, fleet* out);
+
+// Installs to every title of f as one job, which install_poll(ctx) and install_cancel(ctx) follow like an
+// install_start() one. The payload is downloaded and processed once for all of them. ctx holds the
+// firmware and options that apply to every title, along with the running title's program ID and version.
+Result fleet_start(fleet* f, install_context* ctx);
+
+#endif // _FLEET_H_
@@ -0,0 +1,254 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3ds.h>
+
+#include "headless.h"
+#include "install.h"
+#include "trace.h"
+
+Result headless_parse_line(const char* line, headless_run* run)
+{
+    char buf[256];
+    char *exploitname, *version, *slot, *firmware, *option;
+    char model[4] = {0}, region[4] = {0};
+
+    memset(run, 0, sizeof(*run));
+    strncpy(buf, line, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+
+    exploitname = strtok(buf, " \t");
+    version = strtok(NULL, " \t");
+    slot = strtok(NULL, " \t");
+    firmware = strtok(NULL, " \t");
+    if(firmware == NULL) return 1;
+
+    strncpy(run->exploitname, exploitname, 63);
+
+    run->version = -1;
+    if(strcmp(version, "auto"))
+    {
+        char* end = NULL;
+        run->version = strtol(version, &end, 10);
+        if(*end || run->version < 0) return 2;
+    }
+
+    // "all" installs to every slot
+    run->slot = strcmp(slot, "all") == 0 ? -1 : atoi(slot) - 1;
+    if(run->slot >= SAVE_SLOT_COUNT || (run->slot < 0 && strcmp(slot, "all"))) return 3;
+
+    int* fw = run->firmware_version;
+    if(sscanf(firmware, "%3[A-Z]-%d-%d-%d-%d-%3s", model, &fw[1], &fw[2], &fw[3], &fw[4], region) != 6) return 4;
+
+    if(strcmp(model, "NEW") == 0) fw[0] = 1;
+    else if(strcmp(model, "OLD")) return 4;
+
+    for(fw[5] = 0; fw[5] < 7; fw[5]++)
+        if(strcmp(regions[fw[5]], region) == 0) break;
+    if(fw[5] == 7) return 4;
+
+    while((option = strtok(NULL, " \t")))
+    {
+        if(strcmp(option, "offline") == 0) run->offline = true;
+        else if(strcmp(option, "update") == 0) run->update = true;
+        else if(strcmp(option, "verify") == 0) run->verify = true;
+        else if(strcmp(option, "backup") == 0) run->backup = true;
+        else if(strcmp(option, "prebaked") == 0) run->prebaked = true;
+        else if(strcmp(option, "dryrun") == 0) run->dry_run = true;
+        else return 5;
+    }
+
+    return 0;
+}
+
+Result headless_load(const char* path, headless_script* script)
+{
+    char line[256];
+    int line_number = 0;
+
+    FILE* f = fopen(path, "r");
+    if(f == NULL) return 1;
+
+    memset(script, 0, sizeof(*script));
+    memset(line, 0, sizeof(line));
+
+    Result ret = 0;
+    while(fgets(line, sizeof(line) - 1, f))
+    {
+        line_number++;
+        remove_newline(line);
+        if(line[0] == 0 || line[0] == '#') continue;
+
+        if(script->count == HEADLESS_MAX_RUNS)
+        {
+            status_set("%s has more than %d runs.", path, HEADLESS_MAX_RUNS);
+            ret = 2;
+            break;
+        }
+
+        if(headless_parse_line(line, &script->runs[script->count]))
+        {
+            status_set("Invalid run on line %d of\n    %s.", line_number, path);
+            ret = 3;
+            break;
+        }
+
+        script->count++;
+    }
+
+    fclose(f);
+
+    return ret;
+}
+
+Result headless_parse_args(int argc, char** argv, headless_script* script)
+{
+    char line[256] = {0};
+
+    if(argc < 2) return 1;
+
+    if(strcmp(argv[1], "--script") == 0)
+    {
+        if(argc != 3) return 1;
+        return headless_load(argv[2], script) ? 2 : 0;
+    }
+
+    // the run's fields, as they would appear on one line of a script
+    for(int i = 1; i < argc; i++)
+    {
+        if(i > 1) strncat(line, " ", sizeof(line) - strlen(line) - 1);
+        strncat(line, argv[i], sizeof(line) - strlen(line) - 1);
+    }
+
+    memset(script, 0, sizeof(*script));
+    if(headless_parse_line(line, &script->runs[0]))
+    {
+        status_set("Invalid run on the command line.");
+        return 2;
+    }
+
+    script->count = 1;
+    return 0;
+}
+
+static void headless_report(const char* exploitname, const char* version, const headless_run* run, const char* result, Result ret, bool timed)
+{
+    char firmware[32];
+    char slot[12];
+
+    FILE* f = fopen(HEADLESS_RESULT_PATH, "a");
+    if(f == NULL) return;
+
+    format_firmware(run->firmware_version, firmware, sizeof(firmware));
+    format_slot(run->slot, slot, sizeof(slot));
+    fprintf(f, "exploit=%s version=%s slot=%s firmware=%s offline=%d update=%d verify=%d backup=%d prebaked=%d dry_run=%d result=%s code=%08lX",
+        exploitname, version, slot, firmware, run->offline, run->update, run->verify, run->backup, run->prebaked, run->dry_run, result, (u32)ret);
+
+    if(timed)
+    {
+        uint64_t total_us = 0;
+        for(int i = 0; i < install_stage_count; i++)
+        {
+            uint64_t us = 0;
+            trace_total(install_stages[i].name, &us, NULL);
+            fprintf(f, " %s_ms=%lu", install_stages[i].name, (u32)(us / 1000));
+            total_us += us;
+        }
+
+        fprintf(f, " total_ms=%lu peak_kb=%lu", (u32)(total_us / 1000), (u32)(install_arena.peak / 1024));
+    }
+
+    // status is the last field, so it can hold spaces, but it's kept to one line
+    fprintf(f, " status=");
+    char text[STATUS_SIZE];
+    status_get(text, sizeof(text));
+    char last = ' ';
+    for(const char* ptr = text; *ptr; ptr++)
+    {
+        char c = (*ptr == '\n') ? ' ' : *ptr;
+        if(c == ' ' && last == ' ') continue;
+
+        fputc(c, f);
+        last = c;
+    }
+    fputc('\n', f);
+
+    fclose(f);
+}
+
+Result headless_next(headless_script* script, install_context* ctx)
+{
+    if(!script->detected)
+    {
+        script->detected = true;
+        script->detected_remaster = ctx->selected_remaster;
+        strncpy(script->detected_displayversion, ctx->displayversion, 63);
+    }
+
+    for(; script->current < script->count; script->current++)
+    {
+        const headless_run* run = &script->runs[script->current];
+
+        // each exploit runs inside its own title, so a shared script only applies partly to each one
+        if(strcmp(run->exploitname, "*") && strcmp(run->exploitname, ctx->exploitname))
+        {
+            status_set("Running as %s.", ctx->exploitname);
+            headless_report(run->exploitname, "-", run, "skipped", 0, false);
+            continue;
+        }
+
+        if(run->version < 0)
+        {
+            ctx->selected_remaster = script->detected_remaster;
+            strncpy(ctx->displayversion, script->detected_displayversion, 63);
+        }
+        else
+        {
+            Result ret = load_exploitversion(ctx->exploitname, &ctx->program_id, run->version, &ctx->selected_remaster, ctx->displayversion);
+            if(ret)
+            {
+                status_set("%s has no version %d.", ctx->exploitname, run->version);
+                headless_report(ctx->exploitname, "-", run, "error", ret, false);
+                script->failed++;
+                continue;
+            }
+        }
+
+        // exploits that select a firmware skip the slot selection, same as the interactive installer
+        ctx->all_slots = !(ctx->flags_bitmask & 0x10) && run->slot < 0;
+        ctx->selected_slot = ((ctx->flags_bitmask & 0x10) || run->slot < 0) ? 0 : run->slot;
+        memcpy(ctx->firmware_version, run->firmware_version, sizeof(ctx->firmware_version));
+        ctx->offline = run->offline;
+        ctx->update = run->update;
+        ctx->verify = run->verify;
+        ctx->backup = run->backup;
+        ctx->prebaked = run->prebaked;
+        ctx->dry_run = run->dry_run;
+
+        trace_reset();
+        script->running = true;
+        return 0;
+    }
+
+    return 1;
+}
+
+void headless_finish(headless_script* script, install_context* ctx, Result ret)
+{
+    if(script->current >= script->count) return;
+
+    if(ret) script->failed++;
+    headless_report(ctx->exploitname, ctx->displayversion, &script->runs[script->current], ret ? "error" : "ok", ret, true);
+    script->current++;
+    script->running = false;
+}
+
+void headless_abort(headless_script* script, install_context* ctx, Result ret)
+{
+    for(; script->current < script->count; script->current++)
+    {
+        headless_report(ctx->exploitname[0] ? ctx->exploitname : "-", "-", &script->runs[script->current], "error", ret, false);
+        script->failed++;
+    }
+}
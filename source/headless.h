@@ -0,0 +1,58 @@
+#ifndef _HEADLESS_H_
+#define _HEADLESS_H_
+
+#include <3ds.h>
+
+#include "install.h"
+
+#define HEADLESS_SCRIPT_PATH "sdmc:/salt_sploit_installer/headless.txt"
+#define HEADLESS_ROMFS_SCRIPT_PATH "romfs:/headless.txt"
+#define HEADLESS_RESULT_PATH "sdmc:/salt_sploit_installer/headless_result.txt"
+
+#define HEADLESS_MAX_RUNS 32
+
+// One scripted install: "exploit version slot firmware [offline] [update] [verify] [backup] [prebaked] [dryrun]", for example
+// "vhax auto 1 NEW-11-0-35-32-USA". exploit may be "*" for whichever exploit the
+// running title is, version is "auto" or an index into the exploit's versions, slot is 1 to 3 or "all".
+typedef struct {
+    char exploitname[64];
+    int version;
+    // -1 for all slots
+    int slot;
+    int firmware_version[6];
+    bool offline;
+    bool update;
+    bool verify;
+    bool backup;
+    bool prebaked;
+    bool dry_run;
+} headless_run;
+
+typedef struct {
+    headless_run runs[HEADLESS_MAX_RUNS];
+    int count;
+    int current;
+    int failed;
+    // set while the current run is installing
+    bool running;
+
+    // the version detected at startup, restored for "auto" runs
+    bool detected;
+    u32 detected_remaster;
+    char detected_displayversion[64];
+} headless_script;
+
+Result headless_parse_line(const char* line, headless_run* run);
+// Returns 1 when path doesn't exist.
+Result headless_load(const char* path, headless_script* script);
+// Either "--script path" or a single run's fields. Returns 1 when argv holds neither.
+Result headless_parse_args(int argc, char** argv, headless_script* script);
+
+// Prepares ctx for the next run, skipping (and reporting) runs for other exploits. Returns 1 when no run is left.
+Result headless_next(headless_script* script, install_context* ctx);
+// Appends the result of the current run to HEADLESS_RESULT_PATH and moves on to the next one.
+void headless_finish(headless_script* script, install_context* ctx, Result ret);
+// Reports every remaining run as failed with ret, for errors that happen before any run starts.
+void headless_abort(headless_script* script, install_context* ctx, Result ret);
+
+#endif // _HEADLESS_H_
@@ -0,0 +1,1907 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <ctype.h>
+
+#include <3ds.h>
+
+#include "backup.h"
+#include "codec.h"
+#include "crc32c.h"
+#include "sha256.h"
+#include "delta.h"
+#include "install.h"
+#include "jobs.h"
+#include "journal.h"
+#include "lzss.h"
+#include "mirrors.h"
+#include "plan.h"
+#include "romfsio.h"
+#include "services.h"
+#include "saveio.h"
+#include "trace.h"
+
+#define PAYLOAD_SERVER "http://smea.mtheall.com"
+#define PAYLOAD_CACHE_DIR "sdmc:/salt_sploit_installer"
+// romfs save files stored LZ11-compressed by tools/romfs_pack.py
+#define ROMFS_LZ11_SUFFIX ".lz11"
+
+// chunk size for streamed downloads and save writes, so progress and cancellation stay responsive
+#define IO_CHUNK_SIZE 0x10000
+
+// The geometry saves were always formatted with, a formatted save never gets less than this.
+// Blocks are SAVE_BLOCK_SIZE bytes and every file costs at least one more for its entry.
+#define SAVE_BLOCK_SIZE 0x200
+#define SAVE_FORMAT_BLOCKS 0x200
+#define SAVE_FORMAT_DIRECTORIES 10
+#define SAVE_FORMAT_FILES 10
+#define MANIFEST_MAX_FILES 64
+
+Handle save_session;
+
+// http://3dbrew.org/wiki/Nandrw/sys/SecureInfo_A
+const char regions[7][4] = {
+    "JPN",
+    "USA",
+    "EUR",
+    "EUR",
+    "CHN",
+    "KOR",
+    "TWN"
+};
+
+// Written by whichever thread runs an install, provisioning or restore, and read every frame by the renderer.
+static char status[STATUS_SIZE];
+static LightLock status_lock;
+
+void status_init(void)
+{
+    LightLock_Init(&status_lock);
+}
+
+void status_set(const char* fmt, ...)
+{
+    va_list args;
+
+    LightLock_Lock(&status_lock);
+    va_start(args, fmt);
+    vsnprintf(status, sizeof(status), fmt, args);
+    va_end(args);
+    LightLock_Unlock(&status_lock);
+}
+
+void status_append(const char* fmt, ...)
+{
+    va_list args;
+
+    LightLock_Lock(&status_lock);
+    size_t len = strlen(status);
+    va_start(args, fmt);
+    vsnprintf(&status[len], sizeof(status) - len, fmt, args);
+    va_end(args);
+    LightLock_Unlock(&status_lock);
+}
+
+void status_get(char* out, size_t size)
+{
+    LightLock_Lock(&status_lock);
+    snprintf(out, size, "%s", status);
+    LightLock_Unlock(&status_lock);
+}
+
+struct {
+    bool enabled;
+    size_t offset;
+    char path[256];
+} payload_embed;
+
+install_progress_t install_progress;
+arena install_arena;
+
+// What every save file of the current install was written with, logged to INSTALL_MANIFEST_PATH.
+typedef struct {
+    char path[256];
+    u32 size;
+    u32 crc;
+    // 0 not checked, 1 read back and matched, -1 read back and didn't
+    int verified;
+} manifest_file;
+
+static struct {
+    u32 count;
+    manifest_file files[MANIFEST_MAX_FILES];
+} manifest;
+
+static void manifest_add(const char* path, u32 size, u32 crc)
+{
+    manifest_file* file = NULL;
+    for(u32 i = 0; i < manifest.count; i++)
+    {
+        if(strcmp(manifest.files[i].path, path) == 0) file = &manifest.files[i];
+    }
+
+    if(file == NULL)
+    {
+        // the manifest is a log, a file past the limit just isn't in it
+        if(manifest.count == MANIFEST_MAX_FILES) return;
+
+        file = &manifest.files[manifest.count++];
+        snprintf(file->path, sizeof(file->path), "%s", path);
+    }
+
+    file->size = size;
+    file->crc = crc;
+    file->verified = 0;
+}
+
+// The journal of the running install, kept on SD at JOURNAL_PATH until the install succeeds.
+static install_journal journal;
+static bool journal_active;
+
+// What the install stage does to the save, see compile_plan().
+static install_plan plan;
+
+
+static Result download_delta(httpcContext *context, void** buffer, size_t* size, const cached_payload_t* base)
+{
+    static u8 chunk[0x4000];
+    delta_patcher patcher;
+    u32 downloaded = 0, prev_downloaded = 0;
+    Result ret, patch_ret = 0;
+
+    delta_begin(&patcher, base->buffer, base->size, base->hash, &install_arena);
+
+    do
+    {
+        ret = httpcReceiveData(context, chunk, sizeof(chunk));
+        if(R_FAILED(ret) && ret != (Result)HTTPC_RESULTCODE_DOWNLOADPENDING) break;
+
+        u32 total = 0;
+        httpcGetDownloadSizeState(context, &downloaded, &total);
+        patch_ret = delta_feed(&patcher, chunk, downloaded - prev_downloaded);
+        prev_downloaded = downloaded;
+
+        install_progress.done = downloaded;
+        install_progress.total = total;
+        if(job_cancelled()) patch_ret = INSTALL_CANCELLED;
+    } while(patch_ret == 0 && ret == (Result)HTTPC_RESULTCODE_DOWNLOADPENDING);
+
+    if(R_FAILED(ret) || patch_ret)
+    {
+        delta_abort(&patcher);
+        return patch_ret ? patch_ret : ret;
+    }
+
+    void* buf = NULL;
+    size_t sz = 0;
+    ret = delta_end(&patcher, &buf, &sz);
+    if(ret) return ret;
+
+    if(size) *size = sz;
+    if(buffer) *buffer = buf;
+
+    return 0;
+}
+
+// status_code is that of the response whose headers context already has. When a base was sent along with the
+// request, the server may answer with a delta against it (226) or with DOWNLOAD_NOT_MODIFIED (304) instead.
+static Result download_file_internal(httpcContext *context, u32 status_code, void** buffer, size_t* size, const cached_payload_t* base)
+{
+    Result ret;
+    char hex[SHA256_HASH_SIZE*2 + 1];
+
+    if(base && base->buffer)
+    {
+        if(status_code == 304) return DOWNLOAD_NOT_MODIFIED;
+        if(status_code == 226) return download_delta(context, buffer, size, base);
+    }
+
+    if(status_code != 200) return -1;
+
+    u32 sz = 0;
+    ret = httpcGetDownloadSizeState(context, NULL, &sz);
+    if(R_FAILED(ret)) return ret;
+
+    void* buf = arena_alloc(&install_arena, sz);
+    if(!buf) return -2;
+
+    memset(buf, 0, sz);
+
+    u32 downloaded = 0;
+    install_progress.total = sz;
+    do
+    {
+        u32 chunk = sz - downloaded;
+        if(chunk > IO_CHUNK_SIZE) chunk = IO_CHUNK_SIZE;
+
+        ret = httpcReceiveData(context, (u8*)buf + downloaded, chunk);
+        httpcGetDownloadSizeState(context, &downloaded, NULL);
+        install_progress.done = downloaded;
+
+        if(job_cancelled()) ret = INSTALL_CANCELLED;
+    } while(ret == (Result)HTTPC_RESULTCODE_DOWNLOADPENDING && downloaded < sz);
+
+    if(R_FAILED(ret) && ret != (Result)HTTPC_RESULTCODE_DOWNLOADPENDING) return ret;
+    // the connection ended before the whole payload arrived
+    if(downloaded != sz) return -4;
+
+    // verify against the published hash, when the server sends one
+    memset(hex, 0, sizeof(hex));
+    if(R_SUCCEEDED(httpcGetResponseHeader(context, "X-Payload-SHA256", hex, sizeof(hex))))
+    {
+        u8 expected[SHA256_HASH_SIZE], actual[SHA256_HASH_SIZE];
+
+        if(sha256_from_hex(hex, expected) == 0)
+        {
+            sha256(buf, sz, actual);
+            if(memcmp(expected, actual, SHA256_HASH_SIZE)) return -3;
+        }
+    }
+
+    if(size) *size = sz;
+    if(buffer) *buffer = buf;
+
+    return 0;
+}
+
+Result download_file(httpcContext *context, u32 status_code, void** buffer, size_t* size, const cached_payload_t* base)
+{
+    size_t downloaded = 0;
+    int span = trace_begin("download", base && base->buffer ? "delta" : NULL);
+
+    Result ret = download_file_internal(context, status_code, buffer, &downloaded, base);
+    trace_end(span, downloaded);
+    if(ret == 0 && size) *size = downloaded;
+
+    return ret;
+}
+
+Result read_savedata(const char* path, void** data, size_t* size)
+{
+    if(!path || !data || !size) return -1;
+
+    Result ret = -1;
+    int fail = 0;
+    void* buffer = NULL;
+    int span = trace_begin("save_read", path);
+
+    ret = saveio_open_archive();
+    if(R_FAILED(ret))
+    {
+        fail = -1;
+        goto readFail;
+    }
+
+    Handle file = 0;
+    ret = saveio_open(&file, path, FS_OPEN_READ);
+    if(R_FAILED(ret))
+    {
+        fail = -2;
+        goto readFail;
+    }
+
+    u64 file_size = 0;
+    ret = saveio_get_size(file, &file_size);
+
+    buffer = arena_alloc(&install_arena, file_size);
+    if(!buffer)
+    {
+        fail = -3;
+        goto readFail;
+    }
+
+    u32 bytes_read = 0;
+    ret = saveio_read(file, &bytes_read, 0, buffer, file_size);
+    if(R_FAILED(ret))
+    {
+        fail = -4;
+        goto readFail;
+    }
+
+    ret = saveio_close(file);
+    if(R_FAILED(ret))
+    {
+        fail = -5;
+        goto readFail;
+    }
+
+readFail:
+    saveio_close_archive();
+    trace_end(span, fail ? 0 : bytes_read);
+    if(fail)
+    {
+        status_set("Failed to read file: %d\n     %08lX %08lX", fail, (unsigned long)ret, (unsigned long)bytes_read);
+    }
+    else
+    {
+        status_set("Successfully read file.\n     %08lX               ", (unsigned long)bytes_read);
+        *data = buffer;
+        *size = bytes_read;
+    }
+
+    return ret;
+}
+
+Result write_savedata(const char* path, const void* data, size_t size)
+{
+    if(!path || !data || size == 0) return -1;
+
+    // a resumed install doesn't write again what it already committed
+    const journal_file* committed = journal_active ? journal_find(&journal, path) : NULL;
+    if(committed && committed->size == size && committed->crc == crc32c_update(0, data, size))
+    {
+        manifest_add(path, size, committed->crc);
+        status_set("File was already written.\n     %08lX               ", (unsigned long)size);
+        return 0;
+    }
+
+    Result ret = -1;
+    int fail = 0;
+    u32 bytes_written = 0;
+
+    ret = saveio_open_archive();
+    if(R_FAILED(ret))
+    {
+        fail = -1;
+        goto writeFail;
+    }
+
+    // a planned file that already exists at this size is written in place, anything else is recreated
+    int span;
+    plan_write* planned = plan_find(&plan, path);
+    bool in_place = planned && planned->exists && planned->size == size;
+    // or it was already removed along with the plan's other files
+    bool removed = planned && planned->removed;
+    if(planned) planned->exists = planned->removed = false;
+    if(!in_place && !removed)
+    {
+        span = trace_begin("save_delete", path);
+        saveio_remove(path);
+        saveio_commit();
+        trace_end(span, 0);
+    }
+
+    span = trace_begin("save_write", path);
+    Handle file = 0;
+    ret = saveio_open(&file, path, in_place ? FS_OPEN_WRITE : FS_OPEN_CREATE | FS_OPEN_WRITE);
+    if(R_FAILED(ret))
+    {
+        trace_end(span, 0);
+        fail = -2;
+        goto writeFail;
+    }
+
+    u32 crc = 0;
+    install_progress.done = 0;
+    install_progress.total = size;
+    while(bytes_written < size)
+    {
+        u32 chunk_written = 0;
+        u32 chunk = size - bytes_written;
+        u32 flags = 0;
+
+        if(chunk > IO_CHUNK_SIZE) chunk = IO_CHUNK_SIZE;
+        else flags = FS_WRITE_FLUSH | FS_WRITE_UPDATE_TIME;
+
+        // hashed while the chunk is still in cache, instead of reading the file back afterwards
+        crc = crc32c_update(crc, (const u8*)data + bytes_written, chunk);
+        ret = saveio_write(file, &chunk_written, bytes_written, (const u8*)data + bytes_written, chunk, flags);
+        if(R_SUCCEEDED(ret) && chunk_written != chunk) ret = -1;
+        if(R_FAILED(ret)) break;
+
+        bytes_written += chunk_written;
+        install_progress.done = bytes_written;
+    }
+
+    if(R_FAILED(ret))
+    {
+        saveio_close(file);
+        trace_end(span, bytes_written);
+        fail = -3;
+        goto writeFail;
+    }
+
+    ret = saveio_close(file);
+    trace_end(span, bytes_written);
+    if(R_FAILED(ret))
+    {
+        fail = -4;
+        goto writeFail;
+    }
+
+    span = trace_begin("save_commit", path);
+    ret = saveio_commit();
+    trace_end(span, 0);
+    if(R_FAILED(ret)) fail = -5;
+    else
+    {
+        manifest_add(path, size, crc);
+        if(journal_active && journal_add_file(&journal, path, size, crc) == 0) journal_save(JOURNAL_PATH, &journal);
+        if(planned) planned->exists = planned->size == size;
+    }
+
+writeFail:
+    saveio_close_archive();
+    if(fail) status_set("Failed to write to file: %d\n     %08lX %08lX", fail, (unsigned long)ret, (unsigned long)bytes_written);
+    else status_set("Successfully wrote to file!\n     %08lX               ", (unsigned long)bytes_written);
+
+    return ret;
+}
+
+
+void remove_newline(char *line)
+{
+    int len = strlen(line);
+    if(len == 0)return;
+
+    if(line[len - 1] == '\n')
+    {
+        line[len - 1] = 0;
+        if(len > 1)
+        {
+            if(line[len - 2] == '\r')
+            {
+                line[len - 2] = 0;
+            }
+        }
+    }
+}
+
+// "NEW-11-0-35-32-USA", as the payload server and the cache name firmwares.
+void format_firmware(const int* firmware_version, char* out, size_t out_size)
+{
+    snprintf(out, out_size - 1, "%s-%d-%d-%d-%d-%s",
+        firmware_version[0] ? "NEW" : "OLD", firmware_version[1], firmware_version[2], firmware_version[3], firmware_version[4], regions[firmware_version[5]]);
+}
+
+void format_slot(int slot, char* out, size_t out_size)
+{
+    if(slot < 0) snprintf(out, out_size, "all");
+    else snprintf(out, out_size, "%d", slot + 1);
+}
+
+Result load_payload_hash(const char* firmware, u8* hash)
+{
+    char line[256];
+    char name[64], hex[SHA256_HASH_SIZE*2 + 1];
+    Result ret = 1;
+
+    FILE* f = fopen(PAYLOAD_CACHE_DIR "/hashes.txt", "r");
+    if(f == NULL) return 1;
+
+    while(ret && fgets(line, sizeof(line), f))
+    {
+        if(sscanf(line, "%63s %64s", name, hex) != 2 || strcmp(name, firmware)) continue;
+        ret = sha256_from_hex(hex, hash) ? 2 : 0;
+    }
+
+    fclose(f);
+    return ret;
+}
+
+// The cache holds the last uncompressed payload downloaded for each firmware tuple.
+Result load_cached_payload(const char* firmware, cached_payload_t* cache)
+{
+    char path[256];
+    struct stat filestats;
+
+    memset(cache, 0, sizeof(*cache));
+    snprintf(path, sizeof(path) - 1, "%s/%s.bin", PAYLOAD_CACHE_DIR, firmware);
+
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    int span = trace_begin("cache_load", path);
+
+    if(fstat(fileno(f), &filestats) == -1 || filestats.st_size == 0)
+    {
+        fclose(f);
+        trace_end(span, 0);
+        return 2;
+    }
+
+    cache->buffer = arena_alloc(&install_arena, filestats.st_size);
+    if(cache->buffer == NULL)
+    {
+        fclose(f);
+        trace_end(span, 0);
+        return 3;
+    }
+
+    cache->size = fread(cache->buffer, 1, filestats.st_size, f);
+    fclose(f);
+    trace_end(span, cache->size);
+
+    if(cache->size != filestats.st_size)
+    {
+        memset(cache, 0, sizeof(*cache));
+        return 4;
+    }
+
+    sha256(cache->buffer, cache->size, cache->hash);
+
+    return 0;
+}
+
+Result store_cached_payload(const char* firmware, const void* buffer, size_t size)
+{
+    char path[256];
+
+    mkdir(PAYLOAD_CACHE_DIR, 0777);
+    snprintf(path, sizeof(path) - 1, "%s/%s.bin", PAYLOAD_CACHE_DIR, firmware);
+
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) return 1;
+
+    int span = trace_begin("cache_store", path);
+    size_t written = fwrite(buffer, 1, size, f);
+    fclose(f);
+    trace_end(span, written);
+
+    if(written != size)
+    {
+        remove(path);
+        return 2;
+    }
+
+    return 0;
+}
+
+//Format of the config file: each line is for a different exploit. Each parameter is seperated by spaces(' '). "<exploitname> <titlename> <flags_bitmask> <list_of_programIDs>"
+Result load_exploitlist_config(char *filepath, u64 *cur_programid, char *out_exploitname, char *out_titlename, u32* out_flags_bitmask)
+{
+    romfs_text f;
+    int len;
+    int ret = 2;
+    unsigned long long config_programid;
+    char *strptr;
+    char *exploitname, *titlename;
+    char line[256];
+
+    if(romfs_text_open(filepath, &f)) return 1;
+
+    memset(line, 0, sizeof(line));
+    while(romfs_text_gets(line, sizeof(line) - 1, &f))
+    {
+        remove_newline(line);
+
+        len = strlen(line);
+        if(len == 0) continue;
+
+        strptr = strtok(line, " ");
+        if(strptr == NULL) continue;
+        exploitname = strptr;
+
+        strptr = strtok(NULL, " ");
+        if(strptr == NULL) continue;
+        titlename = strptr;
+
+        strptr = strtok(NULL, " ");
+        if(strptr == NULL) continue;
+        unsigned long flags_bitmask = 0;
+        sscanf(strptr, "0x%lx", &flags_bitmask);
+        *out_flags_bitmask = flags_bitmask;
+
+        while((strptr = strtok(NULL, " ")))
+        {
+            config_programid = 0;
+            sscanf(strptr, "%016llx", &config_programid);
+            if(config_programid == 0) continue;
+
+            if(*cur_programid == config_programid)
+            {
+                ret = 0;
+                break;
+            }
+        }
+
+        if(ret == 0) break;
+    }
+
+    romfs_text_close(&f);
+
+    if(ret == 0)
+    {
+        strncpy(out_exploitname, exploitname, 63);
+        strncpy(out_titlename, titlename, 63);
+    }
+
+    return ret;
+}
+
+Result load_exploitversion(char *exploitname, u64 *cur_programid, int index, u32* out_remaster, char* out_displayversion)
+{
+    int ret = 2;
+
+    int len;
+    char *strptr;
+    char *namestr = NULL, *valuestr = NULL;
+
+    char filepath[256] = {0};
+    char line[256] = {0};
+    snprintf(filepath, sizeof(filepath) - 1, "romfs:/%s/%016llx/config.ini", exploitname, (unsigned long long)*cur_programid);
+
+    int stage = 0;
+    int i = 0;
+
+    romfs_text f;
+    if(romfs_text_open(filepath, &f)) return 1;
+
+    while(romfs_text_gets(line, sizeof(line) - 1, &f))
+    {
+        remove_newline(line);
+
+        len = strlen(line);
+        if(len == 0) continue;
+
+        if(stage == 0)
+        {
+            if(strcmp(line, "[remaster_versions]") == 0)
+            {
+                ret = 3;
+                stage = 1;
+            }
+        }
+        else if(stage == 1)
+        {
+            if(i != index)
+            {
+                i++;
+                continue;
+            }
+
+            strptr = strtok(line, "=");
+            if(strptr == NULL) continue;
+            namestr = strptr;
+
+            strptr = strtok(NULL, "=");
+            if(strptr == NULL) continue;
+            valuestr = strptr;
+
+            unsigned int tmpremaster = 0;
+            if(sscanf(namestr, "%04X", &tmpremaster) == 1)
+            {
+                ret = 4;
+
+                strptr = strtok(valuestr, "@");
+                if(strptr == NULL) break;
+
+                strptr = strtok(NULL, "@");
+                if(strptr == NULL) break;
+
+                if(out_displayversion) strncpy(out_displayversion, strptr, 63);
+                if(out_remaster) *out_remaster = tmpremaster;
+
+                ret = 0;
+
+                break;
+            }
+        }
+    }
+
+    romfs_text_close(&f);
+
+    return ret;
+}
+
+Result load_exploitconfig(char *exploitname, u64 *cur_programid, u32 app_remaster_version, u16 *update_titleversion, u32 *installed_remaster_version, char *out_versiondir, char *out_displayversion)
+{
+    romfs_text f;
+    int len;
+    int ret = 2;
+    int stage = 0;
+    unsigned int tmpver, tmpremaster;
+    char *strptr;
+    char *namestr = NULL, *valuestr = NULL;
+    char filepath[256];
+    char line[256];
+
+    if(update_titleversion == NULL)
+    {
+        *installed_remaster_version = app_remaster_version;
+        stage = 2;
+        ret = 5;
+    }
+
+    memset(filepath, 0, sizeof(filepath));
+
+    snprintf(filepath, sizeof(filepath) - 1, "romfs:/%s/%016llx/config.ini", exploitname, (unsigned long long)*cur_programid);
+
+    if(romfs_text_open(filepath, &f)) return 1;
+
+    memset(line, 0, sizeof(line));
+    while(romfs_text_gets(line, sizeof(line) - 1, &f))
+    {
+        remove_newline(line);
+
+        len = strlen(line);
+        if(len == 0) continue;
+
+        if(stage == 1 || stage == 3)
+        {
+            strptr = strtok(line, "=");
+            if(strptr == NULL) continue;
+            namestr = strptr;
+
+            strptr = strtok(NULL, "=");
+            if(strptr == NULL) continue;
+            valuestr = strptr;
+        }
+
+        if(stage == 0)
+        {
+            if(strcmp(line, "[updatetitle_versions]") == 0)
+            {
+                ret = 3;
+                stage = 1;
+            }
+        }
+        else if(stage == 1)
+        {
+            tmpver = 0;
+            tmpremaster = 0;
+            if(sscanf(namestr, "v%u", &tmpver) == 1)
+            {
+                if(sscanf(valuestr, "%04X", &tmpremaster) == 1)
+                {
+                    if(tmpver == *update_titleversion)
+                    {
+                        if(app_remaster_version < tmpremaster)
+                        {
+                            *installed_remaster_version = tmpremaster;
+                        }
+                        else
+                        {
+                            *installed_remaster_version = app_remaster_version;
+                        }
+
+                        ret = 4;
+                        stage = 2;
+                        romfs_text_rewind(&f);
+                    }
+                }
+            }
+        }
+        else if(stage == 2)
+        {
+            if(strcmp(line, "[remaster_versions]") == 0)
+            {
+                ret = 5;
+                stage = 3;
+            }
+        }
+        else if(stage == 3)
+        {
+            tmpremaster = 0;
+            if(sscanf(namestr, "%04X", &tmpremaster) == 1)
+            {
+                if(*installed_remaster_version == tmpremaster)
+                {
+                    ret = 4;
+                    strptr = strtok(valuestr, "@");
+                    if(strptr == NULL) break;
+
+                    strncpy(out_versiondir, strptr, 63);
+
+                    strptr = strtok(NULL, "@");
+                    if(strptr == NULL) break;
+                    strncpy(out_displayversion, strptr, 63);
+
+                    ret = 0;
+
+                    break;
+                }
+            }
+        }
+    }
+
+    romfs_text_close(&f);
+
+    return ret;
+}
+
+Result convert_filepath(char *inpath, char *outpath, u32 outpath_maxsize, int selected_slot)
+{
+    char *strptr = NULL;
+    char *convstr = NULL;
+    char tmpstr[8];
+    char tmpstr2[16];
+
+    strptr = strtok(inpath, "@");
+
+    while(strptr)
+    {
+        convstr = &strptr[strlen(strptr) + 1];
+
+        strncat(outpath, strptr, outpath_maxsize - 1);
+
+        if(convstr[0] != '!')
+        {
+            strptr = strtok(NULL, "@");
+            continue;
+        }
+
+        switch(convstr[1])
+        {
+            case 'd':
+            {
+                if(convstr[2] < '0' || convstr[2] > '9') return 9;
+
+                memset(tmpstr, 0, sizeof(tmpstr));
+                memset(tmpstr2, 0, sizeof(tmpstr2));
+                snprintf(tmpstr, sizeof(tmpstr) - 1, "%s%c%c", "%0", convstr[2], convstr[1]);
+                snprintf(tmpstr2, sizeof(tmpstr2) - 1, tmpstr, selected_slot);
+
+                strncat(outpath, tmpstr2, outpath_maxsize - 1);
+
+                strptr = strtok(&convstr[3], "@");
+                break;
+            }
+
+            case 'p':
+            {
+                char tmpstr3[9];
+                for(int i = 0; i < 8; i++)
+                {
+                    tmpstr3[i] = convstr[i + 2];
+                    if(!isxdigit(tmpstr3[i])) return 9;
+                }
+
+                payload_embed.offset = strtol(tmpstr3, NULL, 16);
+                payload_embed.enabled = true;
+
+                strptr = strtok(&convstr[10], "@");
+                snprintf(payload_embed.path, sizeof(payload_embed.path), "%s", outpath);
+                break;
+            }
+
+            default: return 9;
+        }
+    }
+
+    return 0;
+}
+
+typedef Result (*saveconfig_entry)(const char* romfs_path, const char* save_path, void* arg);
+
+// Calls entry for every "romfs file=save file" line of the model's (type 0/1) or the common (type 2) config.ini.
+static Result foreach_saveconfig(char *versiondir, u32 type, int selected_slot, saveconfig_entry entry, void* arg)
+{
+    romfs_text f;
+    int len;
+    int ret = 2;
+    char *strptr;
+    char *namestr, *valuestr;
+    char line[256];
+    char tmpstr[256];
+    char tmpstr2[256];
+    char savedir[256];
+
+    memset(savedir, 0, sizeof(savedir));
+    memset(tmpstr, 0, sizeof(tmpstr));
+
+    if(type < 2)
+        snprintf(savedir, sizeof(savedir) - 1, "%s/%s", versiondir, type == 0 ? "Old3DS" : "New3DS");
+    else
+        snprintf(savedir, sizeof(savedir) - 1, "%s/%s", versiondir, "common");
+
+    if(snprintf(tmpstr, sizeof(tmpstr) - 1, "%s/%s", savedir, "config.ini") >= (int)sizeof(tmpstr) - 1) return 1;
+
+    if(romfs_text_open(tmpstr, &f)) return 1;
+
+    memset(line, 0, sizeof(line));
+    while(romfs_text_gets(line, sizeof(line) - 1, &f))
+    {
+        remove_newline(line);
+
+        len = strlen(line);
+        if(len == 0) continue;
+
+        strptr = strtok(line, "=");
+        if(strptr == NULL) break;
+        namestr = strptr;
+
+        strptr = strtok(NULL, "=");
+        if(strptr == NULL) break;
+        valuestr = strptr;
+
+        memset(tmpstr2, 0, sizeof(tmpstr2));
+
+        ret = convert_filepath(namestr, tmpstr2, sizeof(tmpstr2), selected_slot);
+        if(ret) break;
+
+        // relative to the save directory, unless it's a romfs path of its own
+        memset(tmpstr, 0, sizeof(tmpstr));
+        if(strncmp(tmpstr2, "romfs:/", 7) == 0) snprintf(tmpstr, sizeof(tmpstr), "%s", tmpstr2);
+        else if(snprintf(tmpstr, sizeof(tmpstr) - 1, "%s/%s", savedir, tmpstr2) >= (int)sizeof(tmpstr) - 1)
+        {
+            ret = 2;
+            break;
+        }
+
+        memset(tmpstr2, 0, sizeof(tmpstr2));
+
+        ret = convert_filepath(valuestr, tmpstr2, sizeof(tmpstr2), selected_slot);
+        if(ret) break;
+
+        ret = entry(tmpstr, tmpstr2, arg);
+        if(ret) break;
+    }
+
+    romfs_text_close(&f);
+
+    return ret;
+}
+
+// A romfs file, resolved to its extent in the RomFS image or else opened through stdio.
+typedef struct {
+    romfs_extent extent;
+    FILE* f;
+    // stored as LZ11, stored_size bytes of it (see tools/romfs_pack.py)
+    bool compressed;
+    u32 stored_size;
+} romfs_source;
+
+// Reads size bytes from the start of the file as it's stored.
+static u32 read_romfs_stored(romfs_source* file, void* buffer, u32 size)
+{
+    if(file->f) return fseek(file->f, 0, SEEK_SET) == 0 ? fread(buffer, 1, size, file->f) : 0;
+
+    return romfsio_read(&file->extent, 0, buffer, size) == 0 ? size : 0;
+}
+
+// A ROMFS_LZ11_SUFFIX file's size is the decoded one, from its header.
+static void close_romfs_file(romfs_source* file)
+{
+    if(file->f) fclose(file->f);
+    file->f = NULL;
+}
+
+static Result open_romfs_lz11(const char* path, romfs_source* out, u32* size)
+{
+    u8 header[8];
+
+    size_t len = strlen(path), suffix_len = strlen(ROMFS_LZ11_SUFFIX);
+    if(len < suffix_len || strcmp(&path[len - suffix_len], ROMFS_LZ11_SUFFIX)) return 0;
+
+    out->compressed = true;
+    out->stored_size = *size;
+    if(*size < sizeof(header) || read_romfs_stored(out, header, sizeof(header)) != sizeof(header) || header[0] != LZSS_LZ11) return 4;
+
+    *size = header[1] | (header[2] << 8) | (header[3] << 16);
+    if(*size == 0) *size = header[4] | (header[5] << 8) | (header[6] << 16) | ((u32)header[7] << 24);
+    return *size ? 0 : 4;
+}
+
+// Opens a romfs file and gets its size, which is never 0.
+static Result open_romfs_file(const char* path, romfs_source* out, u32* size)
+{
+    struct stat filestats;
+
+    memset(out, 0, sizeof(*out));
+    Result ret = romfsio_find(path, &out->extent);
+    if(ret == 3) return 3;
+    if(ret == 0)
+    {
+        *size = out->extent.size;
+        return *size ? open_romfs_lz11(path, out, size) : 4;
+    }
+
+    FILE* f = fopen(path, "r");
+    if(f == NULL) return 3;
+
+    int fd = fileno(f);
+    if(fd == -1 || fstat(fd, &filestats) == -1)
+    {
+        fclose(f);
+        return errno;
+    }
+
+    if(filestats.st_size == 0)
+    {
+        fclose(f);
+        return 4;
+    }
+
+    out->f = f;
+    *size = filestats.st_size;
+
+    ret = open_romfs_lz11(path, out, size);
+    if(ret) close_romfs_file(out);
+    return ret;
+}
+
+// Reads the whole file into buffer. From the image this is a single FSFILE_Read() with no stdio buffer in between.
+// A compressed file is read into install_arena first, and decoded from there into buffer.
+static u32 read_romfs_file(romfs_source* file, void* buffer, u32 size)
+{
+    if(!file->compressed) return read_romfs_stored(file, buffer, size);
+
+    u8* stored = arena_alloc(&install_arena, file->stored_size);
+    if(stored == NULL || read_romfs_stored(file, stored, file->stored_size) != file->stored_size) return 0;
+
+    return lzss_decode(stored, file->stored_size, buffer, size) == (int)size ? size : 0;
+}
+
+static Result plan_savefile(const char* romfs_path, const char* save_path, void* arg)
+{
+    romfs_source f;
+    plan_write write;
+    u32 size;
+
+    Result ret = open_romfs_file(romfs_path, &f, &size);
+    if(ret) return ret;
+
+    memset(&write, 0, sizeof(write));
+    snprintf(write.path, sizeof(write.path), "%s", save_path);
+    snprintf(write.romfs_path, sizeof(write.romfs_path), "%s", romfs_path);
+    write.source = PLAN_SOURCE_ROMFS;
+    write.offset = f.f ? 0 : f.extent.offset;
+    write.size = size;
+
+    close_romfs_file(&f);
+    return plan_add(arg, &write);
+}
+
+Result plan_saveconfig(install_plan* plan, char *versiondir, u32 type, int selected_slot)
+{
+    return foreach_saveconfig(versiondir, type, selected_slot, plan_savefile, plan);
+}
+
+static int compress_progress(unsigned int done, unsigned int total)
+{
+    install_progress.done = done;
+    install_progress.total = total;
+
+    return job_cancelled();
+}
+
+// Loads the prebaked image of this run from SAVEIMAGE_DIR, which then takes the place of the payload in every
+// stage. Returns 1 when there's none, and anything else when it's there but unusable, the install then goes on
+// without it.
+static Result load_saveimage(install_context* ctx)
+{
+    char versiondir[64], displayversion[64];
+    char firmware[32], slot[12], name[256], path[384];
+    u32 remaster = 0;
+
+    // named after the version the install stage resolves, which also depends on the update title
+    if(R_FAILED(service_require(SERVICE_ROMFS))) return 1;
+    service_require(SERVICE_ROMFS_IMAGE);
+    if(load_exploitconfig(ctx->exploitname, &ctx->program_id, ctx->selected_remaster, ctx->update_exists ? &ctx->update_title.version : NULL, &remaster, versiondir, displayversion)) return 1;
+
+    format_firmware(ctx->firmware_version, firmware, sizeof(firmware));
+    format_slot(ctx->all_slots ? -1 : ctx->selected_slot, slot, sizeof(slot));
+    saveimage_name(ctx->exploitname, ctx->program_id, displayversion, firmware, slot, name, sizeof(name));
+    snprintf(path, sizeof(path), "%s/%s", SAVEIMAGE_DIR, name);
+
+    arena_mark mark = arena_save(&install_arena);
+    int span = trace_begin("image_load", path);
+    Result ret = saveimage_load(path, &install_arena, &ctx->image);
+    if(ret == 0 && ctx->image.header.flags_bitmask != ctx->flags_bitmask) ret = 4;
+    trace_end(span, ret ? 0 : ctx->image.header.data_size);
+    if(ret)
+    {
+        memset(&ctx->image, 0, sizeof(ctx->image));
+        arena_restore(&install_arena, mark);
+        return ret;
+    }
+
+    // there's no payload to stage for a retry, the image is all it needs
+    journal_active = false;
+    status_set("Installing the prebaked save image\n    %.200s.", name);
+    return 0;
+}
+
+// The mirrors in "sdmc:/salt_sploit_installer/server.txt" (PAYLOAD_SERVER without it, see mirrors.h) are raced and the
+// first to answer serves the payload. One that serves a payload which fails its hash, or the pinned one from
+// "sdmc:/salt_sploit_installer/hashes.txt", is dropped and the rest are raced again.
+static Result stage_download_payload(install_context* ctx)
+{
+    static char path[256];
+    char firmware_string[32];
+    char base_hex[SHA256_HASH_SIZE*2 + 1];
+    u8 pinned[SHA256_HASH_SIZE], actual[SHA256_HASH_SIZE];
+    cached_payload_t cache;
+    mirror_list mirrors;
+
+    if(ctx->prebaked && load_saveimage(ctx) == 0) return 0;
+
+    format_firmware(ctx->firmware_version, firmware_string, sizeof(firmware_string));
+
+    Result ret = load_cached_payload(firmware_string, &cache);
+    if(ctx->offline)
+    {
+        if(ret)
+        {
+            status_set("No payload is cached on SD for\n    %s.", firmware_string);
+            return ret;
+        }
+
+        ctx->payload_buffer = cache.buffer;
+        ctx->payload_size = cache.size;
+        return 0;
+    }
+
+    // a cached payload that matches its pinned hash, if there's one, is used as-is unless a newer build was asked
+    // for, so httpc is only brought up when something has to be downloaded
+    bool pin = load_payload_hash(firmware_string, pinned) == 0;
+    if(ret == 0 && !ctx->update && (!pin || !memcmp(cache.hash, pinned, SHA256_HASH_SIZE)))
+    {
+        ctx->payload_buffer = cache.buffer;
+        ctx->payload_size = cache.size;
+        return 0;
+    }
+
+    ret = service_require(SERVICE_HTTPC);
+    if(R_FAILED(ret))
+    {
+        status_set("Failed to initialize httpc.\n    Error code: %08lX", (unsigned long)ret);
+        return ret;
+    }
+
+    mirrors_load(PAYLOAD_CACHE_DIR "/server.txt", PAYLOAD_SERVER, &mirrors);
+
+    if(cache.buffer)
+    {
+        sha256_to_hex(cache.hash, base_hex);
+        snprintf(path, sizeof(path), "get_payload.php?version=%s&base=%s", firmware_string, base_hex);
+    }
+    else snprintf(path, sizeof(path), "get_payload.php?version=%s", firmware_string);
+
+    char user_agent[96];
+    snprintf(user_agent, sizeof(user_agent) - 1, "salt_sploit_installer-%s", ctx->exploitname);
+    mirror_request request = { path, user_agent, cache.buffer ? base_hex : NULL, job_cancelled };
+
+    u32 failed = 0;
+    for(;;)
+    {
+        mirror_response response;
+        ret = mirror_race(&mirrors, failed, &request, &response);
+        if(ret == MIRROR_CANCELLED) return INSTALL_CANCELLED;
+        if(R_FAILED(ret))
+        {
+            if(failed) status_set("Failed to download payload\n    Error code: %08lX", (unsigned long)ret);
+            else if(ret == MIRROR_TIMED_OUT) status_set("No payload server answered in time.");
+            else status_set("Failed to grab payload url\n    Error code: %08lX", (unsigned long)ret);
+            return ret;
+        }
+
+        ret = download_file(&response.context, response.status_code, &ctx->payload_buffer, &ctx->payload_size, &cache);
+        httpcCloseContext(&response.context);
+        if(ret == INSTALL_CANCELLED) return ret;
+
+        if(ret == DOWNLOAD_NOT_MODIFIED)
+        {
+            ctx->payload_buffer = cache.buffer;
+            ctx->payload_size = cache.size;
+        }
+
+        if(R_SUCCEEDED(ret) && pin)
+        {
+            sha256(ctx->payload_buffer, ctx->payload_size, actual);
+            if(memcmp(actual, pinned, SHA256_HASH_SIZE)) ret = -3;
+        }
+
+        if(R_SUCCEEDED(ret)) break;
+
+        failed |= 1 << response.index;
+        if(failed == (1u << mirrors.count) - 1)
+        {
+            status_set("Failed to download payload\n    Error code: %08lX", (unsigned long)ret);
+            return ret;
+        }
+    }
+
+    if(ret != DOWNLOAD_NOT_MODIFIED) store_cached_payload(firmware_string, ctx->payload_buffer, ctx->payload_size);
+
+    return 0;
+}
+
+static Result stage_compress_payload(install_context* ctx)
+{
+    // the image already holds the compressed payload
+    if(ctx->image.entries) return 0;
+
+    int level = 0;
+    const codec* c = codec_from_flags(ctx->flags_bitmask, &level);
+    if(c == NULL)
+    {
+        status_set("The exploit's flags name an unknown codec.\n    Flags: 0x%lX", (unsigned long)ctx->flags_bitmask);
+        return -1;
+    }
+
+    u8* compressed = NULL;
+    u32 compressed_size = 0;
+    codec_stream stream;
+
+    int span = trace_begin("compress", c->name);
+    jobs_heavy_begin();
+    // the payload is encoded where it is, in chunks like a download would deliver it, the codecs that can start
+    // right away do
+    Result ret = codec_begin(&stream, c, level, ctx->payload_buffer, ctx->payload_size, &install_arena, compress_progress);
+    for(u32 done = 0; !ret && done < ctx->payload_size; done += IO_CHUNK_SIZE)
+    {
+        u32 chunk = ctx->payload_size - done > IO_CHUNK_SIZE ? IO_CHUNK_SIZE : ctx->payload_size - done;
+        ret = codec_update(&stream, chunk);
+    }
+    if(!ret) ret = codec_end(&stream, &compressed, &compressed_size);
+    jobs_heavy_end();
+    trace_end(span, ctx->payload_size);
+
+    if(ret)
+    {
+        if(job_cancelled())
+        {
+            status_set("Payload compression was cancelled.");
+            return INSTALL_CANCELLED;
+        }
+
+        if(ret == 4) status_set("The payload is too large for %s.", c->name);
+        else status_set("Not enough memory to compress the payload.");
+        return -1;
+    }
+
+    ctx->payload_buffer = compressed;
+    ctx->payload_size = compressed_size;
+
+    return 0;
+}
+
+static Result stage_backup_save(install_context* ctx)
+{
+    if(!ctx->backup || ctx->dry_run) return 0;
+
+    Result ret = service_require(SERVICE_SAVE_SESSION);
+    if(R_FAILED(ret))
+    {
+        status_set("Failed to initialize the save session.\n    Error code: %08lX", (unsigned long)ret);
+        return ret;
+    }
+
+    char path[256];
+    backup_path(ctx->program_id, path, sizeof(path));
+
+    ret = backup_save(path, ctx->program_id);
+    if(ret == INSTALL_CANCELLED) return ret;
+    if(ret)
+    {
+        status_set("Failed to back up the savedata.\n    Error code: %08lX", (unsigned long)ret);
+        if(ret == 1 || ret == 2) status_append(" Failed to\nwrite the backup to SD.");
+        if(ret == 5) status_append(" The save has\ntoo many files.");
+        return ret;
+    }
+
+    status_set("Savedata backed up to\n    %.200s", path);
+    return 0;
+}
+
+// The slots the install writes to, every slot's files when ctx->all_slots is set.
+static int first_slot(install_context* ctx)
+{
+    return ctx->all_slots ? 0 : ctx->selected_slot;
+}
+
+static int last_slot(install_context* ctx)
+{
+    return ctx->all_slots ? SAVE_SLOT_COUNT - 1 : ctx->selected_slot;
+}
+
+// Builds everything the install stage does to the save, before any of it is done: each save file once, with the
+// contents the last of the configs' lines for it gives it and the payload embedded if it goes there. A payload
+// that isn't embedded is the same file for every slot.
+static Result compile_plan(install_context* ctx)
+{
+    Result ret = 0;
+
+    plan_reset(&plan, (ctx->flags_bitmask & 0x8) && !journal.formatted, ctx->verify);
+
+    for(u32 i = 0; ctx->image.entries && i < ctx->image.header.count; i++)
+    {
+        const saveimage_entry* entry = &ctx->image.entries[i];
+        plan_write write;
+
+        memset(&write, 0, sizeof(write));
+        snprintf(write.path, sizeof(write.path), "%s", entry->path);
+        write.source = PLAN_SOURCE_IMAGE;
+        write.offset = entry->offset;
+        write.size = entry->size;
+        if(plan_add(&plan, &write)) ret = 7;
+    }
+
+    for(int slot = first_slot(ctx); !ctx->image.entries && !ret && slot <= last_slot(ctx); slot++)
+    {
+        // set again by convert_filepath() if this exploit embeds the payload, the path depends on the slot
+        memset(&payload_embed, 0, sizeof(payload_embed));
+
+        const char* savedir = ctx->firmware_version[0] == 0 ? "Old3DS" : "New3DS";
+        if(ctx->flags_bitmask & 0x2) ret = plan_saveconfig(&plan, ctx->versiondir, ctx->firmware_version[0], slot);
+        if(!ret && (ctx->flags_bitmask & 0x4))
+        {
+            savedir = "common";
+            ret = plan_saveconfig(&plan, ctx->versiondir, 2, slot);
+        }
+        if(ret)
+        {
+            status_set("Failed to install the savefiles with romfs %s savedir.\n    Error code: %08lX", savedir, (unsigned long)ret);
+            return ret;
+        }
+
+        if(!payload_embed.enabled) continue;
+
+        // folded into the write of its file, which is only read back from the save when the install doesn't write it
+        plan_write* host = plan_find(&plan, payload_embed.path);
+        if(host == NULL)
+        {
+            plan_write write;
+            memset(&write, 0, sizeof(write));
+            snprintf(write.path, sizeof(write.path), "%s", payload_embed.path);
+            write.source = PLAN_SOURCE_SAVE;
+            ret = plan_add(&plan, &write);
+            host = plan_find(&plan, payload_embed.path);
+        }
+
+        if(host && host->size && (payload_embed.offset + ctx->payload_size + sizeof(u32)) >= host->size)
+        {
+            status_set("Failed to embed payload (too large)\n    0x%lX >= 0x%lX", (unsigned long)(payload_embed.offset + ctx->payload_size + sizeof(u32)), (unsigned long)host->size);
+            return -1;
+        }
+        if(host)
+        {
+            host->embed = true;
+            host->embed_offset = payload_embed.offset;
+        }
+    }
+
+    if(!ret && !ctx->image.entries && !payload_embed.enabled)
+    {
+        plan_write write;
+        memset(&write, 0, sizeof(write));
+        strcpy(write.path, "/payload.bin");
+        write.source = PLAN_SOURCE_PAYLOAD;
+        write.size = ctx->payload_size;
+        ret = plan_add(&plan, &write);
+    }
+
+    if(ret)
+    {
+        status_set("The install writes more than %d save files.", PLAN_MAX_WRITES);
+        return ret;
+    }
+
+    plan_order(&plan);
+
+    // room for every file, a formatted save never gets less than the default geometry
+    u32 blocks = 0, files = 0;
+    for(u32 i = 0; i < plan.count; i++)
+    {
+        plan_write* write = &plan.writes[i];
+        write->in_place = plan.format && write->size;
+        write->committed = journal_active && journal_find(&journal, write->path);
+
+        if(write->size == 0) continue;
+        blocks += (write->size + SAVE_BLOCK_SIZE - 1) / SAVE_BLOCK_SIZE + 1;
+        files++;
+    }
+    plan.format_blocks = blocks < SAVE_FORMAT_BLOCKS ? SAVE_FORMAT_BLOCKS : blocks;
+    plan.format_files = files < SAVE_FORMAT_FILES ? SAVE_FORMAT_FILES : files;
+
+    return 0;
+}
+
+// Formats the save with the plan's geometry and creates each of its files at its final size.
+static Result format_savedata(void)
+{
+    int span = trace_begin("format", NULL);
+    Result ret = saveio_format(plan.format_blocks, SAVE_FORMAT_DIRECTORIES, plan.format_files, SAVE_FORMAT_DIRECTORIES + 1, plan.format_files + 1, true);
+    trace_end(span, 0);
+    if(ret || plan.count == 0) return ret;
+
+    // a file that fails to be created here is simply created by its write later
+    span = trace_begin("save_create", NULL);
+    if(R_SUCCEEDED(saveio_open_archive()))
+    {
+        for(u32 i = 0; i < plan.count; i++)
+            if(plan.writes[i].size) plan.writes[i].exists = R_SUCCEEDED(saveio_create(plan.writes[i].path, plan.writes[i].size));
+        saveio_commit();
+        saveio_close_archive();
+    }
+    trace_end(span, 0);
+
+    return 0;
+}
+
+// Reads every file in the manifest back, all through one archive open, and checks it against the CRC it was written with.
+static Result verify_savedata(void)
+{
+    arena_mark scratch = arena_save(&install_arena);
+    u8* buffer = arena_alloc(&install_arena, IO_CHUNK_SIZE);
+    if(buffer == NULL)
+    {
+        status_set("Not enough memory to verify the savedata.");
+        return -1;
+    }
+
+    u64 total = 0;
+    int span = trace_begin("save_verify", NULL);
+    Result ret = saveio_open_archive();
+    for(u32 i = 0; R_SUCCEEDED(ret) && i < manifest.count; i++)
+    {
+        manifest_file* file = &manifest.files[i];
+        Handle handle = 0;
+        u64 size = 0;
+        u32 crc = 0;
+
+        ret = saveio_open(&handle, file->path, FS_OPEN_READ);
+        if(R_FAILED(ret)) break;
+
+        ret = saveio_get_size(handle, &size);
+        for(u64 offset = 0; R_SUCCEEDED(ret) && offset < size; offset += IO_CHUNK_SIZE)
+        {
+            u32 chunk_read = 0;
+            u32 chunk = size - offset > IO_CHUNK_SIZE ? IO_CHUNK_SIZE : size - offset;
+
+            ret = saveio_read(handle, &chunk_read, offset, buffer, chunk);
+            if(R_SUCCEEDED(ret) && chunk_read != chunk) ret = -1;
+            if(R_SUCCEEDED(ret)) crc = crc32c_update(crc, buffer, chunk);
+        }
+        saveio_close(handle);
+        if(R_FAILED(ret)) break;
+
+        total += size;
+        file->verified = (size == file->size && crc == file->crc) ? 1 : -1;
+        if(file->verified < 0)
+        {
+            status_set("Savedata verification failed for\n    %s: read %08lX, wrote %08lX", file->path, (unsigned long)crc, (unsigned long)file->crc);
+            ret = INSTALL_VERIFY_FAILED;
+        }
+    }
+    saveio_close_archive();
+    trace_end(span, total);
+
+    arena_restore(&install_arena, scratch);
+
+    if(R_FAILED(ret) && ret != INSTALL_VERIFY_FAILED) status_set("Failed to read back the savedata.\n    Error code: %08lX", (unsigned long)ret);
+    return ret;
+}
+
+static void write_manifest(install_context* ctx)
+{
+    char firmware[32];
+    char slot[12];
+
+    mkdir(PAYLOAD_CACHE_DIR, 0777);
+    FILE* f = fopen(INSTALL_MANIFEST_PATH, "w");
+    if(f == NULL) return;
+
+    format_firmware(ctx->firmware_version, firmware, sizeof(firmware));
+    format_slot(ctx->all_slots ? -1 : ctx->selected_slot, slot, sizeof(slot));
+    // the codec the payload was compressed with, "none" when it isn't
+    char payload_codec[16] = "none";
+    int level = 0;
+    const codec* c = codec_from_flags(ctx->flags_bitmask, &level);
+    if(c && (ctx->flags_bitmask & 0x1)) snprintf(payload_codec, sizeof(payload_codec), "%s:%d", c->name, level);
+
+    fprintf(f, "exploit=%s version=%s slot=%s firmware=%s verify=%d crc32c=%s codec=%s\n",
+        ctx->exploitname, ctx->displayversion, slot, firmware, ctx->verify, crc32c_kernel(), payload_codec);
+
+    for(u32 i = 0; i < manifest.count; i++)
+    {
+        const manifest_file* file = &manifest.files[i];
+        const char* verified = file->verified > 0 ? "ok" : file->verified < 0 ? "mismatch" : "unverified";
+        fprintf(f, "%s size=%lu crc32c=%08lX %s\n", file->path, (unsigned long)file->size, (unsigned long)file->crc, verified);
+    }
+
+    fclose(f);
+}
+
+// The contents of one of the plan's files, in install_arena when they're not the payload's or the image's. Sets the
+// status when this fails.
+static Result load_planned_file(install_context* ctx, const plan_write* write, u8** data, size_t* size)
+{
+    Result ret = 0;
+    romfs_source f;
+    u32 romfs_size = 0;
+
+    switch(write->source)
+    {
+        case PLAN_SOURCE_PAYLOAD:
+            *data = ctx->payload_buffer;
+            *size = ctx->payload_size;
+            return 0;
+
+        case PLAN_SOURCE_IMAGE:
+            *data = &ctx->image.data[write->offset];
+            *size = write->size;
+            return 0;
+
+        case PLAN_SOURCE_SAVE:
+            ret = read_savedata(write->path, (void**)data, size);
+            if(ret) status_set("Failed to embed payload\n    Error code: %08lX", (unsigned long)ret);
+            break;
+
+        case PLAN_SOURCE_ROMFS:
+        {
+            int span = trace_begin("romfs_read", write->romfs_path);
+            ret = open_romfs_file(write->romfs_path, &f, &romfs_size);
+            *data = ret ? NULL : arena_alloc(&install_arena, romfs_size);
+            if(ret == 0 && *data == NULL) ret = 5;
+
+            u32 read = ret ? 0 : read_romfs_file(&f, *data, romfs_size);
+            if(ret == 0) close_romfs_file(&f);
+            trace_end(span, read);
+            if(ret == 0 && read != romfs_size) ret = 6;
+            if(ret) status_set("Failed to read the savefile from romfs\n    %s.\n    Error code: %08lX", write->romfs_path, (unsigned long)ret);
+            *size = romfs_size;
+            break;
+        }
+    }
+
+    if(ret || !write->embed) return ret;
+
+    if((write->embed_offset + ctx->payload_size + sizeof(u32)) >= *size)
+    {
+        status_set("Failed to embed payload (too large)\n    0x%lX >= 0x%lX", (unsigned long)(write->embed_offset + ctx->payload_size + sizeof(u32)), (unsigned long)*size);
+        return -1;
+    }
+
+    *(u32*)(*data + write->embed_offset) = ctx->payload_size;
+    memcpy(*data + write->embed_offset + sizeof(u32), ctx->payload_buffer, ctx->payload_size);
+    return 0;
+}
+
+// Writes every file of the plan, with the archive already open.
+static Result run_plan(install_context* ctx)
+{
+    Result ret = 0;
+
+    // whatever isn't written in place is removed up front, all with one commit instead of a commit each. A file
+    // that's read back for the payload is still needed until then.
+    int span = trace_begin("save_delete", NULL);
+    u32 removed = 0;
+    for(u32 i = 0; i < plan.count; i++)
+    {
+        plan_write* write = &plan.writes[i];
+        if(write->committed || write->source == PLAN_SOURCE_SAVE || write->exists) continue;
+
+        saveio_remove(write->path);
+        write->removed = true;
+        removed++;
+    }
+    if(removed) saveio_commit();
+    trace_end(span, 0);
+
+    for(u32 i = 0; !ret && i < plan.count; i++)
+    {
+        const plan_write* write = &plan.writes[i];
+        u8* data = NULL;
+        size_t size = 0;
+
+        arena_mark scratch = arena_save(&install_arena);
+        ret = load_planned_file(ctx, write, &data, &size);
+        if(ret)
+        {
+            arena_restore(&install_arena, scratch);
+            break;
+        }
+
+        ret = write_savedata(write->path, data, size);
+        arena_restore(&install_arena, scratch);
+        if(ret == 0) continue;
+
+        if(write->source == PLAN_SOURCE_IMAGE) status_set("Failed to install the save image\n    Error code: %08lX", (unsigned long)ret);
+        else if(write->source == PLAN_SOURCE_PAYLOAD || write->embed) status_set("Failed to install payload\n    Error code: %08lX", (unsigned long)ret);
+        else status_set("Failed to install the savefiles from\n    %s.\n    Error code: %08lX", write->romfs_path, (unsigned long)ret);
+    }
+
+    return ret;
+}
+
+// Writes the plan and its estimate to PLAN_PATH, instead of installing.
+static Result dry_run(void)
+{
+    plan_cost cost;
+    saveio_stats stats;
+
+    // timed with what the save calls took so far, when there were any
+    saveio_stats_get(&stats);
+    plan_estimate(&plan, IO_CHUNK_SIZE, &stats, &cost);
+
+    mkdir(PAYLOAD_CACHE_DIR, 0777);
+    FILE* f = fopen(PLAN_PATH, "w");
+    if(f == NULL)
+    {
+        status_set("Failed to write the plan to SD.");
+        return 1;
+    }
+
+    plan_print(&plan, &cost, f);
+    fclose(f);
+
+    u32 calls = 0;
+    for(int op = 0; op < SAVEIO_OP_COUNT; op++) calls += cost.ops[op];
+    status_set("Dry run: %lu files, %lu KB written with\n    %lu save calls, about %lu ms.", (unsigned long)plan.count,
+        (unsigned long)(cost.bytes[SAVEIO_WRITE] / 1024), (unsigned long)calls, (unsigned long)(cost.us / 1000));
+    return 0;
+}
+
+static Result stage_install_payload(install_context* ctx)
+{
+    Result ret = service_require(SERVICE_SAVE_SESSION);
+    if(R_SUCCEEDED(ret)) ret = service_require(SERVICE_ROMFS);
+    if(R_FAILED(ret))
+    {
+        status_set("Failed to initialize the save session / romfs.\n    Error code: %08lX", (unsigned long)ret);
+        return ret;
+    }
+
+    // the romfs files are read through stdio when the image can't be opened
+    service_require(SERVICE_ROMFS_IMAGE);
+
+    // set again by convert_filepath() if this exploit embeds the payload, a previous install may have left it on
+    memset(&payload_embed, 0, sizeof(payload_embed));
+
+    u32 selected_remaster_version = 0;
+    int span = trace_begin("romfs_config", ctx->exploitname);
+    ret = load_exploitconfig(ctx->exploitname, &ctx->program_id, ctx->selected_remaster, ctx->update_exists ? &ctx->update_title.version : NULL, &selected_remaster_version, ctx->versiondir, ctx->displayversion);
+    trace_end(span, 0);
+    if(ret)
+    {
+        status_set("Failed to find your version of\n%s in the config / config loading failed.\n    Error code: %08lX", ctx->titlename, (unsigned long)ret);
+        if(ret == 1) status_append(" Failed to\nopen the config file in romfs.");
+        if(ret == 2 || ret == 4) status_append(" The romfs config file is invalid.");
+        if(ret == 3) status_set("this update-title version (v%u) of %s is not compatible with %s, sorry\n", ctx->update_title.version, ctx->titlename, ctx->exploitname);
+        if(ret == 5) status_set("this remaster version (%04lX) of %s is not compatible with %s, sorry\n", (unsigned long)selected_remaster_version, ctx->titlename, ctx->exploitname);
+        return ret;
+    }
+
+    // nothing touches the save until the whole install is planned
+    span = trace_begin("plan", NULL);
+    ret = compile_plan(ctx);
+    trace_end(span, 0);
+    if(ret) return ret;
+    if(ctx->dry_run) return dry_run();
+
+    manifest.count = 0;
+
+    // a resumed install keeps the save it formatted last time, along with the files it already committed to it
+    if(plan.format)
+    {
+        ret = format_savedata();
+        if(ret)
+        {
+            status_set("Failed to format savedata.\n    Error code: %08lX", (unsigned long)ret);
+            return ret;
+        }
+
+        journal.formatted = true;
+        journal.file_count = 0;
+        if(journal_active) journal_save(JOURNAL_PATH, &journal);
+    }
+
+    // every write below, for however many slots, shares one open of the archive
+    ret = saveio_open_archive();
+    if(R_FAILED(ret))
+    {
+        status_set("Failed to open the save archive.\n    Error code: %08lX", (unsigned long)ret);
+        return ret;
+    }
+
+    ret = run_plan(ctx);
+    if(!ret && ctx->verify) ret = verify_savedata();
+    saveio_close_archive();
+
+    write_manifest(ctx);
+
+    return ret;
+}
+
+// The install pipeline, in order. A stage only runs when all of its required_flags are set in the exploit's flags.
+const install_stage install_stages[] = {
+    { STATE_DOWNLOAD_PAYLOAD, "stage_download", 0x0, stage_download_payload },
+    { STATE_COMPRESS_PAYLOAD, "stage_compress", 0x1, stage_compress_payload },
+    { STATE_BACKUP_SAVE, "stage_backup", 0x0, stage_backup_save },
+    { STATE_INSTALL_PAYLOAD, "stage_install", 0x0, stage_install_payload },
+};
+
+const int install_stage_count = sizeof(install_stages) / sizeof(install_stages[0]);
+
+bool install_stage_enabled(install_context* ctx, int stage)
+{
+    return (ctx->flags_bitmask & install_stages[stage].required_flags) == install_stages[stage].required_flags;
+}
+
+// Whether the payload is final once stage is done, i.e. no stage after it downloads or processes it.
+static bool payload_final(install_context* ctx, int stage)
+{
+    for(int next = stage + 1; next < install_stage_count; next++)
+        if(install_stage_enabled(ctx, next) && install_stages[next].state <= STATE_COMPRESS_PAYLOAD) return false;
+
+    return true;
+}
+
+static void journal_start(install_context* ctx, install_journal* out)
+{
+    memset(out, 0, sizeof(*out));
+    snprintf(out->exploitname, sizeof(out->exploitname), "%s", ctx->exploitname);
+    snprintf(out->displayversion, sizeof(out->displayversion), "%s", ctx->displayversion);
+    format_firmware(ctx->firmware_version, out->firmware, sizeof(out->firmware));
+    out->slot = ctx->all_slots ? -1 : ctx->selected_slot;
+    out->program_id = ctx->program_id;
+}
+
+// Picks up the journal of an interrupted install of the same run, along with the payload it staged.
+// Returns the stage to continue from, 0 when there's nothing to resume.
+static int journal_resume(install_context* ctx)
+{
+    static install_journal saved;
+
+    journal_start(ctx, &journal);
+    if(journal_load(JOURNAL_PATH, &saved)) return 0;
+    if(!journal_same_run(&journal, &saved) || saved.payload_size == 0 || saved.next_stage <= 0 || saved.next_stage >= install_stage_count) return 0;
+
+    int span = trace_begin("journal_resume", JOURNAL_PATH);
+    u8 hash[SHA256_HASH_SIZE];
+    u8* buffer = arena_alloc(&install_arena, saved.payload_size);
+    FILE* f = fopen(JOURNAL_PAYLOAD_PATH, "rb");
+    size_t size = buffer && f ? fread(buffer, 1, saved.payload_size, f) : 0;
+    if(f) fclose(f);
+    trace_end(span, size);
+
+    if(size != saved.payload_size) return 0;
+    sha256(buffer, size, hash);
+    if(memcmp(hash, saved.payload_hash, sizeof(hash))) return 0;
+
+    ctx->payload_buffer = buffer;
+    ctx->payload_size = size;
+    memcpy(&journal, &saved, sizeof(journal));
+    return saved.next_stage;
+}
+
+// Records that stage is done, along with the payload once it's final, so a retry can continue after it.
+static void journal_checkpoint(install_context* ctx, int stage)
+{
+    if(install_stages[stage].state <= STATE_COMPRESS_PAYLOAD)
+    {
+        // a payload that's still going to change isn't worth resuming from
+        if(!payload_final(ctx, stage)) return;
+
+        mkdir(PAYLOAD_CACHE_DIR, 0777);
+        int span = trace_begin("journal_stage", JOURNAL_PAYLOAD_PATH);
+        FILE* f = fopen(JOURNAL_PAYLOAD_PATH, "wb");
+        size_t written = f ? fwrite(ctx->payload_buffer, 1, ctx->payload_size, f) : 0;
+        if(f && fclose(f)) written = 0;
+        trace_end(span, written);
+        if(written != ctx->payload_size) return;
+
+        sha256(ctx->payload_buffer, ctx->payload_size, journal.payload_hash);
+        journal.payload_size = ctx->payload_size;
+    }
+    else if(journal.payload_size == 0) return;
+
+    journal.next_stage = stage + 1;
+    journal_save(JOURNAL_PATH, &journal);
+}
+
+static void install_thread(void* arg)
+{
+    install_context* ctx = arg;
+    Result ret = 0;
+
+    // a dry run changes nothing there would be to resume
+    if(ctx->stage == 0 && !ctx->dry_run)
+    {
+        ctx->stage = journal_resume(ctx);
+        if(ctx->stage) status_set("Resuming the interrupted install at\n    %s.", install_stages[ctx->stage].name);
+        journal_active = true;
+    }
+
+    for(int stage = ctx->stage; stage < install_stage_count; stage++)
+    {
+        if(!install_stage_enabled(ctx, stage)) continue;
+
+        ret = install_run_stage(ctx, stage);
+        if(ret) break;
+
+        if(journal_active) journal_checkpoint(ctx, stage);
+    }
+
+    // only a failed or interrupted install has anything to resume
+    if(journal_active && ret == 0)
+    {
+        remove(JOURNAL_PATH);
+        remove(JOURNAL_PAYLOAD_PATH);
+    }
+
+    install_finish(ctx, ret);
+}
+
+Result install_run_stage(install_context* ctx, int stage)
+{
+    install_progress.done = 0;
+    install_progress.total = 0;
+    ctx->stage = stage;
+
+    int span = trace_begin(install_stages[stage].name, NULL);
+    Result ret = install_stages[stage].run(ctx);
+    trace_end(span, 0);
+
+    if(ret == 0 && job_cancelled()) ret = INSTALL_CANCELLED;
+    return ret;
+}
+
+void install_finish(install_context* ctx, Result ret)
+{
+    journal_active = false;
+
+    trace_write_json(TRACE_PATH);
+
+    // everything the stages allocated goes away at once
+    arena_reset(&install_arena);
+    ctx->payload_buffer = NULL;
+    ctx->payload_size = 0;
+    memset(&ctx->image, 0, sizeof(ctx->image));
+
+    ctx->result = ret;
+    ctx->running = false;
+}
+
+Result install_start(install_context* ctx, int first_stage)
+{
+    ctx->stage = first_stage;
+    return install_start_job(ctx, install_thread);
+}
+
+Result install_start_job(install_context* ctx, job_func entry)
+{
+    install_progress.done = 0;
+    install_progress.total = 0;
+
+    if(!install_arena.block_size) arena_init(&install_arena, ARENA_BLOCK_SIZE);
+    install_arena.peak = install_arena.used;
+
+    // a previous install that failed may have left its journal behind, which only install_thread() picks up again
+    memset(&journal, 0, sizeof(journal));
+    journal_active = false;
+
+    ctx->result = 0;
+    ctx->running = true;
+
+    ctx->job = job_submit(entry, NULL, ctx, JOB_PRIORITY_NORMAL, 0);
+    if(ctx->job == 0)
+    {
+        ctx->running = false;
+        return -1;
+    }
+
+    return 0;
+}
+
+state_t install_poll(install_context* ctx)
+{
+    if(ctx->running) return install_stages[ctx->stage].state;
+
+    if(ctx->job)
+    {
+        job_wait(ctx->job);
+        ctx->job = 0;
+    }
+
+    return ctx->result ? STATE_ERROR : STATE_INSTALLED_PAYLOAD;
+}
+
+void install_cancel(install_context* ctx)
+{
+    // a job that never ran can't finish the install itself
+    if(job_cancel(ctx->job))
+    {
+        ctx->job = 0;
+        ctx->result = INSTALL_CANCELLED;
+        ctx->running = false;
+    }
+
+    install_poll(ctx);
+}
@@ -0,0 +1,158 @@
+#ifndef _INSTALL_H_
+#define _INSTALL_H_
+
+#include <3ds.h>
+
+#include "sha256.h"
+#include "arena.h"
+#include "jobs.h"
+#include "plan.h"
+#include "saveimage.h"
+
+// download_file() result when the cached payload is still current
+#define DOWNLOAD_NOT_MODIFIED 1
+
+// result of any stage that stopped because its job was cancelled, see job_cancelled()
+#define INSTALL_CANCELLED -0x20
+
+// result of the install step when a save file read back doesn't match what was written
+#define INSTALL_VERIFY_FAILED -0x21
+
+#define SAVE_SLOT_COUNT 3
+
+#define INSTALL_MANIFEST_PATH "sdmc:/salt_sploit_installer/manifest.txt"
+
+typedef enum
+{
+    STATE_NONE,
+    STATE_INITIALIZE,
+    STATE_INITIAL,
+    STATE_SELECT_VERSION,
+    STATE_SELECT_SLOT,
+    STATE_SELECT_FIRMWARE,
+    STATE_DOWNLOAD_PAYLOAD,
+    STATE_COMPRESS_PAYLOAD,
+    STATE_BACKUP_SAVE,
+    STATE_INSTALL_PAYLOAD,
+    STATE_INSTALLED_PAYLOAD,
+    STATE_ERROR,
+} state_t;
+
+typedef struct {
+    void* buffer;
+    size_t size;
+    u8 hash[SHA256_HASH_SIZE];
+} cached_payload_t;
+
+// Everything the install stages need, filled in by the UI before install_start().
+typedef struct {
+    char exploitname[64];
+    char titlename[64];
+    char versiondir[64];
+    char displayversion[64];
+
+    u32 flags_bitmask;
+    u64 program_id;
+    u32 selected_remaster;
+
+    bool update_exists;
+    AM_TitleEntry update_title;
+
+    int firmware_version[6];
+    int selected_slot;
+    // install to every slot instead of selected_slot, with one download and one archive open
+    bool all_slots;
+    // use the payload cached on SD, without initializing httpc
+    bool offline;
+    // ask the server for a newer payload (a delta against the cached one, or 304) even when one is cached on SD
+    bool update;
+    // read every written save file back once and check it against the manifest
+    bool verify;
+    // back up the whole save archive to BACKUP_DIR before anything in it is touched
+    bool backup;
+    // install from the prebaked image of this run in SAVEIMAGE_DIR when there's one
+    bool prebaked;
+    // compile the install plan and write it with its estimate to PLAN_PATH, without touching the save
+    bool dry_run;
+
+    void* payload_buffer;
+    size_t payload_size;
+    // the prebaked image, loaded by the download stage in place of the payload
+    saveimage image;
+
+    // Written by the install job, polled by the main loop.
+    volatile int stage;
+    volatile bool running;
+    volatile Result result;
+
+    job_id job;
+} install_context;
+
+// Byte-level progress of the running stage.
+typedef struct {
+    volatile u32 done;
+    volatile u32 total;
+} install_progress_t;
+
+typedef struct {
+    state_t state;
+    const char* name;
+    u32 required_flags;
+    Result (*run)(install_context* ctx);
+} install_stage;
+
+extern Handle save_session;
+extern const char regions[7][4];
+extern install_progress_t install_progress;
+// Every allocation made by the install stages comes from this arena, which is reset when the install ends.
+extern arena install_arena;
+
+extern const install_stage install_stages[];
+extern const int install_stage_count;
+
+// The status line on the bottom screen. It's set from the install, provisioning and restore threads, so it's only
+// ever written and read through these. status_init() runs once at startup, before any of them.
+#define STATUS_SIZE 256
+void status_init(void);
+void status_set(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+// Adds the details some errors put after the line status_set() wrote.
+void status_append(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+// Copies it to out, cut to size.
+void status_get(char* out, size_t size);
+
+Result download_file(httpcContext *context, u32 status_code, void** buffer, size_t* size, const cached_payload_t* base);
+Result read_savedata(const char* path, void** data, size_t* size);
+Result write_savedata(const char* path, const void* data, size_t size);
+
+void remove_newline(char *line);
+void format_firmware(const int* firmware_version, char* out, size_t out_size);
+// "1" to "3", or "all" for a negative slot.
+void format_slot(int slot, char* out, size_t out_size);
+// The sha256 pinned for firmware in "sdmc:/salt_sploit_installer/hashes.txt", one "{firmware} {sha256}" per line.
+// Returns 1 when none is pinned.
+Result load_payload_hash(const char* firmware, u8* hash);
+Result load_cached_payload(const char* firmware, cached_payload_t* cache);
+Result store_cached_payload(const char* firmware, const void* buffer, size_t size);
+
+Result load_exploitlist_config(char *filepath, u64 *cur_programid, char *out_exploitname, char *out_titlename, u32* out_flags_bitmask);
+Result load_exploitversion(char *exploitname, u64 *cur_programid, int index, u32* out_remaster, char* out_displayversion);
+Result load_exploitconfig(char *exploitname, u64 *cur_programid, u32 app_remaster_version, u16 *update_titleversion, u32 *installed_remaster_version, char *out_versiondir, char *out_displayversion);
+Result convert_filepath(char *inpath, char *outpath, u32 outpath_maxsize, int selected_slot);
+// Adds a write of every file a config.ini copies to plan, see plan_add().
+Result plan_saveconfig(install_plan* plan, char *versiondir, u32 type, int selected_slot);
+
+// Runs the stages from first_stage onwards as a job on the worker pool.
+Result install_start(install_context* ctx, int first_stage);
+// Like install_start(), but with entry running as the job in place of the stages. entry ends with install_finish().
+Result install_start_job(install_context* ctx, job_func entry);
+// Reports ret as the result of the install job and releases everything the stages allocated.
+void install_finish(install_context* ctx, Result ret);
+bool install_stage_enabled(install_context* ctx, int stage);
+// Runs one stage on the calling thread, with the progress reset, the stage traced and cancellation checked.
+Result install_run_stage(install_context* ctx, int stage);
+// Returns the state of the running stage, or STATE_INSTALLED_PAYLOAD / STATE_ERROR once the job is done.
+state_t install_poll(install_context* ctx);
+// Cancels the install job through job_cancel(): the running stage stops at its next check with INSTALL_CANCELLED.
+void install_cancel(install_context* ctx);
+
+#endif // _INSTALL_H_
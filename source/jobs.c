@@ -0,0 +1,328 @@
+#include <string.h>
+
+#ifndef _3DS
+#include <unistd.h>
+#endif
+
+#include <3ds.h>
+
+#include "jobs.h"
+
+#define JOBS_STACK_SIZE 0x10000
+
+typedef enum
+{
+    JOB_FREE,
+    JOB_QUEUED,
+    JOB_RUNNING,
+    // done, waiting for jobs_poll() to run its completion callback
+    JOB_FINISHED,
+} job_state;
+
+typedef struct {
+    job_id id;
+    job_state state;
+    job_func run;
+    job_done done;
+    void* arg;
+    job_priority priority;
+    u32 flags;
+    u32 sequence;
+    // set by job_cancel() while it runs, polled through job_cancelled()
+    volatile bool cancel;
+    // cancelled before it ran
+    bool dropped;
+} job;
+
+static job jobs[JOBS_MAX];
+static u32 submitted;
+
+static LightLock lock;
+// signalled when a job is queued, and broadcast on exit
+static CondVar work;
+// broadcast when a job finishes or is dropped
+static CondVar finished;
+static bool exiting;
+
+static Thread workers[JOBS_MAX_WORKERS];
+static int worker_count;
+static int heavy_count;
+
+// the job running on this worker, for job_cancelled()
+static __thread job* current;
+#ifdef _3DS
+// the syscore time limit from before jobs_init() raised it, restored by jobs_exit()
+static u32 saved_cpu_time_limit;
+static bool cpu_time_limit_raised;
+#endif
+
+// Slots are reused, so an ID only finds its job while the slot still holds it.
+static job* job_find(job_id id)
+{
+    if(id == 0) return NULL;
+
+    job* j = &jobs[(id - 1) % JOBS_MAX];
+    return j->id == id ? j : NULL;
+}
+
+// Jobs without a completion callback are freed as soon as they're done, the others by jobs_poll().
+static void job_retire(job* j)
+{
+    if(j->done) j->state = JOB_FINISHED;
+    else
+    {
+        j->state = JOB_FREE;
+        j->id = 0;
+    }
+
+    CondVar_Broadcast(&finished);
+}
+
+// The highest priority queued job, the oldest one among equals. Called with lock held.
+static job* jobs_next(void)
+{
+    job* best = NULL;
+
+    for(int i = 0; i < JOBS_MAX; i++)
+    {
+        job* j = &jobs[i];
+        if(j->state != JOB_QUEUED) continue;
+
+        if(best == NULL || j->priority > best->priority || (j->priority == best->priority && (s32)(j->sequence - best->sequence) < 0))
+            best = j;
+    }
+
+    return best;
+}
+
+static void job_run(job* j)
+{
+    job* outer = current;
+    current = j;
+    if(j->flags & JOB_CPU_HEAVY) jobs_heavy_begin();
+
+    j->run(j->arg);
+
+    if(j->flags & JOB_CPU_HEAVY) jobs_heavy_end();
+    current = outer;
+}
+
+static void jobs_worker(void* arg)
+{
+    LightLock_Lock(&lock);
+
+    while(true)
+    {
+        job* j = jobs_next();
+        if(j == NULL)
+        {
+            if(exiting) break;
+
+            CondVar_Wait(&work, &lock);
+            continue;
+        }
+
+        j->state = JOB_RUNNING;
+        LightLock_Unlock(&lock);
+
+        job_run(j);
+
+        LightLock_Lock(&lock);
+        job_retire(j);
+    }
+
+    LightLock_Unlock(&lock);
+}
+
+void jobs_init(void)
+{
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+    LightLock_Init(&lock);
+    CondVar_Init(&work);
+    CondVar_Init(&finished);
+    exiting = false;
+
+    // the core of each worker, -2 being the application's own
+    int cores[JOBS_MAX_WORKERS] = { -2 };
+    int count = 1;
+
+#ifdef _3DS
+    bool is_new3ds = false;
+    APT_CheckNew3DS(&is_new3ds);
+    if(is_new3ds)
+    {
+        cores[count++] = 2;
+        // core 1 is the system core, which only gives applications what the time limit allows
+        cpu_time_limit_raised = R_SUCCEEDED(APT_GetAppCpuTimeLimit(&saved_cpu_time_limit)) &&
+            R_SUCCEEDED(APT_SetAppCpuTimeLimit(JOBS_SYSCORE_CPU_TIME_LIMIT));
+        if(cpu_time_limit_raised) cores[count++] = 1;
+    }
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    count = cpus < 1 ? 1 : (cpus > JOBS_MAX_WORKERS ? JOBS_MAX_WORKERS : cpus);
+    for(int i = 1; i < count; i++) cores[i] = -2;
+#endif
+
+    for(int i = 0; i < count; i++)
+    {
+        // Lower priority than the main thread, which only renders and sleeps in gspWaitForVBlank().
+        Thread thread = threadCreate(jobs_worker, NULL, JOBS_STACK_SIZE, prio + 1, cores[i], false);
+        if(thread) workers[worker_count++] = thread;
+    }
+}
+
+void jobs_exit(void)
+{
+    LightLock_Lock(&lock);
+
+    exiting = true;
+    for(int i = 0; i < JOBS_MAX; i++)
+    {
+        if(jobs[i].state != JOB_QUEUED) continue;
+
+        jobs[i].dropped = true;
+        job_retire(&jobs[i]);
+    }
+
+    CondVar_Broadcast(&work);
+    LightLock_Unlock(&lock);
+
+    for(int i = 0; i < worker_count; i++)
+    {
+        threadJoin(workers[i], U64_MAX);
+        threadFree(workers[i]);
+    }
+    worker_count = 0;
+
+#ifdef _3DS
+    if(cpu_time_limit_raised) APT_SetAppCpuTimeLimit(saved_cpu_time_limit);
+    cpu_time_limit_raised = false;
+#endif
+
+    jobs_poll();
+}
+
+job_id job_submit(job_func run, job_done done, void* arg, job_priority priority, u32 flags)
+{
+    LightLock_Lock(&lock);
+
+    job* j = NULL;
+    for(int i = 0; i < JOBS_MAX && j == NULL; i++)
+        if(jobs[i].state == JOB_FREE) j = &jobs[i];
+
+    if(j == NULL || exiting)
+    {
+        LightLock_Unlock(&lock);
+        return 0;
+    }
+
+    int slot = j - jobs;
+    memset(j, 0, sizeof(*j));
+    // the slot is in the low bits of the ID, which stays true when the count wraps as JOBS_MAX is a power of two
+    do j->id = ++submitted * JOBS_MAX + slot + 1; while(j->id == 0);
+    j->run = run;
+    j->done = done;
+    j->arg = arg;
+    j->priority = priority;
+    j->flags = flags;
+    j->sequence = submitted;
+
+    job_id id = j->id;
+
+    // without any worker the job runs right here
+    if(worker_count == 0)
+    {
+        j->state = JOB_RUNNING;
+        LightLock_Unlock(&lock);
+
+        job_run(j);
+
+        LightLock_Lock(&lock);
+        job_retire(j);
+        LightLock_Unlock(&lock);
+        return id;
+    }
+
+    j->state = JOB_QUEUED;
+    CondVar_Signal(&work);
+    LightLock_Unlock(&lock);
+
+    return id;
+}
+
+bool job_cancel(job_id id)
+{
+    bool dropped = false;
+
+    LightLock_Lock(&lock);
+
+    job* j = job_find(id);
+    if(j && j->state == JOB_QUEUED)
+    {
+        j->dropped = dropped = true;
+        job_retire(j);
+    }
+    else if(j && j->state == JOB_RUNNING) j->cancel = true;
+
+    LightLock_Unlock(&lock);
+
+    return dropped;
+}
+
+bool job_cancelled(void)
+{
+    return current && current->cancel;
+}
+
+void job_wait(job_id id)
+{
+    LightLock_Lock(&lock);
+
+    job* j;
+    while((j = job_find(id)) && (j->state == JOB_QUEUED || j->state == JOB_RUNNING)) CondVar_Wait(&finished, &lock);
+
+    LightLock_Unlock(&lock);
+}
+
+void jobs_poll(void)
+{
+    job_done done[JOBS_MAX];
+    void* args[JOBS_MAX];
+    bool dropped[JOBS_MAX];
+    int count = 0;
+
+    // the callbacks run without the lock, so they can queue more jobs
+    LightLock_Lock(&lock);
+    for(int i = 0; i < JOBS_MAX; i++)
+    {
+        job* j = &jobs[i];
+        if(j->state != JOB_FINISHED) continue;
+
+        done[count] = j->done;
+        args[count] = j->arg;
+        dropped[count] = j->dropped;
+        count++;
+
+        j->state = JOB_FREE;
+        j->id = 0;
+    }
+    LightLock_Unlock(&lock);
+
+    for(int i = 0; i < count; i++) done[i](args[i], dropped[i]);
+}
+
+void jobs_heavy_begin(void)
+{
+    LightLock_Lock(&lock);
+    if(heavy_count++ == 0) osSetSpeedupEnable(true);
+    LightLock_Unlock(&lock);
+}
+
+void jobs_heavy_end(void)
+{
+    LightLock_Lock(&lock);
+    if(--heavy_count == 0) osSetSpeedupEnable(false);
+    LightLock_Unlock(&lock);
+}
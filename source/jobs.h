@@ -0,0 +1,54 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <3ds.h>
+
+#define JOBS_MAX 32
+#define JOBS_MAX_WORKERS 4
+
+// What the syscore CPU time limit is raised to on the New3DS, so a worker can run on core 1.
+#define JOBS_SYSCORE_CPU_TIME_LIMIT 80
+
+// The New3DS runs at 804MHz with its L2 cache enabled while a job with this flag runs.
+#define JOB_CPU_HEAVY (1 << 0)
+
+typedef enum
+{
+    JOB_PRIORITY_LOW,
+    JOB_PRIORITY_NORMAL,
+    JOB_PRIORITY_HIGH,
+    JOB_PRIORITY_COUNT,
+} job_priority;
+
+// 0 is never a job.
+typedef u32 job_id;
+
+typedef void (*job_func)(void* arg);
+// Called by jobs_poll() once the job is done, cancelled is set when it never ran.
+typedef void (*job_done)(void* arg, bool cancelled);
+
+// Starts the workers: one on the Old3DS, one per core the application can use on the New3DS, and one per
+// CPU (up to JOBS_MAX_WORKERS) on a host build.
+void jobs_init(void);
+// Cancels every queued job, waits for the running ones and gives back the syscore time.
+void jobs_exit(void);
+
+// Queues run(arg). Higher priorities run first, jobs of the same priority in the order they were queued.
+// Returns 0 when the queue is full.
+job_id job_submit(job_func run, job_done done, void* arg, job_priority priority, u32 flags);
+// A queued job is dropped, its completion callback then sees cancelled set. A running one sees job_cancelled()
+// become true, and stops wherever it polls it. Returns true when the job was dropped.
+bool job_cancel(job_id id);
+// Whether the job running on the calling thread was cancelled. False outside of a job.
+bool job_cancelled(void);
+// Waits until the job has run. Its completion callback is still left to jobs_poll().
+void job_wait(job_id id);
+
+// Runs the completion callbacks of the jobs that finished since the last call, on the calling thread.
+void jobs_poll(void);
+
+// Marks the calling job's work up to jobs_heavy_end() as CPU-heavy, see JOB_CPU_HEAVY. These nest.
+void jobs_heavy_begin(void);
+void jobs_heavy_end(void);
+
+#endif // _JOBS_H_
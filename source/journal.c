@@ -0,0 +1,129 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3ds.h>
+
+#include "journal.h"
+#include "install.h"
+
+Result journal_load(const char* path, install_journal* journal)
+{
+    char line[512];
+    char hex[SHA256_HASH_SIZE * 2 + 1];
+
+    FILE* f = fopen(path, "r");
+    if(f == NULL) return 1;
+
+    memset(journal, 0, sizeof(*journal));
+    memset(hex, 0, sizeof(hex));
+
+    Result ret = 0;
+    while(fgets(line, sizeof(line) - 1, f))
+    {
+        unsigned long long program_id;
+        unsigned long size, crc;
+        int value;
+
+        remove_newline(line);
+        if(line[0] == 0) continue;
+
+        if(sscanf(line, "exploit=%63s", journal->exploitname) == 1) continue;
+        if(sscanf(line, "version=%63s", journal->displayversion) == 1) continue;
+        if(sscanf(line, "firmware=%31s", journal->firmware) == 1) continue;
+        if(sscanf(line, "slot=%d", &journal->slot) == 1) continue;
+        if(sscanf(line, "program_id=%llx", &program_id) == 1)
+        {
+            journal->program_id = program_id;
+            continue;
+        }
+        if(sscanf(line, "payload_sha256=%64s", hex) == 1) continue;
+        if(sscanf(line, "payload_size=%lu", &size) == 1)
+        {
+            journal->payload_size = size;
+            continue;
+        }
+        if(sscanf(line, "next_stage=%d", &journal->next_stage) == 1) continue;
+        if(sscanf(line, "formatted=%d", &value) == 1)
+        {
+            journal->formatted = value != 0;
+            continue;
+        }
+
+        // "file=<size> <crc32c> <path>", the path last since it's the only field that could hold spaces
+        int offset = 0;
+        if(sscanf(line, "file=%lu %lx %n", &size, &crc, &offset) == 2 && offset)
+        {
+            if(journal_add_file(journal, line + offset, size, crc)) ret = 2;
+            continue;
+        }
+
+        ret = 2;
+    }
+
+    fclose(f);
+
+    if(ret == 0 && (journal->exploitname[0] == 0 || sha256_from_hex(hex, journal->payload_hash))) ret = 2;
+
+    return ret;
+}
+
+Result journal_save(const char* path, const install_journal* journal)
+{
+    char tmp_path[256];
+    char hex[SHA256_HASH_SIZE * 2 + 1];
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE* f = fopen(tmp_path, "w");
+    if(f == NULL) return 1;
+
+    sha256_to_hex(journal->payload_hash, hex);
+    fprintf(f, "exploit=%s\nversion=%s\nfirmware=%s\nslot=%d\nprogram_id=%016llX\n",
+        journal->exploitname, journal->displayversion, journal->firmware, journal->slot, (unsigned long long)journal->program_id);
+    fprintf(f, "payload_sha256=%s\npayload_size=%lu\nnext_stage=%d\nformatted=%d\n",
+        hex, (unsigned long)journal->payload_size, journal->next_stage, journal->formatted);
+
+    for(u32 i = 0; i < journal->file_count; i++)
+        fprintf(f, "file=%lu %08lX %s\n", (unsigned long)journal->files[i].size, (unsigned long)journal->files[i].crc, journal->files[i].path);
+
+    if(fclose(f))
+    {
+        remove(tmp_path);
+        return 2;
+    }
+
+    remove(path);
+    return rename(tmp_path, path) ? 2 : 0;
+}
+
+bool journal_same_run(const install_journal* a, const install_journal* b)
+{
+    return strcmp(a->exploitname, b->exploitname) == 0 && strcmp(a->displayversion, b->displayversion) == 0 &&
+        strcmp(a->firmware, b->firmware) == 0 && a->slot == b->slot && a->program_id == b->program_id;
+}
+
+const journal_file* journal_find(const install_journal* journal, const char* path)
+{
+    for(u32 i = 0; i < journal->file_count; i++)
+        if(strcmp(journal->files[i].path, path) == 0) return &journal->files[i];
+
+    return NULL;
+}
+
+Result journal_add_file(install_journal* journal, const char* path, u32 size, u32 crc)
+{
+    journal_file* file = (journal_file*)journal_find(journal, path);
+    if(file == NULL)
+    {
+        if(journal->file_count == JOURNAL_MAX_FILES) return 1;
+
+        file = &journal->files[journal->file_count++];
+        memset(file, 0, sizeof(*file));
+        strncpy(file->path, path, sizeof(file->path) - 1);
+    }
+
+    file->size = size;
+    file->crc = crc;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <3ds.h>
+
+#include "sha256.h"
+
+#define JOURNAL_PATH "sdmc:/salt_sploit_installer/journal.txt"
+// the payload as the install stages left it, ready to be written to the save
+#define JOURNAL_PAYLOAD_PATH "sdmc:/salt_sploit_installer/staged.bin"
+
+#define JOURNAL_MAX_FILES 64
+
+typedef struct {
+    char path[256];
+    u32 size;
+    u32 crc;
+} journal_file;
+
+// How far an install got: which run it was, the payload its stages produced, the first stage
+// that hasn't completed, and every save file committed since the save was formatted.
+typedef struct {
+    char exploitname[64];
+    char displayversion[64];
+    char firmware[32];
+    // -1 for all slots
+    int slot;
+    u64 program_id;
+
+    u8 payload_hash[SHA256_HASH_SIZE];
+    u32 payload_size;
+
+    int next_stage;
+    bool formatted;
+
+    u32 file_count;
+    journal_file files[JOURNAL_MAX_FILES];
+} install_journal;
+
+// Returns 1 when there's no journal and 2 when it's invalid.
+Result journal_load(const char* path, install_journal* journal);
+// Replaces the journal at path in one step, so a journal on SD is always complete.
+Result journal_save(const char* path, const install_journal* journal);
+
+// Whether both journals are for the same exploit, version, slot, firmware and title.
+bool journal_same_run(const install_journal* a, const install_journal* b);
+
+const journal_file* journal_find(const install_journal* journal, const char* path);
+// Records path as committed with size and crc, replacing an earlier entry for it. Returns 1 when the journal is full.
+Result journal_add_file(install_journal* journal, const char* path, u32 size, u32 crc);
+
+#endif // _JOURNAL_H_
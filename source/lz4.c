@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "lz4.h"
+
+#define MIN_MATCH 4
+// the format leaves the last 5 bytes as literals and starts no match within 12 bytes of the end
+#define LAST_LITERALS 5
+#define MF_LIMIT 12
+#define MAX_OFFSET 0xFFFF
+
+static inline u32 read32(const u8* p)
+{
+    u32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline u32 hash(u32 sequence)
+{
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static u8* write_length(u8* op, u32 length)
+{
+    for(; length >= 255; length -= 255) *op++ = 255;
+    *op++ = length;
+    return op;
+}
+
+static u8* write_sequence(u8* op, const u8* literals, u32 literal_length, u32 offset, u32 match_length)
+{
+    u8* token = op++;
+    *token = (literal_length < 15 ? literal_length : 15) << 4;
+    if(literal_length >= 15) op = write_length(op, literal_length - 15);
+
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+
+    // the last sequence is literals only
+    if(offset == 0) return op;
+
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+
+    match_length -= MIN_MATCH;
+    *token |= match_length < 15 ? match_length : 15;
+    if(match_length >= 15) op = write_length(op, match_length - 15);
+
+    return op;
+}
+
+u32 lz4_compress(const u8* src, u32 size, u8* dst, u32* table)
+{
+    const u8* ip = src;
+    const u8* anchor = src;
+    const u8* end = src + size;
+    u8* op = dst;
+
+    memset(table, 0, sizeof(u32) * LZ4_TABLE_SIZE);
+
+    if(size > MF_LIMIT)
+    {
+        const u8* mf_limit = end - MF_LIMIT;
+        const u8* match_limit = end - LAST_LITERALS;
+
+        ip++;
+        while(ip < mf_limit)
+        {
+            u32 sequence = read32(ip);
+            u32 h = hash(sequence);
+            const u8* ref = src + table[h];
+            table[h] = ip - src;
+
+            if(ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != sequence)
+            {
+                // step faster through data that doesn't compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            while(ip > anchor && ref > src && ip[-1] == ref[-1])
+            {
+                ip--;
+                ref--;
+            }
+
+            const u8* match_end = ip + MIN_MATCH;
+            const u8* ref_end = ref + MIN_MATCH;
+            while(match_end < match_limit && *match_end == *ref_end)
+            {
+                match_end++;
+                ref_end++;
+            }
+
+            op = write_sequence(op, anchor, ip - anchor, ip - ref, match_end - ip);
+            ip = anchor = match_end;
+        }
+    }
+
+    op = write_sequence(op, anchor, end - anchor, 0, 0);
+    return op - dst;
+}
+
+static int read_length(const u8** ip, const u8* end, u32* length)
+{
+    u8 byte;
+    do
+    {
+        if(*ip >= end) return -1;
+        byte = *(*ip)++;
+        *length += byte;
+    } while(byte == 255);
+
+    return 0;
+}
+
+int lz4_decompress(const u8* src, u32 size, u8* dst, u32 dst_size)
+{
+    const u8* ip = src;
+    const u8* end = src + size;
+    u8* op = dst;
+    u8* op_end = dst + dst_size;
+
+    while(ip < end)
+    {
+        u8 token = *ip++;
+
+        u32 literal_length = token >> 4;
+        if(literal_length == 15 && read_length(&ip, end, &literal_length)) return -1;
+        if(literal_length > (u32)(end - ip) || literal_length > (u32)(op_end - op)) return -1;
+
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        if(ip == end) break;
+
+        if(end - ip < 2) return -1;
+        u32 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if(offset == 0 || offset > (u32)(op - dst)) return -1;
+
+        u32 match_length = token & 15;
+        if(match_length == 15 && read_length(&ip, end, &match_length)) return -1;
+        match_length += MIN_MATCH;
+        if(match_length > (u32)(op_end - op)) return -1;
+
+        // matches may overlap their own output, so byte by byte
+        const u8* ref = op - offset;
+        while(match_length--) *op++ = *ref++;
+    }
+
+    return op - dst;
+}
@@ -0,0 +1,20 @@
+#ifndef _LZ4_H_
+#define _LZ4_H_
+
+#include <3ds.h>
+
+// LZ4 block format (no frame), which favours speed over ratio: a greedy matcher with a single hash probe.
+
+// Worst case compressed size of size bytes.
+#define LZ4_BOUND(size) ((size) + (size) / 255 + 16)
+
+// lz4_compress() needs a table of LZ4_TABLE_SIZE u32's, which it clears itself.
+#define LZ4_HASH_BITS 12
+#define LZ4_TABLE_SIZE (1 << LZ4_HASH_BITS)
+
+// dst holds at least LZ4_BOUND(size) bytes. Returns the compressed size.
+u32 lz4_compress(const u8* src, u32 size, u8* dst, u32* table);
+// Returns the decompressed size, or -1 when src is corrupt or doesn't fit in dst_size bytes.
+int lz4_decompress(const u8* src, u32 size, u8* dst, u32 dst_size);
+
+#endif // _LZ4_H_
@@ -0,0 +1,236 @@
+#include <string.h>
+
+#include <3ds.h>
+
+#include "lzss.h"
+
+#define LZSS_MIN_MATCH 3
+#define LZ10_MAX_MATCH 18
+#define LZ11_MAX_MATCH 0x10110
+
+// chain depth per level, the last level also matches lazily
+static const u32 depths[LZSS_LEVELS] = { 8, 32, 256 };
+
+static inline u32 hash3(const u8* p)
+{
+    u32 v = (p[0] << 16) | (p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - LZSS_HASH_BITS);
+}
+
+void lzss_init(lzss_state* s, u8 format, int level, u32* head, u32* prev)
+{
+    if(level < 1) level = 1;
+    if(level > LZSS_LEVELS) level = LZSS_LEVELS;
+
+    memset(s, 0, sizeof(*s));
+    s->format = format;
+    s->max_match = format == LZSS_LZ11 ? LZ11_MAX_MATCH : LZ10_MAX_MATCH;
+    s->depth = depths[level - 1];
+    s->lazy = level == LZSS_LEVELS;
+    s->head = head;
+    s->prev = prev;
+}
+
+u32 lzss_header(u8 format, u32 size, u8* out)
+{
+    out[0] = format;
+    if(size < 0x1000000)
+    {
+        out[1] = size;
+        out[2] = size >> 8;
+        out[3] = size >> 16;
+        return 4;
+    }
+
+    // only LZ11 has the extended header, a zero size followed by the real one
+    if(format != LZSS_LZ11) return 0;
+
+    memset(&out[1], 0, 3);
+    out[4] = size;
+    out[5] = size >> 8;
+    out[6] = size >> 16;
+    out[7] = size >> 24;
+    return 8;
+}
+
+// Enters every position before to in the hash chains, as far as there are 3 bytes to hash.
+static void lzss_insert(lzss_state* s, const u8* raw, u32 to, u32 available)
+{
+    for(; s->inserted < to && s->inserted + LZSS_MIN_MATCH <= available; s->inserted++)
+    {
+        u32 hash = hash3(&raw[s->inserted]);
+        s->prev[s->inserted & (LZSS_WINDOW - 1)] = s->head[hash];
+        s->head[hash] = s->inserted + 1;
+    }
+}
+
+// The longest match for pos in the window, 0 when there's none of at least LZSS_MIN_MATCH bytes.
+static u32 lzss_match(lzss_state* s, const u8* raw, u32 pos, u32 available, u32* disp)
+{
+    u32 limit = available - pos < s->max_match ? available - pos : s->max_match;
+    if(limit < LZSS_MIN_MATCH) return 0;
+
+    u32 best = LZSS_MIN_MATCH - 1;
+    u32 last = pos;
+    u32 candidate = s->head[hash3(&raw[pos])];
+
+    for(u32 chain = s->depth; candidate && chain; chain--)
+    {
+        u32 c = candidate - 1;
+        // the links are positions modulo the window, anything that doesn't go further back is stale
+        if(c >= last || pos - c > LZSS_WINDOW) break;
+        last = c;
+
+        if(raw[c + best] == raw[pos + best])
+        {
+            u32 len = 0;
+            while(len < limit && raw[c + len] == raw[pos + len]) len++;
+
+            if(len > best)
+            {
+                best = len;
+                *disp = pos - c;
+                if(len == limit) break;
+            }
+        }
+
+        candidate = s->prev[c & (LZSS_WINDOW - 1)];
+    }
+
+    return best >= LZSS_MIN_MATCH ? best : 0;
+}
+
+static u32 lzss_token(const lzss_state* s, u32 len, u32 disp, u8* out)
+{
+    disp--;
+
+    if(s->format == LZSS_LZ10)
+    {
+        out[0] = ((len - 3) << 4) | (disp >> 8);
+        out[1] = disp;
+        return 2;
+    }
+
+    if(len <= 0x10)
+    {
+        out[0] = ((len - 1) << 4) | (disp >> 8);
+        out[1] = disp;
+        return 2;
+    }
+
+    if(len <= 0x110)
+    {
+        len -= 0x11;
+        out[0] = len >> 4;
+        out[1] = ((len & 0xF) << 4) | (disp >> 8);
+        out[2] = disp;
+        return 3;
+    }
+
+    len -= 0x111;
+    out[0] = 0x10 | (len >> 12);
+    out[1] = len >> 4;
+    out[2] = ((len & 0xF) << 4) | (disp >> 8);
+    out[3] = disp;
+    return 4;
+}
+
+u32 lzss_encode(lzss_state* s, const u8* raw, u32 available, bool final, u8* out, u32 out_end)
+{
+    while(s->pos < available)
+    {
+        // the lazy look at the next position needs a byte more
+        if(!final && available - s->pos <= s->max_match) break;
+
+        u32 disp = 0;
+        lzss_insert(s, raw, s->pos, available);
+        u32 len = lzss_match(s, raw, s->pos, available, &disp);
+
+        if(len && s->lazy && len < s->max_match)
+        {
+            u32 next_disp;
+            lzss_insert(s, raw, s->pos + 1, available);
+            if(lzss_match(s, raw, s->pos + 1, available, &next_disp) > len) len = 0;
+        }
+
+        if(s->flag_bit == 0)
+        {
+            s->flag_pos = out_end;
+            out[out_end++] = 0;
+            s->flag_bit = 0x80;
+        }
+
+        if(len)
+        {
+            out[s->flag_pos] |= s->flag_bit;
+            out_end += lzss_token(s, len, disp, &out[out_end]);
+            s->pos += len;
+        }
+        else out[out_end++] = raw[s->pos++];
+
+        s->flag_bit >>= 1;
+    }
+
+    // the decoders read whole words
+    if(final)
+        while(out_end & 3) out[out_end++] = 0;
+
+    return out_end;
+}
+
+int lzss_decode(const u8* src, u32 size, u8* dst, u32 dst_size)
+{
+    if(size < 4 || (src[0] != LZSS_LZ10 && src[0] != LZSS_LZ11)) return -1;
+
+    u8 format = src[0];
+    u32 raw_size = src[1] | (src[2] << 8) | (src[3] << 16);
+    u32 in = 4;
+    if(raw_size == 0 && format == LZSS_LZ11 && size >= 8)
+    {
+        raw_size = src[4] | (src[5] << 8) | (src[6] << 16) | ((u32)src[7] << 24);
+        in = 8;
+    }
+    if(raw_size > dst_size) return -1;
+
+    u32 out = 0;
+    u8 flags = 0, bit = 0;
+    while(out < raw_size)
+    {
+        if(bit == 0)
+        {
+            if(in >= size) return -1;
+            flags = src[in++];
+            bit = 0x80;
+        }
+
+        if(!(flags & bit))
+        {
+            if(in >= size) return -1;
+            dst[out++] = src[in++];
+        }
+        else
+        {
+            u32 len, disp, token = 2;
+            u8 kind = in < size ? src[in] >> 4 : 0;
+
+            if(format == LZSS_LZ11 && kind == 0) token = 3;
+            if(format == LZSS_LZ11 && kind == 1) token = 4;
+            if(size - in < token) return -1;
+
+            const u8* t = &src[in];
+            if(format == LZSS_LZ10) len = (t[0] >> 4) + 3;
+            else if(token == 3) len = (((t[0] & 0xF) << 4) | (t[1] >> 4)) + 0x11;
+            else if(token == 4) len = (((t[0] & 0xF) << 12) | (t[1] << 4) | (t[2] >> 4)) + 0x111;
+            else len = (t[0] >> 4) + 1;
+            disp = (((t[token - 2] & 0xF) << 8) | t[token - 1]) + 1;
+            in += token;
+
+            if(disp > out || len > raw_size - out) return -1;
+            for(; len; len--, out++) dst[out] = dst[out - disp];
+        }
+
+        bit >>= 1;
+    }
+
+    return raw_size;
+}
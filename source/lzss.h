@@ -0,0 +1,50 @@
+#ifndef _LZSS_H_
+#define _LZSS_H_
+
+#include <3ds.h>
+
+// Nintendo's LZ10 and LZ11 (the LZSS formats of the GBA/DS BIOS, which many loaders decode): a 4 byte header with
+// the format and the decompressed size, then groups of a flag byte and 8 literals or back-references into a 4 KB
+// window. LZ10 matches are 3 to 18 bytes, LZ11 ones up to 65808.
+#define LZSS_LZ10 0x10
+#define LZSS_LZ11 0x11
+
+#define LZSS_WINDOW 0x1000
+#define LZSS_HASH_BITS 12
+#define LZSS_HASH_SIZE (1 << LZSS_HASH_BITS)
+#define LZSS_LEVELS 3
+
+// Worst case encoded size of size bytes: the header, every byte a literal, a flag byte per 8 and the padding.
+#define LZSS_BOUND(size) (8 + (size) + ((size) + 7) / 8 + 3)
+
+// An encoder that's given its input as it arrives.
+typedef struct {
+    u8 format;
+    u32 max_match;
+    u32 depth;
+    // looks one byte ahead for a longer match before taking one
+    bool lazy;
+
+    // the next byte to encode, and the next one to enter in the hash chains
+    u32 pos;
+    u32 inserted;
+
+    u32 flag_pos;
+    u8 flag_bit;
+
+    // LZSS_HASH_SIZE heads and LZSS_WINDOW links, each a position + 1
+    u32* head;
+    u32* prev;
+} lzss_state;
+
+// Starts encoding in format at level 1 (fastest) to LZSS_LEVELS (smallest), with tables the caller cleared.
+void lzss_init(lzss_state* s, u8 format, int level, u32* head, u32* prev);
+// Writes the header for size bytes to out. Returns its size, 0 when the format can't hold size.
+u32 lzss_header(u8 format, u32 size, u8* out);
+// Encodes raw from where the last call stopped, out of the available bytes received so far. Unless final, the last
+// bytes are kept for the next call so no match is cut short. Returns the new end of out.
+u32 lzss_encode(lzss_state* s, const u8* raw, u32 available, bool final, u8* out, u32 out_end);
+// Returns the decompressed size, or -1 when src is corrupt or doesn't fit in dst_size bytes.
+int lzss_decode(const u8* src, u32 size, u8* dst, u32 dst_size);
+
+#endif // _LZSS_H_
@@ -1,692 +1,228 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/stat.h>
-#include <errno.h>
-#include <ctype.h>
 
 #include <3ds.h>
 
-#include "blz.h"
+#include "backup.h"
+#include "fleet.h"
+#include "install.h"
+#include "headless.h"
+#include "jobs.h"
+#include "render.h"
+#include "saveio.h"
+#include "services.h"
+#include "trace.h"
+
+enum
+{
+    STARTUP_SAVE_SESSION,
+    STARTUP_REGION,
+    STARTUP_UPDATE_TITLE,
+    STARTUP_EXPLOIT,
+    STARTUP_TASK_COUNT,
+};
 
-Handle save_session;
-FS_Archive save_archive;
+typedef struct {
+    install_context* ctx;
+    u64 update_program_id;
+    int version_count;
+    int selected_version;
+    const char* error[STARTUP_TASK_COUNT];
+} startup_context;
 
-// http://3dbrew.org/wiki/Nandrw/sys/SecureInfo_A
-const char regions[7][4] = {
-    "JPN",
-    "USA",
-    "EUR",
-    "EUR",
-    "CHN",
-    "KOR",
-    "TWN"
-};
+// The startup tasks below don't depend on each other and run concurrently.
 
-typedef enum
+static Result startup_save_session(void* arg)
 {
-    STATE_NONE,
-    STATE_INITIALIZE,
-    STATE_INITIAL,
-    STATE_SELECT_VERSION,
-    STATE_SELECT_SLOT,
-    STATE_SELECT_FIRMWARE,
-    STATE_DOWNLOAD_PAYLOAD,
-    STATE_COMPRESS_PAYLOAD,
-    STATE_INSTALL_PAYLOAD,
-    STATE_INSTALLED_PAYLOAD,
-    STATE_ERROR,
-} state_t;
-
-char status[256];
-
-struct {
-    bool enabled;
-    size_t offset;
-    char path[256];
-} payload_embed;
+    startup_context* startup = arg;
 
-Result get_redirect(char *url, char *out, size_t out_size, char *user_agent)
-{
-    Result ret;
+    // get an fs:USER session as the game
+    Result ret = service_require(SERVICE_SAVE_SESSION);
+    if(R_FAILED(ret)) startup->error[STARTUP_SAVE_SESSION] = "Failed to get game fs:USER session.";
 
-    httpcContext context;
-    ret = httpcOpenContext(&context, HTTPC_METHOD_GET, url, 0);
-    if(R_FAILED(ret)) return ret;
+    return ret;
+}
 
-    ret = httpcAddRequestHeaderField(&context, "User-Agent", user_agent);
-    if(R_SUCCEEDED(ret)) ret = httpcBeginRequest(&context);
+static Result startup_region(void* arg)
+{
+    startup_context* startup = arg;
+    u8 region = 0;
 
+    Result ret = service_require(SERVICE_CFGU);
     if(R_FAILED(ret))
     {
-        httpcCloseContext(&context);
+        startup->error[STARTUP_REGION] = "Failed to initialize cfgu.";
         return ret;
     }
 
-    ret = httpcGetResponseHeader(&context, "Location", out, out_size);
-    httpcCloseContext(&context);
-
-    return ret;
-}
-
-Result download_file(httpcContext *context, void** buffer, size_t* size, char* user_agent)
-{
-    Result ret;
-
-    ret = httpcAddRequestHeaderField(context, "User-Agent", user_agent);
-    if(R_FAILED(ret)) return ret;
-
-    ret = httpcBeginRequest(context);
-    if(R_FAILED(ret)) return ret;
-
-    u32 status_code = 0;
-    ret = httpcGetResponseStatusCode(context, &status_code);
-    if(R_FAILED(ret)) return ret;
-
-    if(status_code != 200) return -1;
-
-    u32 sz = 0;
-    ret = httpcGetDownloadSizeState(context, NULL, &sz);
-    if(R_FAILED(ret)) return ret;
-
-    void* buf = malloc(sz);
-    if(!buf) return -2;
-
-    memset(buf, 0, sz);
-
-    ret = httpcDownloadData(context, buf, sz, NULL);
+    ret = CFGU_SecureInfoGetRegion(&region);
     if(R_FAILED(ret))
     {
-        free(buf);
+        startup->error[STARTUP_REGION] = "Failed to get the system region.";
         return ret;
     }
 
-    if(size) *size = sz;
-    if(buffer) *buffer = buf;
-    else free(buf);
+    startup->ctx->firmware_version[5] = region;
 
     return 0;
 }
 
-Result read_savedata(const char* path, void** data, size_t* size)
+static Result startup_update_title(void* arg)
 {
-    if(!path || !data || !size) return -1;
-
-    Result ret = -1;
-    int fail = 0;
-    void* buffer = NULL;
+    startup_context* startup = arg;
 
-    fsUseSession(save_session);
-    ret = FSUSER_OpenArchive(&save_archive, ARCHIVE_SAVEDATA, (FS_Path){PATH_EMPTY, 1, (u8*)""});
-    if(R_FAILED(ret))
-    {
-        fail = -1;
-        goto readFail;
-    }
+    if(!startup->update_program_id) return 0;
 
-    Handle file = 0;
-    ret = FSUSER_OpenFile(&file, save_archive, fsMakePath(PATH_ASCII, path), FS_OPEN_READ, 0);
+    Result ret = service_require(SERVICE_AM);
     if(R_FAILED(ret))
     {
-        fail = -2;
-        goto readFail;
-    }
-
-    u64 file_size = 0;
-    ret = FSFILE_GetSize(file, &file_size);
-
-    buffer = malloc(file_size);
-    if(!buffer)
-    {
-        fail = -3;
-        goto readFail;
-    }
-
-    u32 bytes_read = 0;
-    ret = FSFILE_Read(file, &bytes_read, 0, buffer, file_size);
-    if(R_FAILED(ret))
-    {
-        fail = -4;
-        goto readFail;
+        startup->error[STARTUP_UPDATE_TITLE] = "Failed to initialize AM.";
+        return ret;
     }
 
-    ret = FSFILE_Close(file);
-    if(R_FAILED(ret))
-    {
-        fail = -5;
-        goto readFail;
-    }
+    ret = AM_GetTitleInfo(1, 1, &startup->update_program_id, &startup->ctx->update_title);
+    if(R_SUCCEEDED(ret))
+        startup->ctx->update_exists = true;
 
-readFail:
-    FSUSER_CloseArchive(save_archive);
-    fsEndUseSession();
-    if(fail)
-    {
-        sprintf(status, "Failed to read file: %d\n     %08lX %08lX", fail, ret, bytes_read);
-        if(buffer) free(buffer);
-    }
-    else
-    {
-        sprintf(status, "Successfully read file.\n     %08lX               ", bytes_read);
-        *data = buffer;
-        *size = bytes_read;
-    }
-
-    return ret;
+    return 0;
 }
 
-Result write_savedata(const char* path, const void* data, size_t size)
+static Result startup_exploit(void* arg)
 {
-    if(!path || !data || size == 0) return -1;
-
-    Result ret = -1;
-    int fail = 0;
-
-    fsUseSession(save_session);
-    ret = FSUSER_OpenArchive(&save_archive, ARCHIVE_SAVEDATA, (FS_Path){PATH_EMPTY, 1, (u8*)""});
-    if(R_FAILED(ret))
-    {
-        fail = -1;
-        goto writeFail;
-    }
-
-    // delete file
-    FSUSER_DeleteFile(save_archive, fsMakePath(PATH_ASCII, path));
-    FSUSER_ControlArchive(save_archive, ARCHIVE_ACTION_COMMIT_SAVE_DATA, NULL, 0, NULL, 0);
-
-    Handle file = 0;
-    ret = FSUSER_OpenFile(&file, save_archive, fsMakePath(PATH_ASCII, path), FS_OPEN_CREATE | FS_OPEN_WRITE, 0);
-    if(R_FAILED(ret))
-    {
-        fail = -2;
-        goto writeFail;
-    }
-
-    u32 bytes_written = 0;
-    ret = FSFILE_Write(file, &bytes_written, 0, data, size, FS_WRITE_FLUSH | FS_WRITE_UPDATE_TIME);
-    if(R_FAILED(ret))
-    {
-        fail = -3;
-        goto writeFail;
-    }
+    startup_context* startup = arg;
+    install_context* ctx = startup->ctx;
 
-    ret = FSFILE_Close(file);
+    Result ret = service_require(SERVICE_ROMFS);
     if(R_FAILED(ret))
     {
-        fail = -4;
-        goto writeFail;
+        startup->error[STARTUP_EXPLOIT] = "Failed to initialize romfs for this application (romfsInit()).";
+        return ret;
     }
 
-    ret = FSUSER_ControlArchive(save_archive, ARCHIVE_ACTION_COMMIT_SAVE_DATA, NULL, 0, NULL, 0);
-    if(R_FAILED(ret)) fail = -5;
-
-writeFail:
-    FSUSER_CloseArchive(save_archive);
-    fsEndUseSession();
-    if(fail) sprintf(status, "Failed to write to file: %d\n     %08lX %08lX", fail, ret, bytes_written);
-    else sprintf(status, "Successfully wrote to file!\n     %08lX               ", bytes_written);
-
-    return ret;
-}
-
+    // the configs are read through stdio when the image can't be opened
+    service_require(SERVICE_ROMFS_IMAGE);
 
-void remove_newline(char *line)
-{
-    int len = strlen(line);
-    if(len == 0)return;
-
-    if(line[len - 1] == '\n')
+    ret = load_exploitlist_config("romfs:/exploitlist_config", &ctx->program_id, ctx->exploitname, ctx->titlename, &ctx->flags_bitmask);
+    if(ret)
     {
-        line[len - 1] = 0;
-        if(len > 1)
-        {
-            if(line[len - 2] == '\r')
-            {
-                line[len - 2] = 0;
-            }
-        }
+        startup->error[STARTUP_EXPLOIT] = "Failed to select the exploit.";
+        if(ret == 1) startup->error[STARTUP_EXPLOIT] = "Failed to select the exploit. Failed to\nopen the config file in romfs.";
+        if(ret == 2) startup->error[STARTUP_EXPLOIT] = "Failed to select the exploit. This title is not supported.";
+        return ret;
     }
-}
 
-//Format of the config file: each line is for a different exploit. Each parameter is seperated by spaces(' '). "<exploitname> <titlename> <flags_bitmask> <list_of_programIDs>"
-Result load_exploitlist_config(char *filepath, u64 *cur_programid, char *out_exploitname, char *out_titlename, u32* out_flags_bitmask)
-{
-    FILE *f;
-    int len;
-    int ret = 2;
-    u64 config_programid;
-    char *strptr;
-    char *exploitname, *titlename;
-    char line[256];
-
-    f = fopen(filepath, "r");
-    if(f==NULL) return 1;
-
-    memset(line, 0, sizeof(line));
-    while(fgets(line, sizeof(line) - 1, f))
+    int version_index = 0;
+    u32 this_remaster = 0;
+    char this_displayversion[64] = {0};
+    while(true)
     {
-        remove_newline(line);
-
-        len = strlen(line);
-        if(len == 0) continue;
-
-        strptr = strtok(line, " ");
-        if(strptr == NULL) continue;
-        exploitname = strptr;
-
-        strptr = strtok(NULL, " ");
-        if(strptr == NULL) continue;
-        titlename = strptr;
-
-        strptr = strtok(NULL, " ");
-        if(strptr == NULL) continue;
-        *out_flags_bitmask = 0;
-        sscanf(strptr, "0x%lx", out_flags_bitmask);
+        ret = load_exploitversion(ctx->exploitname, &ctx->program_id, version_index, &this_remaster, this_displayversion);
+        if(ret) break;
 
-        while((strptr = strtok(NULL, " ")))
+        if(this_remaster == ctx->selected_remaster)
         {
-            config_programid = 0;
-            sscanf(strptr, "%016llx", &config_programid);
-            if(config_programid == 0) continue;
-
-            if(*cur_programid == config_programid)
-            {
-                ret = 0;
-                break;
-            }
+            strncpy(ctx->displayversion, this_displayversion, 63);
+            startup->selected_version = version_index;
         }
 
-        if(ret == 0) break;
+        version_index++;
     }
 
-    fclose(f);
-
-    if(ret == 0)
+    startup->version_count = version_index;
+    if(version_index == 0)
     {
-        strncpy(out_exploitname, exploitname, 63);
-        strncpy(out_titlename, titlename, 63);
+        startup->error[STARTUP_EXPLOIT] = "Failed to read remaster versions from config.";
+        return ret;
     }
 
-    return ret;
+    return 0;
 }
 
-Result load_exploitversion(char *exploitname, u64 *cur_programid, int index, u32* out_remaster, char* out_displayversion)
+// Per-stage timings followed by the most memory the install had allocated at once.
+static void install_summary(char* out, size_t out_size)
 {
-    int ret = 2;
-
-    int len;
-    char *strptr;
-    char *namestr = NULL, *valuestr = NULL;
-
-    char filepath[256] = {0};
-    char line[256] = {0};
-    snprintf(filepath, sizeof(filepath) - 1, "romfs:/%s/%016llx/config.ini", exploitname, *cur_programid);
-
-    int stage = 0;
-    int i = 0;
-
-    FILE* f = fopen(filepath, "r");
-    if(f == NULL) return 1;
-
-    while(fgets(line, sizeof(line) - 1, f))
-    {
-        remove_newline(line);
-
-        len = strlen(line);
-        if(len == 0) continue;
-
-        if(stage == 0)
-        {
-            if(strcmp(line, "[remaster_versions]") == 0)
-            {
-                ret = 3;
-                stage = 1;
-            }
-        }
-        else if(stage == 1)
-        {
-            if(i != index)
-            {
-                i++;
-                continue;
-            }
-
-            strptr = strtok(line, "=");
-            if(strptr == NULL) continue;
-            namestr = strptr;
+    trace_summary(out, out_size);
 
-            strptr = strtok(NULL, "=");
-            if(strptr == NULL) continue;
-            valuestr = strptr;
-
-            unsigned int tmpremaster = 0;
-            if(sscanf(namestr, "%04X", &tmpremaster) == 1)
-            {
-                ret = 4;
-
-                strptr = strtok(valuestr, "@");
-                if(strptr == NULL) break;
-
-                strptr = strtok(NULL, "@");
-                if(strptr == NULL) break;
-
-                if(out_displayversion) strncpy(out_displayversion, strptr, 63);
-                if(out_remaster) *out_remaster = tmpremaster;
+    size_t len = strlen(out);
+    snprintf(&out[len], out_size - len, "%-14s    %6lu KB peak\n", "heap", (u32)(install_arena.peak / 1024));
+}
 
-                ret = 0;
+// X restores the save backup as a job, so the screen keeps rendering while the save is written.
+typedef struct {
+    job_id job;
+    u64 program_id;
+    Result result;
+} restore_context;
 
-                break;
-            }
-        }
-    }
+static void restore_run(void* arg)
+{
+    restore_context* restore = (restore_context*)arg;
 
-    fclose(f);
+    char path[256];
+    backup_path(restore->program_id, path, sizeof(path));
 
-    return ret;
+    restore->result = service_require(SERVICE_SAVE_SESSION);
+    if(R_SUCCEEDED(restore->result)) restore->result = backup_restore(path, -1);
 }
 
-Result load_exploitconfig(char *exploitname, u64 *cur_programid, u32 app_remaster_version, u16 *update_titleversion, u32 *installed_remaster_version, char *out_versiondir, char *out_displayversion)
+static void restore_done(void* arg, bool cancelled)
 {
-    FILE *f;
-    int len;
-    int ret = 2;
-    int stage = 0;
-    unsigned int tmpver, tmpremaster;
-    char *strptr;
-    char *namestr = NULL, *valuestr = NULL;
-    char filepath[256];
-    char line[256];
-
-    if(update_titleversion == NULL)
-    {
-        *installed_remaster_version = app_remaster_version;
-        stage = 2;
-        ret = 5;
-    }
-
-    memset(filepath, 0, sizeof(filepath));
-
-    snprintf(filepath, sizeof(filepath) - 1, "romfs:/%s/%016llx/config.ini", exploitname, *cur_programid);
+    restore_context* restore = (restore_context*)arg;
+    restore->job = 0;
+    if(cancelled) return;
 
-    f = fopen(filepath, "r");
-    if(f == NULL) return 1;
-
-    memset(line, 0, sizeof(line));
-    while(fgets(line, sizeof(line) - 1, f))
+    Result ret = restore->result;
+    if(ret)
     {
-        remove_newline(line);
-
-        len = strlen(line);
-        if(len == 0) continue;
-
-        if(stage == 1 || stage == 3)
-        {
-            strptr = strtok(line, "=");
-            if(strptr == NULL) continue;
-            namestr = strptr;
-
-            strptr = strtok(NULL, "=");
-            if(strptr == NULL) continue;
-            valuestr = strptr;
-        }
-
-        if(stage == 0)
-        {
-            if(strcmp(line, "[updatetitle_versions]") == 0)
-            {
-                ret = 3;
-                stage = 1;
-            }
-        }
-        else if(stage == 1)
-        {
-            tmpver = 0;
-            tmpremaster = 0;
-            if(sscanf(namestr, "v%u", &tmpver) == 1)
-            {
-                if(sscanf(valuestr, "%04X", &tmpremaster) == 1)
-                {
-                    if(tmpver == *update_titleversion)
-                    {
-                        if(app_remaster_version < tmpremaster)
-                        {
-                            *installed_remaster_version = tmpremaster;
-                        }
-                        else
-                        {
-                            *installed_remaster_version = app_remaster_version;
-                        }
-
-                        ret = 4;
-                        stage = 2;
-                        fseek(f, 0, SEEK_SET);
-                    }
-                }
-            }
-        }
-        else if(stage == 2)
-        {
-            if(strcmp(line, "[remaster_versions]") == 0)
-            {
-                ret = 5;
-                stage = 3;
-            }
-        }
-        else if(stage == 3)
-        {
-            tmpremaster = 0;
-            if(sscanf(namestr, "%04X", &tmpremaster) == 1)
-            {
-                if(*installed_remaster_version == tmpremaster)
-                {
-                    ret = 4;
-                    strptr = strtok(valuestr, "@");
-                    if(strptr == NULL) break;
-
-                    strncpy(out_versiondir, strptr, 63);
-
-                    strptr = strtok(NULL, "@");
-                    if(strptr == NULL) break;
-                    strncpy(out_displayversion, strptr, 63);
-
-                    ret = 0;
-
-                    break;
-                }
-            }
-        }
+        status_set("Failed to restore the save backup.\n    Error code: %08lX", ret);
+        if(ret == 1) status_append(" There is no\nbackup for this title.");
+        if(ret == 4 || ret == 6) status_append(" The backup is\ncorrupt.");
     }
+    else status_set("Restored the save backup.");
+}
 
-    fclose(f);
+// SELECT writes the save I/O stats as a low priority job, but not while an install or restore job uses the save.
+static char saveio_text[128];
+static job_id saveio_dump_job;
 
-    return ret;
+static void saveio_dump_run(void* arg)
+{
+    *(Result*)arg = saveio_stats_dump(SAVEIO_DUMP_PATH);
 }
 
-Result convert_filepath(char *inpath, char *outpath, u32 outpath_maxsize, int selected_slot)
+static void saveio_dump_done(void* arg, bool cancelled)
 {
-    char *strptr = NULL;
-    char *convstr = NULL;
-    char tmpstr[8];
-    char tmpstr2[16];
-
-    strptr = strtok(inpath, "@");
-
-    while(strptr)
-    {
-        convstr = &strptr[strlen(strptr) + 1];
-
-        strncat(outpath, strptr, outpath_maxsize - 1);
+    saveio_dump_job = 0;
+    if(cancelled) return;
 
-        if(convstr[0] != '!')
-        {
-            strptr = strtok(NULL, "@");
-            continue;
-        }
-
-        switch(convstr[1])
-        {
-            case 'd':
-            {
-                if(convstr[2] < '0' || convstr[2] > '9') return 9;
-
-                memset(tmpstr, 0, sizeof(tmpstr));
-                memset(tmpstr2, 0, sizeof(tmpstr2));
-                snprintf(tmpstr, sizeof(tmpstr) - 1, "%s%c%c", "%0", convstr[2], convstr[1]);
-                snprintf(tmpstr2, sizeof(tmpstr2) - 1, tmpstr, selected_slot);
-
-                strncat(outpath, tmpstr2, outpath_maxsize - 1);
-
-                strptr = strtok(&convstr[3], "@");
-                break;
-            }
-
-            case 'p':
-            {
-                char tmpstr3[9];
-                for(int i = 0; i < 8; i++)
-                {
-                    tmpstr3[i] = convstr[i + 2];
-                    if(!isxdigit(tmpstr3[i])) return 9;
-                }
-
-                payload_embed.offset = strtol(tmpstr3, NULL, 16);
-                payload_embed.enabled = true;
-
-                strptr = strtok(&convstr[10], "@");
-                strncpy(payload_embed.path, outpath, sizeof(payload_embed.path) - 1);
-                break;
-            }
-
-            default: return 9;
-        }
-    }
-
-    return 0;
+    if(*(Result*)arg == 0) snprintf(saveio_text, sizeof(saveio_text) - 1, "  Save I/O stats written to\n  %s", SAVEIO_DUMP_PATH);
+    else snprintf(saveio_text, sizeof(saveio_text) - 1, "  Failed to write the save I/O stats.");
 }
 
-Result parsecopy_saveconfig(char *versiondir, u32 type, int selected_slot)
+// Starts the next scripted run, or returns STATE_NONE once the script is done.
+static state_t headless_start(headless_script* script, install_context* ctx)
 {
-    FILE *f, *fsave;
-    int fd=0;
-    int len;
-    int ret = 2;
-    u8 *savebuffer;
-    u32 savesize;
-    char *strptr;
-    char *namestr, *valuestr;
-    u32 tmpval=0;
-    struct stat filestats;
-    char line[256];
-    char tmpstr[256];
-    char tmpstr2[256];
-    char savedir[256];
-
-    memset(savedir, 0, sizeof(savedir));
-    memset(tmpstr, 0, sizeof(tmpstr));
-
-    if(type < 2)
-        snprintf(savedir, sizeof(savedir) - 1, "%s/%s", versiondir, type == 0 ? "Old3DS" : "New3DS");
-    else
-        snprintf(savedir, sizeof(savedir) - 1, "%s/%s", versiondir, "common");
-
-    snprintf(tmpstr, sizeof(tmpstr) - 1, "%s/%s", savedir, "config.ini");
-
-    f = fopen(tmpstr, "r");
-    if(f == NULL) return 1;
-
-    memset(line, 0, sizeof(line));
-    while(fgets(line, sizeof(line) - 1, f))
+    while(headless_next(script, ctx) == 0)
     {
-        remove_newline(line);
-
-        len = strlen(line);
-        if(len == 0) continue;
-
-        strptr = strtok(line, "=");
-        if(strptr == NULL) break;
-        namestr = strptr;
-
-        strptr = strtok(NULL, "=");
-        if(strptr == NULL) break;
-        valuestr = strptr;
-
-        memset(tmpstr2, 0, sizeof(tmpstr2));
-
-        ret = convert_filepath(namestr, tmpstr2, sizeof(tmpstr2), selected_slot);
-        if(ret) break;
-
-        memset(tmpstr, 0, sizeof(tmpstr));
-        snprintf(tmpstr, sizeof(tmpstr) - 1, "%s/%s", savedir, tmpstr2);
-
-        fsave = fopen(tmpstr, "r");
-        if(fsave == NULL)
-        {
-            ret = 3;
-            break;
-        }
-
-        fd = fileno(fsave);
-        if(fd == -1)
-        {
-            fclose(fsave);
-            ret = errno;
-            break;
-        }
+        Result ret = install_start(ctx, 0);
+        if(R_SUCCEEDED(ret)) return install_poll(ctx);
 
-        if(fstat(fd, &filestats) == -1)
-        {
-            fclose(fsave);
-            ret = errno;
-            break;
-        }
-
-        savesize = filestats.st_size;
-        if(savesize == 0)
-        {
-            fclose(fsave);
-            ret = 4;
-            break;
-        }
-
-        savebuffer = malloc(savesize);
-        if(savebuffer == NULL)
-        {
-            fclose(fsave);
-            ret = 5;
-            break;
-        }
-
-        tmpval = fread(savebuffer, 1, savesize, fsave);
-        fclose(fsave);
-        if(tmpval != savesize)
-        {
-            ret = 6;
-            free(savebuffer);
-            break;
-        }
-
-        memset(tmpstr2, 0, sizeof(tmpstr2));
-
-        ret = convert_filepath(valuestr, tmpstr2, sizeof(tmpstr2), selected_slot);
-        if(ret)
-        {
-            free(savebuffer);
-            break;
-        }
-
-        ret = write_savedata(tmpstr2, savebuffer, savesize);
-        free(savebuffer);
-
-        if(ret) break;
+        status_set("Failed to start the install thread.");
+        headless_finish(script, ctx, ret);
     }
 
-    fclose(f);
-
-    return ret;
+    return STATE_NONE;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    u64 launch_tick = svcGetSystemTick();
+
+    status_init();
+    services_init();
+    jobs_init();
+
     gfxInitDefault();
     gfxSet3D(false);
 
@@ -696,258 +232,244 @@ int main()
 
     consoleSelect(&topConsole);
     consoleClear();
+    printf("\x1b[0;%dHsploit_installer: SALT edition\n\n\n", (50 - 31) / 2);
+
+    static render_screen top_screen, bottom_screen;
+    render_init(&top_screen, &topConsole);
+    render_init(&bottom_screen, &botConsole);
 
     state_t current_state = STATE_NONE;
     state_t next_state = STATE_INITIALIZE;
 
     FS_ProductInfo product_info;
 
-    char exploitname[64] = {0};
-    char titlename[64] = {0};
-
-    char versiondir[64] = {0};
-    char displayversion[64] = {0};
-
-    u32 flags_bitmask = 0;
+    static install_context ctx;
+    // every supported title on the console, when Y was pressed instead of installing to this one
+    static fleet provision;
+    bool provisioning = false;
 
-    static char top_text[2048];
-    char top_text_tmp[256];
-    top_text[0] = '\0';
-
-    int firmware_version[6] = {0};
     int firmware_selected_value = 0;
 
-    int selected_slot = 0;
     int selected_version = 0;
-    u32 selected_remaster = 0;
 
-    AM_TitleEntry update_title;
-    bool update_exists = false;
     int version_maxnum = 0;
 
-    void* payload_buffer = NULL;
-    size_t payload_size = 0;
+    static char trace_text[RENDER_LINE_SIZE];
+    static restore_context restore;
+    static Result saveio_dump_result;
+
+    // a script on the command line, on SD or in romfs replaces all input
+    static headless_script script;
+    Result script_ret = headless_parse_args(argc, argv, &script);
+    if(script_ret == 1) script_ret = headless_load(HEADLESS_SCRIPT_PATH, &script);
+    if(script_ret == 1 && R_SUCCEEDED(service_require(SERVICE_ROMFS))) script_ret = headless_load(HEADLESS_ROMFS_SCRIPT_PATH, &script);
 
-    u64 program_id = 0;
+    bool headless = script_ret == 0;
+    if(script_ret > 1) next_state = STATE_ERROR;
 
     while(aptMainLoop())
     {
         hidScanInput();
-        if(hidKeysDown() & KEY_START) break;
+        if(hidKeysDown() & KEY_START)
+        {
+            if(ctx.job) install_cancel(&ctx);
+            // a queued restore or dump is dropped, a running restore isn't cut short and finishes in jobs_exit()
+            if(restore.job) job_cancel(restore.job);
+            if(saveio_dump_job) job_cancel(saveio_dump_job);
+            break;
+        }
+
+        jobs_poll();
+
+        // SELECT dumps the save I/O counters and latencies, except while an install, backup or restore has the save open
+        if((hidKeysDown() & KEY_SELECT) && !ctx.running && !restore.job && !saveio_dump_job)
+            saveio_dump_job = job_submit(saveio_dump_run, saveio_dump_done, &saveio_dump_result, JOB_PRIORITY_LOW, 0);
 
         // transition function
         if(next_state != current_state)
         {
-            memset(top_text_tmp, 0, sizeof(top_text_tmp));
+            // keep the selection that was made on screen
+            if(current_state == STATE_SELECT_VERSION || current_state == STATE_SELECT_SLOT || current_state == STATE_SELECT_FIRMWARE)
+                render_commit_line(&top_screen, 1);
+            render_clear_lines(&top_screen);
 
             switch(next_state)
             {
                 case STATE_INITIALIZE:
-                    strncat(top_text, "Initializing... You may press START at any time\nto return to menu.\n\n", sizeof(top_text) - 1);
+                    render_append(&top_screen, "Initializing... You may press START at any time\nto return to menu, or SELECT to save the save I/O\nstats to SD while no install or restore runs.\n\n");
                     break;
                 case STATE_INITIAL:
-                    strncat(top_text, "Welcome to sploit_installer: SALT edition!\nPlease proceed with caution, as you might lose\ndata if you don't.\n\nPress A to continue.\n\n", sizeof(top_text) - 1);
+                    if(headless)
+                    {
+                        render_append(&top_screen, "Running %d scripted install(s) without input.\nResults are written to\n%s\n\n", script.count, HEADLESS_RESULT_PATH);
+                        break;
+                    }
+                    render_append(&top_screen, "Welcome to sploit_installer: SALT edition!\nPlease proceed with caution, as you might lose\ndata if you don't.\n\nPress A to continue, X to restore the last save\nbackup, Y to install to every supported title on\nthis console (hold L to back them up, R to verify).\n\n");
                     break;
                 case STATE_SELECT_VERSION:
-                    snprintf(top_text_tmp, sizeof(top_text_tmp) - 1, "Auto-detected %s version: %s\nD-Pad to select, A to continue.\n\n", titlename, displayversion);
+                    render_append(&top_screen, "Auto-detected %s version: %s\nD-Pad to select, A to continue.\n\n", ctx.titlename, ctx.displayversion);
                     break;
                 case STATE_SELECT_SLOT:
-                    snprintf(top_text_tmp, sizeof(top_text_tmp) - 1, "Please select the savegame slot %s will be\ninstalled to. D-Pad to select, A to continue.\n", exploitname);
+                    render_append(&top_screen, "Please select the savegame slot %s will be\ninstalled to. D-Pad to select, A to continue.\nGo past slot 3 to install to every slot.\n", ctx.exploitname);
                     break;
                 case STATE_SELECT_FIRMWARE:
-                    strncat(top_text, "Please select your console's firmware version.\nOnly select NEW 3DS if you own a New 3DS (XL).\nD-Pad to select, A to continue.\n", sizeof(top_text) - 1);
+                    render_append(&top_screen, "Please select your console's firmware version.\nOnly select NEW 3DS if you own a New 3DS (XL).\nD-Pad to select, A to continue (a payload cached\non SD is used without going online), Y to ask\nthe server for a newer payload first.\nHold L to back up the save first, R to verify\nit afterwards, X to only write the install plan\nto SD, B to install the prebaked save image from\nSD instead of the payload.\n");
                     break;
                 case STATE_DOWNLOAD_PAYLOAD:
-                    snprintf(top_text, sizeof(top_text) - 1, "%s\n\n\nDownloading payload...\n", top_text);
+                    render_append(&top_screen, "\nDownloading payload...\n");
                     break;
                 case STATE_COMPRESS_PAYLOAD:
-                    strncat(top_text, "Processing payload...\n", sizeof(top_text) - 1);
+                    render_append(&top_screen, "Processing payload...\n");
+                    break;
+                case STATE_BACKUP_SAVE:
+                    render_append(&top_screen, "Backing up the savedata...\n");
                     break;
                 case STATE_INSTALL_PAYLOAD:
-                    strncat(top_text, "Installing payload...\n\n", sizeof(top_text) - 1);
+                    render_append(&top_screen, "Installing payload...\n\n");
                     break;
                 case STATE_INSTALLED_PAYLOAD:
-                    snprintf(top_text_tmp, sizeof(top_text_tmp) - 1, "Done!\n%s was successfully installed.", exploitname);
+                    if(provisioning) render_append(&top_screen, "Done!\nEvery supported title was provisioned.");
+                    else if(ctx.dry_run) render_append(&top_screen, "Done!\nThe plan for %s was written to SD.", ctx.exploitname);
+                    else render_append(&top_screen, "Done!\n%s was successfully installed.", ctx.exploitname);
+                    install_summary(trace_text, sizeof(trace_text));
                     break;
                 case STATE_ERROR:
-                    strncat(top_text, "Looks like something went wrong. :(\n", sizeof(top_text) - 1);
+                    render_append(&top_screen, "Looks like something went wrong. :(\n");
+                    install_summary(trace_text, sizeof(trace_text));
                     break;
                 default:
                     break;
             }
 
-            if(top_text_tmp[0]) strncat(top_text, top_text_tmp, sizeof(top_text) - 1);
-
             current_state = next_state;
         }
 
-        consoleSelect(&topConsole);
-        printf("\x1b[0;%dHsploit_installer: SALT edition\n\n\n", (50 - 31) / 2);
-        printf(top_text);
-
         // state function
         switch(current_state)
         {
             case STATE_INITIALIZE:
                 {
-                    fsInit();
-
-                    // get an fs:USER session as the game
-                    Result ret = srvGetServiceHandleDirect(&save_session, "fs:USER");
-                    if(R_SUCCEEDED(ret)) ret = FSUSER_Initialize(save_session);
-                    if(R_FAILED(ret))
-                    {
-                        snprintf(status, sizeof(status) - 1, "Failed to get game fs:USER session.\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    ret = httpcInit(0);
-                    if(R_FAILED(ret))
-                    {
-                        snprintf(status, sizeof(status) - 1, "Failed to initialize httpc.\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
                     OS_VersionBin nver_versionbin, cver_versionbin;
-                    ret = osGetSystemVersionData(&nver_versionbin, &cver_versionbin);
-                    if(R_FAILED(ret))
-                    {
-                        snprintf(status, sizeof(status) - 1, "Failed to get the system version.\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    ret = cfguInit();
-                    if(R_FAILED(ret))
-                    {
-                        snprintf(status, sizeof(status) - 1, "Failed to initialize cfgu.\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    u8 region = 0;
-                    ret = CFGU_SecureInfoGetRegion(&region);
+                    Result ret = osGetSystemVersionData(&nver_versionbin, &cver_versionbin);
                     if(R_FAILED(ret))
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to get the system region.\n    Error code: %08lX", ret);
+                        status_set("Failed to get the system version.\n    Error code: %08lX", ret);
                         next_state = STATE_ERROR;
                         break;
                     }
 
-                    cfguExit();
-
                     bool is_new3ds = false;
                     APT_CheckNew3DS(&is_new3ds);
 
-                    firmware_version[0] = is_new3ds;
-                    firmware_version[5] = region;
+                    ctx.firmware_version[0] = is_new3ds;
 
-                    firmware_version[1] = cver_versionbin.mainver;
-                    firmware_version[2] = cver_versionbin.minor;
-                    firmware_version[3] = cver_versionbin.build;
-                    firmware_version[4] = nver_versionbin.mainver;
+                    ctx.firmware_version[1] = cver_versionbin.mainver;
+                    ctx.firmware_version[2] = cver_versionbin.minor;
+                    ctx.firmware_version[3] = cver_versionbin.build;
+                    ctx.firmware_version[4] = nver_versionbin.mainver;
 
                     u32 pid = 0;
                     ret = svcGetProcessId(&pid, CUR_PROCESS_HANDLE);
                     if(R_FAILED(ret))
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to get the process ID for the current process.\n    Error code: %08lX", ret);
+                        status_set("Failed to get the process ID for the current process.\n    Error code: %08lX", ret);
                         next_state = STATE_ERROR;
                         break;
                     }
 
                     ret = FSUSER_GetProductInfo(&product_info, pid);
-                    selected_remaster = product_info.remasterVersion;
+                    ctx.selected_remaster = product_info.remasterVersion;
                     if(R_FAILED(ret))
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to get the product info for the current process.\n    Error code: %08lX", ret);
+                        status_set("Failed to get the product info for the current process.\n    Error code: %08lX", ret);
                         next_state = STATE_ERROR;
                         break;
                     }
 
-                    ret = APT_GetProgramID(&program_id);
+                    ret = APT_GetProgramID(&ctx.program_id);
                     if(R_FAILED(ret))
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to get the program ID for the current process.\n    Error code: %08lX", ret);
+                        status_set("Failed to get the program ID for the current process.\n    Error code: %08lX", ret);
                         next_state = STATE_ERROR;
                         break;
                     }
 
-                    u64 update_program_id = 0;
-                    if(((program_id >> 32) & 0xFFFF) == 0) update_program_id = program_id | 0x0000000E00000000ULL;
+                    static startup_context startup;
+                    startup.ctx = &ctx;
+                    if(((ctx.program_id >> 32) & 0xFFFF) == 0) startup.update_program_id = ctx.program_id | 0x0000000E00000000ULL;
 
-                    if(update_program_id)
-                    {
-                        ret = amInit();
-                        if(R_FAILED(ret))
-                        {
-                            snprintf(status, sizeof(status) - 1, "Failed to initialize AM.\n    Error code: %08lX", ret);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-
-                        ret = AM_GetTitleInfo(1, 1, &update_program_id, &update_title);
-                        amExit();
+                    static const service_task startup_tasks[STARTUP_TASK_COUNT] = {
+                        [STARTUP_SAVE_SESSION] = startup_save_session,
+                        [STARTUP_REGION] = startup_region,
+                        [STARTUP_UPDATE_TITLE] = startup_update_title,
+                        [STARTUP_EXPLOIT] = startup_exploit,
+                    };
+                    Result startup_results[STARTUP_TASK_COUNT];
 
-                        if(R_SUCCEEDED(ret))
-                            update_exists = true;
-                    }
+                    int span = trace_begin("startup", NULL);
+                    services_run_parallel(startup_tasks, STARTUP_TASK_COUNT, &startup, startup_results);
+                    trace_end(span, 0);
 
-                    ret = romfsInit();
-                    if(R_FAILED(ret))
-                    {
-                        snprintf(status, sizeof(status) - 1, "Failed to initialize romfs for this application (romfsInit()).\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    ret = load_exploitlist_config("romfs:/exploitlist_config", &program_id, exploitname, titlename, &flags_bitmask);
-                    if(ret)
+                    int failed_task = 0;
+                    for(; failed_task < STARTUP_TASK_COUNT; failed_task++)
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to select the exploit.\n    Error code: %08lX", ret);
-                        if(ret == 1) strncat(status, " Failed to\nopen the config file in romfs.", sizeof(status) - 1);
-                        if(ret == 2) strncat(status, " This title is not supported.", sizeof(status) - 1);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    int version_index = 0;
-                    u32 this_remaster = 0;
-                    char this_displayversion[64] = {0};
-                    while(true)
-                    {
-                        ret = load_exploitversion(exploitname, &program_id, version_index, &this_remaster, this_displayversion);
+                        ret = startup_results[failed_task];
                         if(ret) break;
-
-                        if(this_remaster == selected_remaster)
-                        {
-                            strncpy(displayversion, this_displayversion, 63);
-                            selected_version = version_index;
-                        }
-
-                        version_index++;
                     }
 
-                    if(version_index == 0)
+                    if(ret)
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to read remaster versions from config.");
+                        status_set("%s\n    Error code: %08lX", startup.error[failed_task], ret);
                         next_state = STATE_ERROR;
                         break;
                     }
 
-                    version_maxnum = version_index - 1;
+                    selected_version = startup.selected_version;
+                    version_maxnum = startup.version_count - 1;
+                    status_set("Started in %lu ms.", (u32)((svcGetSystemTick() - launch_tick) / (SYSCLOCK_ARM11 / 1000)));
                     next_state = STATE_INITIAL;
                 }
                 break;
 
             case STATE_INITIAL:
                 {
-                    if(hidKeysDown() & KEY_A)
+                    if(headless) next_state = headless_start(&script, &ctx);
+                    // nothing else starts while the backup is being restored
+                    else if(restore.job) break;
+                    else if(hidKeysDown() & KEY_X)
+                    {
+                        restore.program_id = ctx.program_id;
+                        restore.job = job_submit(restore_run, restore_done, &restore, JOB_PRIORITY_HIGH, JOB_CPU_HEAVY);
+                        if(restore.job) status_set("Restoring the save backup...");
+                    }
+                    else if(hidKeysDown() & KEY_Y)
+                    {
+                        Result ret = fleet_scan("romfs:/exploitlist_config", &provision);
+                        if(ret) status_set("Failed to list the installed titles.\n    Error code: %08lX", ret);
+                        else if(provision.count == 0) status_set("None of the installed titles is supported.");
+                        else
+                        {
+                            ctx.offline = false;
+                            ctx.update = false;
+                            ctx.verify = (hidKeysHeld() & KEY_R) != 0;
+                            ctx.backup = (hidKeysHeld() & KEY_L) != 0;
+
+                            ret = fleet_start(&provision, &ctx);
+                            if(R_FAILED(ret))
+                            {
+                                status_set("Failed to start the install thread.");
+                                next_state = STATE_ERROR;
+                                break;
+                            }
+
+                            provisioning = true;
+                            next_state = install_poll(&ctx);
+                        }
+                    }
+                    else if(hidKeysDown() & KEY_A)
                     {
                         if(version_maxnum != 0) next_state = STATE_SELECT_VERSION;
-                        else if(flags_bitmask & 0x10) next_state = STATE_SELECT_FIRMWARE;
+                        else if(ctx.flags_bitmask & 0x10) next_state = STATE_SELECT_FIRMWARE;
                         else next_state = STATE_SELECT_SLOT;
                     }
                 }
@@ -959,39 +481,44 @@ int main()
                     if(hidKeysDown() & KEY_DOWN) selected_version--;
                     if(hidKeysDown() & KEY_A)
                     {
-                        if(flags_bitmask & 0x10) next_state = STATE_SELECT_FIRMWARE;
+                        if(ctx.flags_bitmask & 0x10) next_state = STATE_SELECT_FIRMWARE;
                         else next_state = STATE_SELECT_SLOT;
                     }
 
                     if(selected_version < 0) selected_version = 0;
                     if(selected_version > version_maxnum) selected_version = version_maxnum;
 
-                    Result ret = load_exploitversion(exploitname, &program_id, selected_version, &selected_remaster, displayversion);
+                    Result ret = load_exploitversion(ctx.exploitname, &ctx.program_id, selected_version, &ctx.selected_remaster, ctx.displayversion);
                     if(ret)
                     {
-                        snprintf(status, sizeof(status) - 1, "Failed to read remaster version from config.");
+                        status_set("Failed to read remaster version from config.");
                         next_state = STATE_ERROR;
                         break;
                     }
 
-                    printf((selected_version >= version_maxnum) ? "                       \n" : "                      ^\n");
-                    printf("      Selected version: %s  \n", displayversion);
-                    printf((!selected_version) ? "                       \n" : "                      v\n");
+                    render_line(&top_screen, 0, (selected_version >= version_maxnum) ? "" : "                      ^");
+                    render_line(&top_screen, 1, "      Selected version: %s", ctx.displayversion);
+                    render_line(&top_screen, 2, (!selected_version) ? "" : "                      v");
                 }
                 break;
 
             case STATE_SELECT_SLOT:
                 {
-                    if(hidKeysDown() & KEY_UP) selected_slot++;
-                    if(hidKeysDown() & KEY_DOWN) selected_slot--;
+                    if(hidKeysDown() & KEY_UP) ctx.selected_slot++;
+                    if(hidKeysDown() & KEY_DOWN) ctx.selected_slot--;
                     if(hidKeysDown() & KEY_A) next_state = STATE_SELECT_FIRMWARE;
 
-                    if(selected_slot < 0) selected_slot = 0;
-                    if(selected_slot > 2) selected_slot = 2;
+                    if(ctx.selected_slot < 0) ctx.selected_slot = 0;
+                    if(ctx.selected_slot > SAVE_SLOT_COUNT) ctx.selected_slot = SAVE_SLOT_COUNT;
 
-                    printf((selected_slot >= 2) ? "                                             \n" : "                                            ^\n");
-                    printf("                            Selected slot: %d  \n", selected_slot + 1);
-                    printf((!selected_slot) ? "                                             \n" : "                                            v\n");
+                    // one past the last slot is every slot
+                    ctx.all_slots = ctx.selected_slot == SAVE_SLOT_COUNT;
+
+                    char slot[12];
+                    format_slot(ctx.all_slots ? -1 : ctx.selected_slot, slot, sizeof(slot));
+                    render_line(&top_screen, 0, (ctx.selected_slot >= SAVE_SLOT_COUNT) ? "" : "                                            ^");
+                    render_line(&top_screen, 1, "                            Selected slot: %s", slot);
+                    render_line(&top_screen, 2, (!ctx.selected_slot) ? "" : "                                            v");
                 }
                 break;
 
@@ -1003,17 +530,35 @@ int main()
                     if(firmware_selected_value < 0) firmware_selected_value = 0;
                     if(firmware_selected_value > 5) firmware_selected_value = 5;
 
-                    if(hidKeysDown() & KEY_UP) firmware_version[firmware_selected_value]++;
-                    if(hidKeysDown() & KEY_DOWN) firmware_version[firmware_selected_value]--;
+                    if(hidKeysDown() & KEY_UP) ctx.firmware_version[firmware_selected_value]++;
+                    if(hidKeysDown() & KEY_DOWN) ctx.firmware_version[firmware_selected_value]--;
 
                     int firmware_maxnum = 256;
                     if(firmware_selected_value == 0) firmware_maxnum = 2;
                     if(firmware_selected_value == 5) firmware_maxnum = 7;
 
-                    if(firmware_version[firmware_selected_value] < 0) firmware_version[firmware_selected_value] = 0;
-                    if(firmware_version[firmware_selected_value] >= firmware_maxnum) firmware_version[firmware_selected_value] = firmware_maxnum - 1;
+                    if(ctx.firmware_version[firmware_selected_value] < 0) ctx.firmware_version[firmware_selected_value] = 0;
+                    if(ctx.firmware_version[firmware_selected_value] >= firmware_maxnum) ctx.firmware_version[firmware_selected_value] = firmware_maxnum - 1;
 
-                    if(hidKeysDown() & KEY_A) next_state = STATE_DOWNLOAD_PAYLOAD;
+                    if(hidKeysDown() & (KEY_A | KEY_Y))
+                    {
+                        ctx.offline = false;
+                        ctx.update = (hidKeysDown() & KEY_Y) != 0;
+                        ctx.verify = (hidKeysHeld() & KEY_R) != 0;
+                        ctx.backup = (hidKeysHeld() & KEY_L) != 0;
+                        ctx.prebaked = (hidKeysHeld() & KEY_B) != 0;
+                        ctx.dry_run = (hidKeysHeld() & KEY_X) != 0;
+
+                        Result ret = install_start(&ctx, 0);
+                        if(R_FAILED(ret))
+                        {
+                            status_set("Failed to start the install thread.");
+                            next_state = STATE_ERROR;
+                            break;
+                        }
+
+                        next_state = install_poll(&ctx);
+                    }
 
                     int offset = 26;
                     if(firmware_selected_value)
@@ -1023,185 +568,70 @@ int main()
                         for(int i = 1; i < firmware_selected_value; i++)
                         {
                             offset += 2;
-                            if(firmware_version[i] >= 10) offset++;
+                            if(ctx.firmware_version[i] >= 10) offset++;
                         }
                     }
 
-                    printf((firmware_version[firmware_selected_value] < firmware_maxnum - 1) ? "%*s^%*s" : "%*s-%*s", offset, " ", 50 - offset - 1, " ");
-                    printf("      Selected firmware: %s %d-%d-%d-%d %s  \n", firmware_version[0] ? "New3DS" : "Old3DS", firmware_version[1], firmware_version[2], firmware_version[3], firmware_version[4], regions[firmware_version[5]]);
-                    printf((firmware_version[firmware_selected_value] > 0) ? "%*sv%*s" : "%*s-%*s", offset, " ", 50 - offset - 1, " ");
+                    render_line(&top_screen, 0, "%*s%c", offset, " ", (ctx.firmware_version[firmware_selected_value] < firmware_maxnum - 1) ? '^' : '-');
+                    render_line(&top_screen, 1, "      Selected firmware: %s %d-%d-%d-%d %s", ctx.firmware_version[0] ? "New3DS" : "Old3DS", ctx.firmware_version[1], ctx.firmware_version[2], ctx.firmware_version[3], ctx.firmware_version[4], regions[ctx.firmware_version[5]]);
+                    render_line(&top_screen, 2, "%*s%c", offset, " ", (ctx.firmware_version[firmware_selected_value] > 0) ? 'v' : '-');
                 }
                 break;
 
             case STATE_DOWNLOAD_PAYLOAD:
-                {
-                    httpcContext context;
-                    static char in_url[512];
-                    static char out_url[512];
-
-                    snprintf(in_url, sizeof(in_url) - 1, "http://smea.mtheall.com/get_payload.php?version=%s-%d-%d-%d-%d-%s",
-                        firmware_version[0] ? "NEW" : "OLD", firmware_version[1], firmware_version[2], firmware_version[3], firmware_version[4], regions[firmware_version[5]]);
-
-                    char user_agent[64];
-                    snprintf(user_agent, sizeof(user_agent) - 1, "salt_sploit_installer-%s", exploitname);
-                    Result ret = get_redirect(in_url, out_url, 512, user_agent);
-                    if(R_FAILED(ret))
-                    {
-                        sprintf(status, "Failed to grab payload url\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    ret = httpcOpenContext(&context, HTTPC_METHOD_GET, out_url, 0);
-                    if(R_FAILED(ret))
-                    {
-                        sprintf(status, "Failed to open http context\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    ret = download_file(&context, &payload_buffer, &payload_size, user_agent);
-                    if(R_FAILED(ret))
-                    {
-                        sprintf(status, "Failed to download payload\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    if(flags_bitmask & 0x1) next_state = STATE_COMPRESS_PAYLOAD;
-                    else next_state = STATE_INSTALL_PAYLOAD;
-                }
-                break;
-
             case STATE_COMPRESS_PAYLOAD:
-                payload_buffer = BLZ_Code(payload_buffer, payload_size, &payload_size, BLZ_NORMAL);
-                next_state = STATE_INSTALL_PAYLOAD;
+            case STATE_BACKUP_SAVE:
+            case STATE_INSTALL_PAYLOAD:
+                next_state = install_poll(&ctx);
                 break;
 
-            case STATE_INSTALL_PAYLOAD:
+            case STATE_INSTALLED_PAYLOAD:
+                next_state = STATE_NONE;
+                if(headless)
                 {
-                    u32 selected_remaster_version = 0;
-                    Result ret = load_exploitconfig(exploitname, &program_id, selected_remaster, update_exists ? &update_title.version : NULL, &selected_remaster_version, versiondir, displayversion);
-                    if(ret)
-                    {
-                        snprintf(status, sizeof(status) - 1, "Failed to find your version of\n%s in the config / config loading failed.\n    Error code: %08lX", titlename, ret);
-                        if(ret == 1) strncat(status, " Failed to\nopen the config file in romfs.", sizeof(status) - 1);
-                        if(ret == 2 || ret == 4) strncat(status, " The romfs config file is invalid.", sizeof(status) - 1);
-                        if(ret == 3)
-                        {
-                            snprintf(status, sizeof(status) - 1, "this update-title version (v%u) of %s is not compatible with %s, sorry\n", update_title.version, titlename, exploitname);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-                        if(ret == 5)
-                        {
-                            snprintf(status, sizeof(status) - 1, "this remaster version (%04lX) of %s is not compatible with %s, sorry\n", selected_remaster_version, titlename, exploitname);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    if(flags_bitmask & 0x8)
-                    {
-                        fsUseSession(save_session);
-                        Result ret = FSUSER_FormatSaveData(ARCHIVE_SAVEDATA, (FS_Path){PATH_EMPTY, 1, (u8*)""}, 0x200, 10, 10, 11, 11, true);
-                        fsEndUseSession();
-                        if(ret)
-                        {
-                            sprintf(status, "Failed to format savedata.\n    Error code: %08lX", ret);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-                    }
-
-                    if(flags_bitmask & 0x2)
-                    {
-                        Result ret = parsecopy_saveconfig(versiondir, firmware_version[0], selected_slot);
-                        if(ret)
-                        {
-                            sprintf(status, "Failed to install the savefiles with romfs %s savedir.\n    Error code: %08lX", firmware_version[0] == 0?"Old3DS" : "New3DS", ret);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-                    }
-
-                    if(flags_bitmask & 0x4)
-                    {
-                        Result ret = parsecopy_saveconfig(versiondir, 2, selected_slot);
-                        if(ret)
-                        {
-                            sprintf(status, "Failed to install the savefiles with romfs %s savedir.\n    Error code: %08lX", "common", ret);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-                    }
+                    headless_finish(&script, &ctx, 0);
+                    next_state = headless_start(&script, &ctx);
                 }
+                break;
 
+            case STATE_ERROR:
+                if(headless)
                 {
-                    Result ret;
-
-                    if(payload_embed.enabled)
-                    {
-                        void* buffer = NULL;
-                        size_t size = 0;
-                        ret = read_savedata(payload_embed.path, &buffer, &size);
-                        if(ret)
-                        {
-                            sprintf(status, "Failed to embed payload\n    Error code: %08lX", ret);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-                        if((payload_embed.offset + payload_size + sizeof(u32)) >= size)
-                        {
-                            sprintf(status, "Failed to embed payload (too large)\n    0x%X >= 0x%X", (payload_embed.offset + payload_size + sizeof(u32)), size);
-                            next_state = STATE_ERROR;
-                            break;
-                        }
-
-                        *(u32*)(buffer + payload_embed.offset) = payload_size;
-                        memcpy(buffer + payload_embed.offset + sizeof(u32), payload_buffer, payload_size);
-                        ret = write_savedata(payload_embed.path, buffer, size);
-
-                        free(buffer);
-                    }
-                    else
-                        ret = write_savedata("/payload.bin", payload_buffer, payload_size);
-
-                    if(ret)
-                    {
-                        sprintf(status, "Failed to install payload\n    Error code: %08lX", ret);
-                        next_state = STATE_ERROR;
-                        break;
-                    }
-
-                    next_state = STATE_INSTALLED_PAYLOAD;
+                    if(script.running) headless_finish(&script, &ctx, ctx.result);
+                    else headless_abort(&script, &ctx, -1);
+                    next_state = headless_start(&script, &ctx);
                 }
                 break;
 
-            case STATE_INSTALLED_PAYLOAD:
-                next_state = STATE_NONE;
-                break;
-
             default: break;
         }
 
-        consoleSelect(&botConsole);
-        printf("\x1b[0;0H  Current status:\n    %s\n", status);
+        // a finished script exits on its own
+        if(headless && next_state == STATE_NONE) break;
+
+        render_flush(&top_screen);
+
+        render_line(&bottom_screen, 0, "  Current status:");
+        // copied out, since the install thread may be setting it
+        char text[STATUS_SIZE];
+        status_get(text, sizeof(text));
+        render_line(&bottom_screen, 1, "    %s", text);
+        if(ctx.running && install_progress.total)
+            render_line(&bottom_screen, 8, "  Progress: %lu / %lu bytes (%lu%%)", install_progress.done, install_progress.total, (u32)((u64)install_progress.done * 100 / install_progress.total));
+        else
+            render_line(&bottom_screen, 8, "");
+        render_line(&bottom_screen, 7, "%s", saveio_text);
+        render_line(&bottom_screen, 9, "%s", trace_text);
+        render_flush(&bottom_screen);
 
         gspWaitForVBlank();
     }
 
-    if(payload_buffer) free(payload_buffer);
-
-    romfsExit();
-    httpcExit();
+    jobs_exit();
+    arena_free(&install_arena);
 
-    svcCloseHandle(save_session);
-    fsExit();
+    services_exit();
 
     gfxExit();
-    return 0;
+    return script.failed ? 1 : 0;
 }
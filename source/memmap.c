@@ -0,0 +1,69 @@
+#include <string.h>
+#include <stdio.h>
+
+#include <3ds.h>
+
+#include "crc32c.h"
+#include "memmap.h"
+
+Result memmap_load(const char* path, memmap_table* out)
+{
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    memset(out, 0, sizeof(*out));
+    memmap_header* header = &out->header;
+
+    Result ret = 0;
+    if(fread(header, 1, sizeof(*header), f) != sizeof(*header) || memcmp(header->magic, MEMMAP_MAGIC, sizeof(header->magic))
+        || header->count == 0 || header->count > MEMMAP_MAX_RANGES)
+        ret = 4;
+    else if(fread(out->ranges, sizeof(memmap_range), header->count, f) != header->count)
+        ret = 4;
+    else if(crc32c_update(0, out->ranges, header->count * sizeof(memmap_range)) != header->crc)
+        ret = 6;
+
+    fclose(f);
+    if(ret) return ret;
+
+    // the compiler already checked everything else, translating only relies on the order
+    for(u32 i = 1; i < header->count; i++)
+        if(out->ranges[i].src < out->ranges[i - 1].src + out->ranges[i - 1].size) return 4;
+
+    return 0;
+}
+
+Result memmap_load_title(const char* exploitname, u64 program_id, const char* versiondir, memmap_table* out)
+{
+    char path[256];
+
+    if(versiondir)
+    {
+        snprintf(path, sizeof(path), "%s/%s", versiondir, MEMMAP_FILENAME);
+        Result ret = memmap_load(path, out);
+        if(ret != 1) return ret;
+    }
+
+    snprintf(path, sizeof(path), "romfs:/%s/%016llx/%s", exploitname, program_id, MEMMAP_FILENAME);
+    return memmap_load(path, out);
+}
+
+Result memmap_translate(const memmap_table* table, u32 address, s32* out_offset)
+{
+    // the last range starting at or before address
+    u32 low = 0, high = table->header.count;
+    while(low < high)
+    {
+        u32 mid = (low + high) / 2;
+        if(table->ranges[mid].src <= address) low = mid + 1;
+        else high = mid;
+    }
+
+    if(low == 0) return 1;
+
+    const memmap_range* range = &table->ranges[low - 1];
+    if(address - range->src >= range->size) return 1;
+
+    *out_offset = range->dst + (s32)(address - range->src);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef _MEMMAP_H_
+#define _MEMMAP_H_
+
+#include <3ds.h>
+
+#define MEMMAP_MAGIC "SALTMMAP"
+#define MEMMAP_FILENAME "memmap.bin"
+#define MEMMAP_MAX_RANGES 16
+
+// A title's memory map, compiled from mmap/<program ID>.xml (or mmap/<program ID>_<version>.xml for a map
+// that only applies to one version) by tools/memmap_compile.py, which rejects overlapping and out-of-range
+// entries. A table is:
+//   memmap_header
+//   memmap_range for every entry, sorted by src
+// all little-endian, with crc the CRC-32C of the ranges.
+typedef struct {
+    char magic[8];
+    u32 count;
+    u32 crc;
+    u32 data_address;
+    u32 data_size;
+    u32 text_end;
+    u32 process_hook_address;
+    u32 process_app_code_address;
+    u32 process_linear_offset;
+} memmap_header;
+
+// [src, src + size) maps to [dst, dst + size), dst being an offset that may be negative.
+typedef struct {
+    u32 src;
+    u32 size;
+    s32 dst;
+} memmap_range;
+
+typedef struct {
+    memmap_header header;
+    memmap_range ranges[MEMMAP_MAX_RANGES];
+} memmap_table;
+
+// Returns 1 when path can't be opened, 4 when it isn't a valid table and 6 when its CRC doesn't match.
+Result memmap_load(const char* path, memmap_table* out);
+
+// Loads the map of a title's version: <versiondir>/memmap.bin when the version has one of its own, otherwise
+// romfs:/<exploit>/<program ID>/memmap.bin next to the title's config.ini. versiondir may be NULL.
+Result memmap_load_title(const char* exploitname, u64 program_id, const char* versiondir, memmap_table* out);
+
+// The offset address maps to, in O(log n). Returns 1 when no range holds address.
+Result memmap_translate(const memmap_table* table, u32 address, s32* out_offset);
+
+#endif // _MEMMAP_H_
@@ -0,0 +1,268 @@
+#include <string.h>
+#include <stdio.h>
+
+#include <3ds.h>
+
+#include "mirrors.h"
+#include "trace.h"
+
+#define MIRROR_STACK_SIZE 0x4000
+// how often the race checks the deadlines and the cancelled callback while nothing happens
+#define MIRROR_POLL_NS 20000000LL
+#define TICKS_PER_MS (SYSCLOCK_ARM11 / 1000)
+
+typedef enum
+{
+    RACER_CONNECTING,
+    // for the first byte of the response
+    RACER_WAITING,
+    RACER_ANSWERED,
+    RACER_FAILED,
+} racer_phase;
+
+typedef struct {
+    LightLock lock;
+    CondVar changed;
+    const mirror_request* request;
+} race_state;
+
+// One mirror's requests, on their own thread. Everything but the context's use is guarded by the race's lock.
+typedef struct {
+    race_state* race;
+    const mirror* m;
+    int index;
+    Thread thread;
+
+    httpcContext context;
+    bool open;
+    // dropped by the race, which owns result and phase from then on
+    bool cancelled;
+    racer_phase phase;
+    u64 phase_start;
+
+    u32 status_code;
+    Result result;
+} mirror_racer;
+
+void mirrors_load(const char* path, const char* fallback, mirror_list* out)
+{
+    char line[512];
+
+    memset(out, 0, sizeof(*out));
+
+    FILE* f = fopen(path, "r");
+    while(f && out->count < MIRRORS_MAX && fgets(line, sizeof(line), f))
+    {
+        mirror* m = &out->mirrors[out->count];
+        unsigned long connect_ms = MIRROR_CONNECT_TIMEOUT_MS, first_byte_ms = MIRROR_FIRST_BYTE_TIMEOUT_MS;
+
+        if(sscanf(line, "%255s %lu %lu", m->url, &connect_ms, &first_byte_ms) < 1 || m->url[0] == '#') continue;
+
+        // the path gets its own slash
+        size_t len = strlen(m->url);
+        if(m->url[len - 1] == '/') m->url[len - 1] = 0;
+
+        m->connect_ms = connect_ms;
+        m->first_byte_ms = first_byte_ms;
+        out->count++;
+    }
+
+    if(f) fclose(f);
+    if(out->count) return;
+
+    snprintf(out->mirrors[0].url, sizeof(out->mirrors[0].url), "%s", fallback);
+    out->mirrors[0].connect_ms = MIRROR_CONNECT_TIMEOUT_MS;
+    out->mirrors[0].first_byte_ms = MIRROR_FIRST_BYTE_TIMEOUT_MS;
+    out->count = 1;
+}
+
+// The caller holds the race's lock.
+static void racer_set_phase(mirror_racer* r, racer_phase phase)
+{
+    if(r->cancelled) return;
+
+    r->phase = phase;
+    r->phase_start = svcGetSystemTick();
+    CondVar_Signal(&r->race->changed);
+}
+
+// The caller holds the race's lock.
+static void racer_cancel(mirror_racer* r, Result reason)
+{
+    if(r->phase != RACER_CONNECTING && r->phase != RACER_WAITING) return;
+
+    r->cancelled = true;
+    r->result = reason;
+    r->phase = RACER_FAILED;
+    if(r->open) httpcCancelConnection(&r->context);
+}
+
+static void racer_close(mirror_racer* r)
+{
+    LightLock_Lock(&r->race->lock);
+    if(r->open) httpcCloseContext(&r->context);
+    r->open = false;
+    LightLock_Unlock(&r->race->lock);
+}
+
+// Sends a GET for url and waits for the status line. The context is left open, even when this fails.
+static Result racer_get(mirror_racer* r, const char* url, bool payload)
+{
+    race_state* race = r->race;
+    const mirror_request* request = race->request;
+
+    LightLock_Lock(&race->lock);
+    bool cancelled = r->cancelled;
+    racer_set_phase(r, RACER_CONNECTING);
+    LightLock_Unlock(&race->lock);
+    if(cancelled) return MIRROR_CANCELLED;
+
+    // opened without the lock, so a slow mirror doesn't hold up the deadlines and the other racers. Nothing else
+    // touches the context until it's published as open.
+    Result ret = httpcOpenContext(&r->context, HTTPC_METHOD_GET, url, 0);
+
+    LightLock_Lock(&race->lock);
+    r->open = R_SUCCEEDED(ret);
+    if(r->cancelled) ret = MIRROR_CANCELLED;
+    LightLock_Unlock(&race->lock);
+    if(R_FAILED(ret)) return ret;
+
+    ret = httpcAddRequestHeaderField(&r->context, "User-Agent", request->user_agent);
+    if(R_SUCCEEDED(ret) && payload && request->base_hex)
+    {
+        ret = httpcAddRequestHeaderField(&r->context, "A-IM", "saltdiff");
+        if(R_SUCCEEDED(ret)) ret = httpcAddRequestHeaderField(&r->context, "X-Base-SHA256", request->base_hex);
+    }
+    if(R_SUCCEEDED(ret)) ret = httpcBeginRequest(&r->context);
+
+    LightLock_Lock(&race->lock);
+    if(r->cancelled) ret = MIRROR_CANCELLED;
+    if(R_SUCCEEDED(ret)) racer_set_phase(r, RACER_WAITING);
+    LightLock_Unlock(&race->lock);
+    if(R_FAILED(ret)) return ret;
+
+    // the race cancels the connection at the deadline as well, this only bounds the wait if that doesn't end it
+    ret = httpcGetResponseStatusCodeTimeout(&r->context, &r->status_code, (u64)r->m->first_byte_ms * 1000000);
+    return ret == (Result)HTTPC_RESULTCODE_TIMEDOUT ? MIRROR_TIMED_OUT : ret;
+}
+
+static void racer_thread(void* arg)
+{
+    mirror_racer* r = arg;
+    race_state* race = r->race;
+    char url[512], location[512];
+
+    int span = trace_begin("mirror", r->m->url);
+
+    snprintf(url, sizeof(url), "%s/%s", r->m->url, race->request->path);
+    Result ret = racer_get(r, url, false);
+    if(R_SUCCEEDED(ret)) ret = httpcGetResponseHeader(&r->context, "Location", location, sizeof(location));
+    racer_close(r);
+
+    if(R_SUCCEEDED(ret)) ret = racer_get(r, location, true);
+    if(R_SUCCEEDED(ret) && r->status_code != 200 && r->status_code != 226 && r->status_code != 304) ret = MIRROR_BAD_STATUS;
+    if(R_FAILED(ret)) racer_close(r);
+
+    trace_end(span, 0);
+
+    LightLock_Lock(&race->lock);
+    if(r->cancelled)
+    {
+        // answered just as it was dropped
+        if(r->open) httpcCloseContext(&r->context);
+        r->open = false;
+    }
+    else
+    {
+        r->result = ret;
+        r->phase = R_SUCCEEDED(ret) ? RACER_ANSWERED : RACER_FAILED;
+    }
+    CondVar_Signal(&race->changed);
+    LightLock_Unlock(&race->lock);
+}
+
+Result mirror_race(const mirror_list* list, u32 skip, const mirror_request* request, mirror_response* out)
+{
+    mirror_racer racers[MIRRORS_MAX];
+    race_state race;
+    mirror_racer* winner = NULL;
+    int count = 0;
+    s32 prio = 0x30;
+
+    LightLock_Init(&race.lock);
+    CondVar_Init(&race.changed);
+    race.request = request;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+    // the racers only get going once every one of them is started
+    LightLock_Lock(&race.lock);
+
+    for(int i = 0; i < list->count; i++)
+    {
+        if(skip & (1 << i)) continue;
+
+        mirror_racer* r = &racers[count++];
+        memset(r, 0, sizeof(*r));
+        r->race = &race;
+        r->m = &list->mirrors[i];
+        r->index = i;
+        r->phase = RACER_CONNECTING;
+        r->phase_start = svcGetSystemTick();
+
+        r->thread = threadCreate(racer_thread, r, MIRROR_STACK_SIZE, prio, -2, false);
+        if(r->thread == NULL)
+        {
+            r->phase = RACER_FAILED;
+            r->result = MIRROR_BAD_STATUS;
+        }
+    }
+
+    bool cancelled = false;
+    for(;;)
+    {
+        int running = 0;
+        u64 now = svcGetSystemTick();
+
+        for(int i = 0; i < count; i++)
+        {
+            mirror_racer* r = &racers[i];
+            if(r->phase == RACER_ANSWERED && winner == NULL) winner = r;
+            if(r->phase != RACER_CONNECTING && r->phase != RACER_WAITING) continue;
+
+            u32 deadline_ms = r->phase == RACER_CONNECTING ? r->m->connect_ms : r->m->first_byte_ms;
+            if(now - r->phase_start > (u64)deadline_ms * TICKS_PER_MS) racer_cancel(r, MIRROR_TIMED_OUT);
+            else running++;
+        }
+
+        cancelled = request->cancelled && request->cancelled();
+        if(winner || running == 0 || cancelled) break;
+
+        CondVar_WaitTimeout(&race.changed, &race.lock, MIRROR_POLL_NS);
+    }
+
+    for(int i = 0; i < count; i++)
+        if(&racers[i] != winner) racer_cancel(&racers[i], MIRROR_CANCELLED);
+
+    LightLock_Unlock(&race.lock);
+
+    for(int i = 0; i < count; i++)
+    {
+        if(racers[i].thread == NULL) continue;
+
+        threadJoin(racers[i].thread, U64_MAX);
+        threadFree(racers[i].thread);
+    }
+
+    if(winner)
+    {
+        out->index = winner->index;
+        out->context = winner->context;
+        out->status_code = winner->status_code;
+        return 0;
+    }
+
+    if(cancelled) return MIRROR_CANCELLED;
+
+    // the first mirror in the list speaks for the race
+    return count ? racers[0].result : MIRROR_BAD_STATUS;
+}
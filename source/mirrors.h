@@ -0,0 +1,57 @@
+#ifndef _MIRRORS_H_
+#define _MIRRORS_H_
+
+#include <3ds.h>
+
+#define MIRRORS_MAX 4
+
+// Per request deadlines, a mirror that misses one is dropped from the race. The connect deadline runs until the
+// request is sent, the first byte one from then until the response's status line.
+#define MIRROR_CONNECT_TIMEOUT_MS 5000
+#define MIRROR_FIRST_BYTE_TIMEOUT_MS 10000
+
+// mirror_race() results for a mirror that missed a deadline, and for a race stopped through its cancelled callback
+#define MIRROR_TIMED_OUT -0x30
+#define MIRROR_CANCELLED -0x31
+// result for a mirror that answered with a status the payload request can't use
+#define MIRROR_BAD_STATUS -0x32
+
+typedef struct {
+    char url[256];
+    u32 connect_ms;
+    u32 first_byte_ms;
+} mirror;
+
+typedef struct {
+    mirror mirrors[MIRRORS_MAX];
+    int count;
+} mirror_list;
+
+// What every mirror is asked: "{url}/{path}", which redirects to the payload itself.
+typedef struct {
+    const char* path;
+    const char* user_agent;
+    // sha256 of the cached payload sent as a delta base, NULL without one
+    const char* base_hex;
+    // polled while the race runs, stops it when it returns true, may be NULL
+    bool (*cancelled)(void);
+} mirror_request;
+
+typedef struct {
+    // into the mirror list
+    int index;
+    // the payload request, with its response's headers in and its body still to be received
+    httpcContext context;
+    u32 status_code;
+} mirror_response;
+
+// One mirror per line of path: "{url} [{connect_ms} [{first_byte_ms}]]", up to MIRRORS_MAX of them. Blank lines
+// and lines starting with "#" are ignored. Without the file, or without a mirror in it, the list is fallback alone.
+void mirrors_load(const char* path, const char* fallback, mirror_list* out);
+
+// Sends the request to every mirror whose bit isn't set in skip at once and returns the first one to answer the
+// payload request with 200, 226 or 304, cancelling the others. The caller closes the response's context.
+// Returns the last failure when no mirror answers, MIRROR_CANCELLED when the request's cancelled callback returned true.
+Result mirror_race(const mirror_list* list, u32 skip, const mirror_request* request, mirror_response* out);
+
+#endif // _MIRRORS_H_
@@ -0,0 +1,208 @@
+#include <string.h>
+#include <stdio.h>
+
+#include <3ds.h>
+
+#include "plan.h"
+
+// Rough costs of the save calls on an Old3DS, per call and per byte moved, for whatever the calibration lacks.
+typedef struct {
+    u32 call_us;
+    u32 byte_ns;
+} plan_op_cost;
+
+static const plan_op_cost default_costs[SAVEIO_OP_COUNT] = {
+    [SAVEIO_OPEN_ARCHIVE] = { 5000, 0 },
+    [SAVEIO_CLOSE_ARCHIVE] = { 1000, 0 },
+    [SAVEIO_OPEN] = { 1500, 0 },
+    [SAVEIO_READ] = { 300, 500 },
+    [SAVEIO_WRITE] = { 300, 1000 },
+    [SAVEIO_GET_SIZE] = { 200, 0 },
+    [SAVEIO_CLOSE] = { 300, 0 },
+    [SAVEIO_REMOVE] = { 2000, 0 },
+    [SAVEIO_CREATE] = { 3000, 0 },
+    [SAVEIO_LIST] = { 1000, 0 },
+    [SAVEIO_COMMIT] = { 20000, 0 },
+    [SAVEIO_FORMAT] = { 150000, 0 },
+};
+
+// reads from the RomFS image
+#define ROMFS_BYTE_NS 200
+
+static const char* const source_names[] = {
+    [PLAN_SOURCE_ROMFS] = "romfs",
+    [PLAN_SOURCE_PAYLOAD] = "payload",
+    [PLAN_SOURCE_IMAGE] = "image",
+    [PLAN_SOURCE_SAVE] = "save",
+};
+
+void plan_reset(install_plan* plan, bool format, bool verify)
+{
+    plan->format = format;
+    plan->format_blocks = 0;
+    plan->format_files = 0;
+    plan->verify = verify;
+    plan->count = 0;
+}
+
+plan_write* plan_find(install_plan* plan, const char* path)
+{
+    for(u32 i = 0; i < plan->count; i++)
+    {
+        if(strcmp(plan->writes[i].path, path) == 0) return &plan->writes[i];
+    }
+
+    return NULL;
+}
+
+Result plan_add(install_plan* plan, const plan_write* write)
+{
+    plan_write* w = plan_find(plan, write->path);
+    u32 coalesced = 0;
+
+    if(w) coalesced = w->coalesced + 1;
+    else if(plan->count == PLAN_MAX_WRITES) return 7;
+    else w = &plan->writes[plan->count++];
+
+    *w = *write;
+    w->coalesced = coalesced;
+    return 0;
+}
+
+// romfs files by their offset in the image, the rest after them in the order they came
+static int plan_rank(const plan_write* a, const plan_write* b)
+{
+    bool a_romfs = a->source == PLAN_SOURCE_ROMFS, b_romfs = b->source == PLAN_SOURCE_ROMFS;
+    if(a_romfs != b_romfs) return a_romfs ? -1 : 1;
+    if(!a_romfs || a->offset == b->offset) return 0;
+
+    return a->offset < b->offset ? -1 : 1;
+}
+
+void plan_order(install_plan* plan)
+{
+    // an insertion sort keeps equal writes in order, and there are only a few dozen of them
+    for(u32 i = 1; i < plan->count; i++)
+    {
+        plan_write w = plan->writes[i];
+        u32 j = i;
+        for(; j > 0 && plan_rank(&w, &plan->writes[j - 1]) < 0; j--) plan->writes[j] = plan->writes[j - 1];
+        plan->writes[j] = w;
+    }
+}
+
+static void plan_op(plan_cost* cost, saveio_op op, u32 count, u64 bytes)
+{
+    cost->ops[op] += count;
+    cost->bytes[op] += bytes;
+}
+
+// Mirrors what the install stage does with the plan, see stage_install_payload() and write_savedata().
+void plan_estimate(const install_plan* plan, u32 chunk_size, const saveio_stats* calibration, plan_cost* out)
+{
+    memset(out, 0, sizeof(*out));
+
+    u32 created = 0;
+    for(u32 i = 0; i < plan->count; i++)
+        if(plan->writes[i].size) created++;
+
+    if(plan->format)
+    {
+        plan_op(out, SAVEIO_FORMAT, 1, 0);
+        if(created)
+        {
+            plan_op(out, SAVEIO_OPEN_ARCHIVE, 1, 0);
+            plan_op(out, SAVEIO_CREATE, created, 0);
+            plan_op(out, SAVEIO_COMMIT, 1, 0);
+            plan_op(out, SAVEIO_CLOSE_ARCHIVE, 1, 0);
+        }
+    }
+
+    plan_op(out, SAVEIO_OPEN_ARCHIVE, 1, 0);
+
+    // everything that isn't written in place is removed up front, with one commit, but for what's read back
+    u32 removed = 0;
+    for(u32 i = 0; i < plan->count; i++)
+        if(!plan->writes[i].in_place && !plan->writes[i].committed && plan->writes[i].source != PLAN_SOURCE_SAVE) removed++;
+    if(removed)
+    {
+        plan_op(out, SAVEIO_REMOVE, removed, 0);
+        plan_op(out, SAVEIO_COMMIT, 1, 0);
+    }
+
+    for(u32 i = 0; i < plan->count; i++)
+    {
+        const plan_write* w = &plan->writes[i];
+        u32 chunks = (w->size + chunk_size - 1) / chunk_size;
+
+        if(w->source == PLAN_SOURCE_ROMFS) out->romfs_bytes += w->size;
+        // a resumed install doesn't write again what it already committed
+        if(w->committed) continue;
+
+        // read back whole, then removed on its own since its size isn't known
+        if(w->source == PLAN_SOURCE_SAVE)
+        {
+            plan_op(out, SAVEIO_OPEN, 1, 0);
+            plan_op(out, SAVEIO_GET_SIZE, 1, 0);
+            plan_op(out, SAVEIO_READ, 1, 0);
+            plan_op(out, SAVEIO_CLOSE, 1, 0);
+            plan_op(out, SAVEIO_REMOVE, 1, 0);
+            plan_op(out, SAVEIO_COMMIT, 1, 0);
+            chunks = 1;
+        }
+
+        plan_op(out, SAVEIO_OPEN, 1, 0);
+        plan_op(out, SAVEIO_WRITE, chunks, w->size);
+        plan_op(out, SAVEIO_CLOSE, 1, 0);
+        plan_op(out, SAVEIO_COMMIT, 1, 0);
+    }
+
+    for(u32 i = 0; i < plan->count && plan->verify; i++)
+    {
+        const plan_write* w = &plan->writes[i];
+        plan_op(out, SAVEIO_OPEN, 1, 0);
+        plan_op(out, SAVEIO_GET_SIZE, 1, 0);
+        plan_op(out, SAVEIO_READ, (w->size + chunk_size - 1) / chunk_size, w->size);
+        plan_op(out, SAVEIO_CLOSE, 1, 0);
+    }
+
+    plan_op(out, SAVEIO_CLOSE_ARCHIVE, 1, 0);
+
+    out->us = out->romfs_bytes * ROMFS_BYTE_NS / 1000;
+    for(int op = 0; op < SAVEIO_OP_COUNT; op++)
+    {
+        const saveio_op_stats* measured = calibration ? &calibration->ops[op] : NULL;
+
+        if(measured && measured->count && default_costs[op].byte_ns && measured->bytes)
+            out->us += measured->total_us * out->bytes[op] / measured->bytes;
+        else if(measured && measured->count && default_costs[op].byte_ns == 0)
+            out->us += measured->total_us * out->ops[op] / measured->count;
+        else
+            out->us += (u64)default_costs[op].call_us * out->ops[op] + out->bytes[op] * default_costs[op].byte_ns / 1000;
+    }
+}
+
+void plan_print(const install_plan* plan, const plan_cost* cost, FILE* f)
+{
+    fprintf(f, "format=%d", plan->format);
+    if(plan->format) fprintf(f, " blocks=%lu files=%lu", (unsigned long)plan->format_blocks, (unsigned long)plan->format_files);
+    fprintf(f, " verify=%d writes=%lu\n", plan->verify, (unsigned long)plan->count);
+
+    for(u32 i = 0; i < plan->count; i++)
+    {
+        const plan_write* w = &plan->writes[i];
+
+        fprintf(f, "write %s size=%lu source=%s", w->path, (unsigned long)w->size, source_names[w->source]);
+        if(w->source == PLAN_SOURCE_ROMFS) fprintf(f, " from=%s", w->romfs_path);
+        if(w->embed) fprintf(f, " embed=%08lX", (unsigned long)w->embed_offset);
+        if(w->coalesced) fprintf(f, " coalesced=%lu", (unsigned long)w->coalesced);
+        fprintf(f, "%s%s\n", w->in_place ? " in_place" : "", w->committed ? " committed" : "");
+    }
+
+    u32 calls = 0;
+    for(int op = 0; op < SAVEIO_OP_COUNT; op++) calls += cost->ops[op];
+
+    fprintf(f, "estimate romfs_read=%llu written=%llu save_calls=%lu archive_opens=%lu opens=%lu writes=%lu removes=%lu creates=%lu commits=%lu reads=%lu time_ms=%llu\n",
+        (unsigned long long)cost->romfs_bytes, (unsigned long long)cost->bytes[SAVEIO_WRITE], (unsigned long)calls, (unsigned long)cost->ops[SAVEIO_OPEN_ARCHIVE], (unsigned long)cost->ops[SAVEIO_OPEN], (unsigned long)cost->ops[SAVEIO_WRITE],
+        (unsigned long)cost->ops[SAVEIO_REMOVE], (unsigned long)cost->ops[SAVEIO_CREATE], (unsigned long)cost->ops[SAVEIO_COMMIT], (unsigned long)cost->ops[SAVEIO_READ], (unsigned long long)(cost->us / 1000));
+}
@@ -0,0 +1,87 @@
+#ifndef _PLAN_H_
+#define _PLAN_H_
+
+#include <stdio.h>
+
+#include <3ds.h>
+
+#include "saveio.h"
+
+#define PLAN_MAX_WRITES 64
+#define PLAN_PATH_SIZE 256
+// where a dry run writes the plan
+#define PLAN_PATH "sdmc:/salt_sploit_installer/plan.txt"
+
+typedef enum
+{
+    // a romfs file, at offset in the RomFS image (0 when it's read through stdio)
+    PLAN_SOURCE_ROMFS,
+    PLAN_SOURCE_PAYLOAD,
+    // the prebaked image's data, at offset
+    PLAN_SOURCE_IMAGE,
+    // the file already in the save, read back: a payload embedded into a file the install doesn't write
+    PLAN_SOURCE_SAVE,
+} plan_source;
+
+// One save file, written once with its final contents.
+typedef struct {
+    char path[PLAN_PATH_SIZE];
+    plan_source source;
+    char romfs_path[PLAN_PATH_SIZE];
+    u64 offset;
+    // 0 for PLAN_SOURCE_SAVE, whose size is only known once it's read
+    u32 size;
+
+    // the payload goes in at embed_offset, after its size as a u32
+    bool embed;
+    u32 embed_offset;
+    // how many earlier writes of the same path this one replaced
+    u32 coalesced;
+    // created at its size by the format, so it's written in place
+    bool in_place;
+    // committed by the interrupted install this one resumes
+    bool committed;
+
+    // set while the install stage runs: the file is in the save at size (created by the format, or already
+    // written), so writing it again is done in place
+    bool exists;
+    // removed up front along with the plan's other files, so its write doesn't remove it again
+    bool removed;
+} plan_write;
+
+// Everything the install stage does to the save, built before any of it is done.
+typedef struct {
+    bool format;
+    u32 format_blocks;
+    u32 format_files;
+    bool verify;
+
+    u32 count;
+    plan_write writes[PLAN_MAX_WRITES];
+} install_plan;
+
+// What executing a plan costs: the save calls it makes, as saveio counts them, the romfs bytes it reads and the
+// time all of that should take.
+typedef struct {
+    u32 ops[SAVEIO_OP_COUNT];
+    u64 bytes[SAVEIO_OP_COUNT];
+    u64 romfs_bytes;
+    u64 us;
+} plan_cost;
+
+void plan_reset(install_plan* plan, bool format, bool verify);
+// NULL when the plan doesn't write path.
+plan_write* plan_find(install_plan* plan, const char* path);
+// Adds a write, or replaces the plan's earlier write of the same path, since only the last one would have been
+// left in the save. Returns 7 when the plan is full.
+Result plan_add(install_plan* plan, const plan_write* write);
+// Orders the writes the way they're best done: the romfs files in the order they're in the RomFS image, so its
+// reads go forward through it, then everything else as it was added.
+void plan_order(install_plan* plan);
+
+// The cost of the install stage executing plan, writing chunk_size bytes at a time. Calls that calibration (e.g.
+// this session's saveio stats, may be NULL) has made are timed with its averages, the others with rough figures.
+void plan_estimate(const install_plan* plan, u32 chunk_size, const saveio_stats* calibration, plan_cost* out);
+void plan_print(const install_plan* plan, const plan_cost* cost, FILE* f);
+
+#endif // _PLAN_H_
@@ -0,0 +1,141 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "render.h"
+
+void render_init(render_screen* screen, PrintConsole* console)
+{
+    memset(screen, 0, sizeof(*screen));
+
+    screen->console = console;
+    screen->text_x = console->cursorX;
+    screen->text_y = console->cursorY;
+}
+
+void render_append(render_screen* screen, const char* fmt, ...)
+{
+    va_list args;
+    size_t space = sizeof(screen->text) - 1 - screen->text_len;
+
+    if(space == 0) return;
+
+    va_start(args, fmt);
+    int len = vsnprintf(&screen->text[screen->text_len], space + 1, fmt, args);
+    va_end(args);
+
+    if(len < 0) return;
+    screen->text_len += (size_t)len < space ? (size_t)len : space;
+}
+
+void render_line(render_screen* screen, int index, const char* fmt, ...)
+{
+    char line[RENDER_LINE_SIZE];
+    va_list args;
+
+    if(index < 0 || index >= RENDER_MAX_LINES) return;
+
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if(strcmp(line, screen->lines[index]) == 0) return;
+
+    strcpy(screen->lines[index], line);
+    screen->dirty |= 1 << index;
+}
+
+void render_clear_lines(render_screen* screen)
+{
+    for(int i = 0; i < RENDER_MAX_LINES; i++)
+    {
+        if(screen->lines[i][0]) screen->dirty |= 1 << i;
+        screen->lines[i][0] = 0;
+    }
+}
+
+void render_commit_line(render_screen* screen, int index)
+{
+    if(index < 0 || index >= RENDER_MAX_LINES || !screen->lines[index][0]) return;
+
+    render_append(screen, "%s\n", screen->lines[index]);
+    screen->lines[index][0] = 0;
+    screen->dirty |= 1 << index;
+}
+
+// Slots follow each other below the text log, each taking a row plus one for every newline in it.
+static void render_layout(const render_screen* screen, char (*lines)[RENDER_LINE_SIZE], int* rows)
+{
+    int row = screen->text_y + (screen->text_x ? 1 : 0);
+
+    for(int i = 0; i < RENDER_MAX_LINES; i++)
+    {
+        rows[i] = row++;
+        for(const char* ptr = lines[i]; *ptr; ptr++)
+            if(*ptr == '\n') row++;
+    }
+}
+
+// Overwrites what was drawn in a slot with spaces, keeping its newlines so wrapped rows are covered too.
+static void render_erase_line(render_screen* screen, int index, int row)
+{
+    char* drawn = screen->drawn[index];
+
+    if(!drawn[0]) return;
+
+    for(char* ptr = drawn; *ptr; ptr++)
+        if(*ptr != '\n') *ptr = ' ';
+
+    screen->console->cursorX = 0;
+    screen->console->cursorY = row;
+    printf("%s", drawn);
+    drawn[0] = 0;
+}
+
+void render_flush(render_screen* screen)
+{
+    int i;
+    int drawn_rows[RENDER_MAX_LINES], rows[RENDER_MAX_LINES];
+
+    consoleSelect(screen->console);
+    render_layout(screen, screen->drawn, drawn_rows);
+
+    if(screen->text_printed < screen->text_len)
+    {
+        // The new text is printed over the slots, which are redrawn below it.
+        for(i = 0; i < RENDER_MAX_LINES; i++)
+        {
+            render_erase_line(screen, i, drawn_rows[i]);
+            if(screen->lines[i][0]) screen->dirty |= 1 << i;
+        }
+
+        screen->console->cursorX = screen->text_x;
+        screen->console->cursorY = screen->text_y;
+        printf("%s", &screen->text[screen->text_printed]);
+
+        screen->text_printed = screen->text_len;
+        screen->text_x = screen->console->cursorX;
+        screen->text_y = screen->console->cursorY;
+    }
+
+    // A slot that gained or lost rows moves the ones after it.
+    render_layout(screen, screen->lines, rows);
+    for(i = 0; i < RENDER_MAX_LINES; i++)
+        if(rows[i] != drawn_rows[i] && screen->drawn[i][0]) screen->dirty |= 1 << i;
+
+    // Everything that changed is erased first, so a moved slot isn't erased again by the one it moved over.
+    for(i = 0; i < RENDER_MAX_LINES; i++)
+        if(screen->dirty & (1 << i)) render_erase_line(screen, i, drawn_rows[i]);
+
+    for(i = 0; i < RENDER_MAX_LINES; i++)
+    {
+        if(!(screen->dirty & (1 << i)) || !screen->lines[i][0]) continue;
+
+        screen->console->cursorX = 0;
+        screen->console->cursorY = rows[i];
+        printf("%s", screen->lines[i]);
+        strcpy(screen->drawn[i], screen->lines[i]);
+    }
+
+    screen->dirty = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include <3ds.h>
+
+#define RENDER_TEXT_SIZE 2048
+#define RENDER_MAX_LINES 10
+#define RENDER_LINE_SIZE 1024
+
+// A console screen made of an append-only text log followed by a few line slots.
+// Only newly appended text and slots whose contents changed are printed on flush.
+typedef struct {
+    PrintConsole* console;
+
+    char text[RENDER_TEXT_SIZE];
+    size_t text_len;
+    size_t text_printed;
+    int text_x, text_y;
+
+    char lines[RENDER_MAX_LINES][RENDER_LINE_SIZE];
+    char drawn[RENDER_MAX_LINES][RENDER_LINE_SIZE];
+    u32 dirty;
+} render_screen;
+
+// The text log starts at the console's current cursor position.
+void render_init(render_screen* screen, PrintConsole* console);
+void render_append(render_screen* screen, const char* fmt, ...);
+
+// Line slots are rows below the end of the text log, in order. A slot may contain newlines, which move
+// the slots after it down.
+void render_line(render_screen* screen, int index, const char* fmt, ...);
+void render_clear_lines(render_screen* screen);
+// Moves a slot's contents into the text log, so it stays on screen.
+void render_commit_line(render_screen* screen, int index);
+
+void render_flush(render_screen* screen);
+
+#endif // _RENDER_H_
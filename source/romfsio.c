@@ -0,0 +1,297 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3ds.h>
+
+#include "romfsio.h"
+
+#define ROMFSIO_NONE 0xFFFFFFFF
+#define ROMFSIO_PREFIX "romfs:/"
+
+// The level-3 RomFS header, and the entries of its directory and file tables. Names are UTF-16 and
+// name_size is in bytes, entries are padded to 4 bytes.
+typedef struct {
+    u32 header_size;
+    u32 dir_hash_offset;
+    u32 dir_hash_size;
+    u32 dir_table_offset;
+    u32 dir_table_size;
+    u32 file_hash_offset;
+    u32 file_hash_size;
+    u32 file_table_offset;
+    u32 file_table_size;
+    u32 file_data_offset;
+} romfsio_header;
+
+typedef struct {
+    u32 parent;
+    u32 sibling;
+    u32 child_dir;
+    u32 child_file;
+    u32 next_hash;
+    u32 name_size;
+    u16 name[];
+} romfsio_dir;
+
+typedef struct {
+    u32 parent;
+    u32 sibling;
+    u64 data_offset;
+    u64 data_size;
+    u32 next_hash;
+    u32 name_size;
+    u16 name[];
+} romfsio_file;
+
+static Handle image;
+// of the level-3 image in the file image is, 0 unless it's a 3DSX
+static u64 image_offset;
+static romfsio_header header;
+
+static u32* dir_hash;
+static u8* dir_table;
+static u32* file_hash;
+static u8* file_table;
+
+static Result read_exact(u64 offset, void* buffer, u32 size)
+{
+    u32 bytes_read = 0;
+    Result ret = FSFILE_Read(image, &bytes_read, offset, buffer, size);
+    if(R_FAILED(ret)) return ret;
+
+    return bytes_read == size ? 0 : 6;
+}
+
+static Result load_table(u32 offset, u32 size, void** out)
+{
+    *out = malloc(size ? size : 1);
+    if(*out == NULL) return 5;
+
+    return read_exact(image_offset + offset, *out, size);
+}
+
+// The 3DSX the application was started from, whose extended header has the offset of its RomFS, or else the
+// title's own ARCHIVE_ROMFS.
+static Result open_image(void)
+{
+#ifdef _3DS
+    extern int __system_argc;
+    extern char** __system_argv;
+
+    if(envIsHomebrew())
+    {
+        if(__system_argc < 1 || __system_argv[0] == NULL || strncmp(__system_argv[0], "sdmc:/", 6)) return 1;
+
+        Result ret = FSUSER_OpenFileDirectly(&image, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, __system_argv[0] + 5), FS_OPEN_READ, 0);
+        if(R_FAILED(ret)) return ret;
+
+        // magic, header sizes, version, flags and segment sizes, then the SMDH and the RomFS
+        u32 header_3dsx[11];
+        ret = read_exact(0, header_3dsx, sizeof(header_3dsx));
+        if(ret == 0 && (memcmp(header_3dsx, "3DSX", 4) || (header_3dsx[1] & 0xFFFF) < sizeof(header_3dsx) || header_3dsx[10] == 0)) ret = 4;
+        if(ret) return ret;
+
+        image_offset = header_3dsx[10];
+        return 0;
+    }
+#endif
+
+    static const u32 romfs_path[3] = {0};
+    image_offset = 0;
+    return FSUSER_OpenFileDirectly(&image, ARCHIVE_ROMFS, fsMakePath(PATH_EMPTY, ""), (FS_Path){PATH_BINARY, sizeof(romfs_path), romfs_path}, FS_OPEN_READ, 0);
+}
+
+Result romfsio_init(void)
+{
+    Result ret = open_image();
+    if(ret == 0) ret = read_exact(image_offset, &header, sizeof(header));
+    if(ret == 0 && (header.header_size != sizeof(header) || header.dir_hash_size < 4 || header.file_hash_size < 4)) ret = 4;
+    if(ret == 0) ret = load_table(header.dir_hash_offset, header.dir_hash_size, (void**)&dir_hash);
+    if(ret == 0) ret = load_table(header.dir_table_offset, header.dir_table_size, (void**)&dir_table);
+    if(ret == 0) ret = load_table(header.file_hash_offset, header.file_hash_size, (void**)&file_hash);
+    if(ret == 0) ret = load_table(header.file_table_offset, header.file_table_size, (void**)&file_table);
+
+    if(ret) romfsio_exit();
+    return ret;
+}
+
+void romfsio_exit(void)
+{
+    if(image) FSFILE_Close(image);
+    image = 0;
+
+    free(dir_hash);
+    free(dir_table);
+    free(file_hash);
+    free(file_table);
+    dir_hash = NULL;
+    dir_table = NULL;
+    file_hash = NULL;
+    file_table = NULL;
+}
+
+// The same hash as the RomFS builder, over the name's UTF-16 units.
+static u32 name_hash(u32 parent, const char* name, u32 length, u32 buckets)
+{
+    u32 hash = parent ^ 123456789;
+    for(u32 i = 0; i < length; i++)
+    {
+        hash = (hash >> 5) | (hash << 27);
+        hash ^= (u8)name[i];
+    }
+
+    return hash % buckets;
+}
+
+static bool name_equals(const u16* entry_name, u32 name_size, const char* name, u32 length)
+{
+    if(name_size != length * 2) return false;
+
+    for(u32 i = 0; i < length; i++)
+        if(entry_name[i] != (u8)name[i]) return false;
+
+    return true;
+}
+
+// The entry at offset in a table, or NULL when it doesn't fit.
+static const void* table_entry(const u8* table, u32 table_size, u32 offset, u32 entry_size)
+{
+    if(offset >= table_size || table_size - offset < entry_size) return NULL;
+
+    u32 name_size = *(const u32*)&table[offset + entry_size - 4];
+    if(table_size - offset - entry_size < name_size) return NULL;
+
+    return &table[offset];
+}
+
+// Follows the hash chain of name in parent. Returns ROMFSIO_NONE when it isn't there.
+static u32 find_dir(u32 parent, const char* name, u32 length)
+{
+    u32 offset = dir_hash[name_hash(parent, name, length, header.dir_hash_size / 4)];
+
+    while(offset != ROMFSIO_NONE)
+    {
+        const romfsio_dir* dir = table_entry(dir_table, header.dir_table_size, offset, sizeof(romfsio_dir));
+        if(dir == NULL) return ROMFSIO_NONE;
+        if(dir->parent == parent && name_equals(dir->name, dir->name_size, name, length)) return offset;
+
+        offset = dir->next_hash;
+    }
+
+    return ROMFSIO_NONE;
+}
+
+static const romfsio_file* find_file(u32 parent, const char* name, u32 length)
+{
+    u32 offset = file_hash[name_hash(parent, name, length, header.file_hash_size / 4)];
+
+    while(offset != ROMFSIO_NONE)
+    {
+        const romfsio_file* file = table_entry(file_table, header.file_table_size, offset, sizeof(romfsio_file));
+        if(file == NULL) return NULL;
+        if(file->parent == parent && name_equals(file->name, file->name_size, name, length)) return file;
+
+        offset = file->next_hash;
+    }
+
+    return NULL;
+}
+
+Result romfsio_find(const char* path, romfs_extent* out)
+{
+    if(file_table == NULL || strncmp(path, ROMFSIO_PREFIX, strlen(ROMFSIO_PREFIX))) return 1;
+    path += strlen(ROMFSIO_PREFIX);
+
+    // every component but the last is a directory, starting from the root at offset 0
+    u32 dir = 0;
+    while(true)
+    {
+        while(*path == '/') path++;
+
+        const char* end = strchr(path, '/');
+        if(end == NULL) break;
+
+        dir = find_dir(dir, path, end - path);
+        if(dir == ROMFSIO_NONE) return 3;
+
+        path = end;
+    }
+
+    const romfsio_file* file = find_file(dir, path, strlen(path));
+    if(file == NULL) return 3;
+    if(file->data_size > 0xFFFFFFFF) return 4;
+
+    out->offset = image_offset + header.file_data_offset + file->data_offset;
+    out->size = file->data_size;
+    return 0;
+}
+
+Result romfsio_read(const romfs_extent* extent, u32 offset, void* buffer, u32 size)
+{
+    if(offset > extent->size || extent->size - offset < size) return 6;
+
+    return read_exact(extent->offset + offset, buffer, size);
+}
+
+Result romfs_text_open(const char* path, romfs_text* out)
+{
+    memset(out, 0, sizeof(*out));
+
+    romfs_extent extent;
+    if(romfsio_find(path, &extent) == 0 && (out->data = malloc(extent.size + 1)))
+    {
+        if(romfsio_read(&extent, 0, out->data, extent.size) == 0)
+        {
+            out->size = extent.size;
+            out->data[out->size] = 0;
+            return 0;
+        }
+
+        romfs_text_close(out);
+    }
+
+    // whatever the image can't serve goes through stdio
+    FILE* f = fopen(path, "r");
+    if(f == NULL) return 1;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    out->data = size < 0 ? NULL : malloc(size + 1);
+    if(out->data) out->size = fread(out->data, 1, size, f);
+    fclose(f);
+
+    if(out->data == NULL) return 5;
+
+    out->data[out->size] = 0;
+    return 0;
+}
+
+char* romfs_text_gets(char* line, int size, romfs_text* text)
+{
+    if(size < 1 || text->pos >= text->size) return NULL;
+
+    int len = 0;
+    while(len < size - 1 && text->pos < text->size)
+    {
+        char c = text->data[text->pos++];
+        line[len++] = c;
+        if(c == '\n') break;
+    }
+
+    line[len] = 0;
+    return line;
+}
+
+void romfs_text_rewind(romfs_text* text)
+{
+    text->pos = 0;
+}
+
+void romfs_text_close(romfs_text* text)
+{
+    free(text->data);
+    memset(text, 0, sizeof(*text));
+}
@@ -0,0 +1,38 @@
+#ifndef _ROMFSIO_H_
+#define _ROMFSIO_H_
+
+#include <3ds.h>
+
+// Where a romfs file's data is, as an offset into the file holding the RomFS image.
+typedef struct {
+    u64 offset;
+    u32 size;
+} romfs_extent;
+
+// A text file read whole, for configs that are parsed line by line.
+typedef struct {
+    char* data;
+    u32 size;
+    u32 pos;
+} romfs_text;
+
+// Opens the application's RomFS image (ARCHIVE_ROMFS, or the RomFS appended to the 3DSX) and loads its
+// directory and file tables, see SERVICE_ROMFS_IMAGE. Returns 4 when the image isn't a valid level-3 RomFS.
+Result romfsio_init(void);
+void romfsio_exit(void);
+
+// Resolves a "romfs:/" path through the tables, without going through the romfs devoptab. Returns 1 when the
+// image isn't open or path isn't a romfs path, and 3 when there's no such file.
+Result romfsio_find(const char* path, romfs_extent* out);
+// Reads size bytes from offset in the extent straight into buffer, with a single FSFILE_Read().
+Result romfsio_read(const romfs_extent* extent, u32 offset, void* buffer, u32 size);
+
+// Reads the whole file at path, through the image when it's a romfs file and otherwise through stdio.
+// Returns 1 when it can't be opened.
+Result romfs_text_open(const char* path, romfs_text* out);
+// Like fgets() on the file.
+char* romfs_text_gets(char* line, int size, romfs_text* text);
+void romfs_text_rewind(romfs_text* text);
+void romfs_text_close(romfs_text* text);
+
+#endif // _ROMFSIO_H_
@@ -0,0 +1,98 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <3ds.h>
+
+#include "saveimage.h"
+#include "crc32c.h"
+
+void saveimage_name(const char* exploitname, u64 program_id, const char* displayversion, const char* firmware, const char* slot, char* out, size_t out_size)
+{
+    snprintf(out, out_size, "%s_%016llX_%s_%s_%s.img", exploitname, (unsigned long long)program_id, displayversion, firmware, slot);
+
+    // display versions are free text, anything that isn't fine in a file name becomes '-'
+    for(char* c = out; *c; c++)
+        if(!isalnum((unsigned char)*c) && !strchr("_-.", *c)) *c = '-';
+}
+
+static bool read_exact(FILE* f, void* buffer, size_t size)
+{
+    return fread(buffer, 1, size, f) == size;
+}
+
+Result saveimage_load(const char* path, arena* a, saveimage* out)
+{
+    memset(out, 0, sizeof(*out));
+
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    Result ret = 0;
+    saveimage_header* header = &out->header;
+    if(!read_exact(f, header, sizeof(*header))) ret = 6;
+    else if(memcmp(header->magic, SAVEIMAGE_MAGIC, sizeof(header->magic)) || header->count == 0 || header->count > SAVEIMAGE_MAX_FILES) ret = 4;
+
+    if(ret == 0)
+    {
+        out->entries = arena_alloc(a, header->count * sizeof(saveimage_entry));
+        out->data = arena_alloc(a, header->data_size ? header->data_size : 1);
+        if(out->entries == NULL || out->data == NULL) ret = 5;
+    }
+
+    if(ret == 0 && !read_exact(f, out->entries, header->count * sizeof(saveimage_entry))) ret = 6;
+    if(ret == 0 && crc32c_update(0, out->entries, header->count * sizeof(saveimage_entry)) != header->crc) ret = 6;
+    if(ret == 0 && !read_exact(f, out->data, header->data_size)) ret = 6;
+    fclose(f);
+
+    for(u32 i = 0; ret == 0 && i < header->count; i++)
+    {
+        saveimage_entry* entry = &out->entries[i];
+        if(entry->path[0] != '/' || !memchr(entry->path, 0, sizeof(entry->path))) ret = 4;
+        else if(entry->size == 0 || entry->offset > header->data_size || header->data_size - entry->offset < entry->size) ret = 4;
+        else if(crc32c_update(0, &out->data[entry->offset], entry->size) != entry->crc) ret = 6;
+    }
+
+    if(ret)
+    {
+        out->entries = NULL;
+        out->data = NULL;
+    }
+
+    return ret;
+}
+
+Result saveimage_write(const char* path, u32 flags_bitmask, saveimage_entry* entries, const void* const* data, u32 count)
+{
+    saveimage_header header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAVEIMAGE_MAGIC, sizeof(header.magic));
+    header.count = count;
+    header.flags_bitmask = flags_bitmask;
+
+    for(u32 i = 0; i < count; i++)
+    {
+        entries[i].offset = header.data_size;
+        entries[i].crc = crc32c_update(0, data[i], entries[i].size);
+        header.data_size += entries[i].size;
+    }
+    header.crc = crc32c_update(0, entries, count * sizeof(saveimage_entry));
+
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) return 1;
+
+    bool ok = fwrite(&header, 1, sizeof(header), f) == sizeof(header);
+    if(ok) ok = fwrite(entries, 1, count * sizeof(saveimage_entry), f) == count * sizeof(saveimage_entry);
+    for(u32 i = 0; ok && i < count; i++) ok = fwrite(data[i], 1, entries[i].size, f) == entries[i].size;
+    if(fclose(f)) ok = false;
+
+    if(!ok)
+    {
+        remove(path);
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef _SAVEIMAGE_H_
+#define _SAVEIMAGE_H_
+
+#include <3ds.h>
+
+#include "arena.h"
+
+#define SAVEIMAGE_DIR "sdmc:/salt_sploit_installer/images"
+#define SAVEIMAGE_MAGIC "SALTIMG1"
+
+#define SAVEIMAGE_MAX_FILES 64
+#define SAVEIMAGE_PATH_SIZE 128
+
+// A prebaked install: every save file of one exploit, title, version, firmware and slot, exactly as the install
+// writes them. The header is followed by the entries, in write order, and then by the files' data.
+typedef struct {
+    char magic[8];
+    u32 count;
+    // of the exploit the image was rendered for, an install with other flags doesn't use it
+    u32 flags_bitmask;
+    u32 data_size;
+    // CRC-32C of the entries
+    u32 crc;
+} saveimage_header;
+
+typedef struct {
+    char path[SAVEIMAGE_PATH_SIZE];
+    // into the data
+    u32 offset;
+    u32 size;
+    // CRC-32C of the file, the same as in the manifest
+    u32 crc;
+} saveimage_entry;
+
+typedef struct {
+    saveimage_header header;
+    saveimage_entry* entries;
+    u8* data;
+} saveimage;
+
+// "{exploit}_{program id}_{version}_{firmware}_{slot}.img", the name of an install's image in SAVEIMAGE_DIR.
+void saveimage_name(const char* exploitname, u64 program_id, const char* displayversion, const char* firmware, const char* slot, char* out, size_t out_size);
+
+// Reads the whole image at path into memory from a. Returns 1 when it can't be opened, 4 when it isn't a valid
+// image, 5 when a is out of memory and 6 when it's short or a CRC doesn't match.
+Result saveimage_load(const char* path, arena* a, saveimage* out);
+// Writes count files as an image, entries only need their path and size, the offsets and CRCs are filled in.
+// Returns 1 when path can't be created and 2 when it can't be written.
+Result saveimage_write(const char* path, u32 flags_bitmask, saveimage_entry* entries, const void* const* data, u32 count);
+
+#endif // _SAVEIMAGE_H_
@@ -0,0 +1,551 @@
+#ifndef _3DS
+#define _XOPEN_SOURCE 700
+#endif
+
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _3DS
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include <3ds.h>
+
+#include "saveio.h"
+#include "install.h"
+#include "trace.h"
+
+static const char* const op_names[SAVEIO_OP_COUNT] = {
+    [SAVEIO_OPEN_ARCHIVE] = "open_archive",
+    [SAVEIO_CLOSE_ARCHIVE] = "close_archive",
+    [SAVEIO_OPEN] = "open",
+    [SAVEIO_READ] = "read",
+    [SAVEIO_WRITE] = "write",
+    [SAVEIO_GET_SIZE] = "get_size",
+    [SAVEIO_CLOSE] = "close",
+    [SAVEIO_REMOVE] = "remove",
+    [SAVEIO_CREATE] = "create",
+    [SAVEIO_LIST] = "list",
+    [SAVEIO_COMMIT] = "commit",
+    [SAVEIO_FORMAT] = "format",
+};
+
+// the title set with saveio_set_title(), 0 for the running title's own save
+static u64 save_title_id;
+static u8 save_title_media;
+
+void saveio_set_title(u64 program_id, u8 media_type)
+{
+    save_title_id = program_id;
+    save_title_media = media_type;
+}
+
+#ifdef _3DS
+
+// the game's save archive, through its own fs:USER session. The session is only used around the calls that
+// need it, so SD and romfs access in between (and in list() entries) keeps going through the default one.
+
+static FS_Archive save_archive;
+
+// The running title's own save, or the user save of the title set with saveio_set_title().
+static FS_ArchiveID save_archive_id(FS_Path* path)
+{
+    static u32 title_path[3];
+
+    if(save_title_id == 0)
+    {
+        *path = (FS_Path){PATH_EMPTY, 1, (u8*)""};
+        return ARCHIVE_SAVEDATA;
+    }
+
+    title_path[0] = save_title_media;
+    title_path[1] = (u32)save_title_id;
+    title_path[2] = (u32)(save_title_id >> 32);
+    *path = (FS_Path){PATH_BINARY, sizeof(title_path), (u8*)title_path};
+    return ARCHIVE_USER_SAVEDATA;
+}
+
+static Result fs_open_archive(void)
+{
+    FS_Path path;
+    FS_ArchiveID id = save_archive_id(&path);
+
+    fsUseSession(save_session);
+    Result ret = FSUSER_OpenArchive(&save_archive, id, path);
+    fsEndUseSession();
+    return ret;
+}
+
+static Result fs_close_archive(void)
+{
+    fsUseSession(save_session);
+    Result ret = FSUSER_CloseArchive(save_archive);
+    fsEndUseSession();
+    return ret;
+}
+
+static Result fs_open(Handle* file, const char* path, u32 flags)
+{
+    fsUseSession(save_session);
+    Result ret = FSUSER_OpenFile(file, save_archive, fsMakePath(PATH_ASCII, path), flags, 0);
+    fsEndUseSession();
+    return ret;
+}
+
+static Result fs_read(Handle file, u32* bytes_read, u64 offset, void* buffer, u32 size)
+{
+    return FSFILE_Read(file, bytes_read, offset, buffer, size);
+}
+
+static Result fs_write(Handle file, u32* bytes_written, u64 offset, const void* buffer, u32 size, u32 flags)
+{
+    return FSFILE_Write(file, bytes_written, offset, buffer, size, flags);
+}
+
+static Result fs_get_size(Handle file, u64* size)
+{
+    return FSFILE_GetSize(file, size);
+}
+
+static Result fs_close(Handle file)
+{
+    return FSFILE_Close(file);
+}
+
+static Result fs_remove(const char* path)
+{
+    fsUseSession(save_session);
+    Result ret = FSUSER_DeleteFile(save_archive, fsMakePath(PATH_ASCII, path));
+    fsEndUseSession();
+    return ret;
+}
+
+static Result fs_create(const char* path, u64 size)
+{
+    fsUseSession(save_session);
+    Result ret = FSUSER_CreateFile(save_archive, fsMakePath(PATH_ASCII, path), 0, size);
+    fsEndUseSession();
+    return ret;
+}
+
+static Result fs_list(const char* path, save_list_entry entry, void* arg)
+{
+    Handle dir;
+    fsUseSession(save_session);
+    Result ret = FSUSER_OpenDirectory(&dir, save_archive, fsMakePath(PATH_ASCII, path));
+    fsEndUseSession();
+    if(R_FAILED(ret)) return ret;
+
+    FS_DirectoryEntry dir_entry;
+    u32 entries_read = 0;
+    while(R_SUCCEEDED(ret = FSDIR_Read(dir, &entries_read, 1, &dir_entry)) && entries_read)
+    {
+        char name[256] = {0};
+        char entry_path[512];
+        utf16_to_utf8((u8*)name, dir_entry.name, sizeof(name) - 1);
+        snprintf(entry_path, sizeof(entry_path), "%s%s%s", path, path[strlen(path) - 1] == '/' ? "" : "/", name);
+
+        ret = entry(entry_path, (dir_entry.attributes & FS_ATTRIBUTE_DIRECTORY) != 0, dir_entry.fileSize, arg);
+        if(ret) break;
+    }
+
+    FSDIR_Close(dir);
+    return ret;
+}
+
+static Result fs_commit(void)
+{
+    fsUseSession(save_session);
+    Result ret = FSUSER_ControlArchive(save_archive, ARCHIVE_ACTION_COMMIT_SAVE_DATA, NULL, 0, NULL, 0);
+    fsEndUseSession();
+    return ret;
+}
+
+static Result fs_format(u32 blocks, u32 directories, u32 files, u32 directory_buckets, u32 file_buckets, bool duplicate_data)
+{
+    FS_Path path;
+    FS_ArchiveID id = save_archive_id(&path);
+
+    fsUseSession(save_session);
+    Result ret = FSUSER_FormatSaveData(id, path, blocks, directories, files, directory_buckets, file_buckets, duplicate_data);
+    fsEndUseSession();
+    return ret;
+}
+
+const save_backend save_backend_default = {
+    "fs", fs_open_archive, fs_close_archive, fs_open, fs_read, fs_write, fs_get_size, fs_close, fs_remove, fs_create, fs_list, fs_commit, fs_format
+};
+
+#else
+
+// a directory standing in for the save archive
+
+#define DIR_ERR_NOT_FOUND ((Result)0xC8804478)
+#define DIR_ERR_IO        ((Result)0xC8804464)
+
+static const char* save_root = "save";
+
+void saveio_set_root(const char* dir)
+{
+    save_root = dir;
+}
+
+// The root itself for the running title. Other titles get a directory next to it named after their program ID, which
+// formatting the running title's save leaves alone.
+static const char* dir_root(void)
+{
+    static char title_root[1024];
+
+    if(save_title_id == 0) return save_root;
+
+    snprintf(title_root, sizeof(title_root), "%s_%016llX", save_root, (unsigned long long)save_title_id);
+    return title_root;
+}
+
+static Result dir_open_archive(void)
+{
+    struct stat st;
+
+    // every installed title has a save archive, even one that was never written to
+    if(save_title_id) mkdir(dir_root(), 0777);
+
+    return stat(dir_root(), &st) == 0 && S_ISDIR(st.st_mode) ? 0 : DIR_ERR_NOT_FOUND;
+}
+
+static Result dir_close_archive(void)
+{
+    return 0;
+}
+
+static Result dir_open(Handle* file, const char* path, u32 flags)
+{
+    char buf[1024];
+    int mode = (flags & FS_OPEN_WRITE) ? O_RDWR : O_RDONLY;
+    if(flags & FS_OPEN_CREATE) mode |= O_CREAT;
+
+    snprintf(buf, sizeof(buf), "%s%s", dir_root(), path);
+    int fd = open(buf, mode, 0666);
+    if(fd < 0) return DIR_ERR_NOT_FOUND;
+
+    *file = fd + 1;
+    return 0;
+}
+
+static Result dir_read(Handle file, u32* bytes_read, u64 offset, void* buffer, u32 size)
+{
+    ssize_t ret = pread(file - 1, buffer, size, offset);
+    if(ret < 0) return DIR_ERR_IO;
+
+    *bytes_read = ret;
+    return 0;
+}
+
+static Result dir_write(Handle file, u32* bytes_written, u64 offset, const void* buffer, u32 size, u32 flags)
+{
+    ssize_t ret = pwrite(file - 1, buffer, size, offset);
+    if(ret < 0) return DIR_ERR_IO;
+
+    *bytes_written = ret;
+    return 0;
+}
+
+static Result dir_get_size(Handle file, u64* size)
+{
+    struct stat st;
+    if(fstat(file - 1, &st)) return DIR_ERR_IO;
+
+    *size = st.st_size;
+    return 0;
+}
+
+static Result dir_close(Handle file)
+{
+    return close(file - 1) ? DIR_ERR_IO : 0;
+}
+
+static Result dir_remove(const char* path)
+{
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%s%s", dir_root(), path);
+    return unlink(buf) ? DIR_ERR_NOT_FOUND : 0;
+}
+
+static Result dir_create(const char* path, u64 size)
+{
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%s%s", dir_root(), path);
+
+    int fd = open(buf, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if(fd < 0) return DIR_ERR_IO;
+
+    Result ret = ftruncate(fd, size) ? DIR_ERR_IO : 0;
+    close(fd);
+    return ret;
+}
+
+static Result dir_list(const char* path, save_list_entry entry, void* arg)
+{
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%s%s", dir_root(), path);
+
+    DIR* dir = opendir(buf);
+    if(dir == NULL) return DIR_ERR_NOT_FOUND;
+
+    Result ret = 0;
+    struct dirent* dir_entry;
+    while((dir_entry = readdir(dir)))
+    {
+        if(strcmp(dir_entry->d_name, ".") == 0 || strcmp(dir_entry->d_name, "..") == 0) continue;
+
+        char entry_path[512];
+        struct stat st;
+        snprintf(entry_path, sizeof(entry_path), "%s%s%s", path, path[strlen(path) - 1] == '/' ? "" : "/", dir_entry->d_name);
+        if(snprintf(buf, sizeof(buf), "%s%s", dir_root(), entry_path) >= (int)sizeof(buf) || stat(buf, &st))
+        {
+            ret = DIR_ERR_IO;
+            break;
+        }
+
+        ret = entry(entry_path, S_ISDIR(st.st_mode), S_ISDIR(st.st_mode) ? 0 : st.st_size, arg);
+        if(ret) break;
+    }
+
+    closedir(dir);
+    return ret;
+}
+
+static Result dir_commit(void)
+{
+    return 0;
+}
+
+static int dir_format_remove(const char* path, const struct stat* st, int type, struct FTW* ftw)
+{
+    // keep the archive's root
+    if(ftw->level == 0) return 0;
+    return type == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static Result dir_format(u32 blocks, u32 directories, u32 files, u32 directory_buckets, u32 file_buckets, bool duplicate_data)
+{
+    return nftw(dir_root(), dir_format_remove, 8, FTW_DEPTH | FTW_PHYS) ? DIR_ERR_IO : 0;
+}
+
+const save_backend save_backend_default = {
+    "directory", dir_open_archive, dir_close_archive, dir_open, dir_read, dir_write, dir_get_size, dir_close, dir_remove, dir_create, dir_list, dir_commit, dir_format
+};
+
+#endif
+
+// the instrumented wrapper
+
+static const save_backend* backend = &save_backend_default;
+static saveio_stats stats;
+// opens of the archive that haven't been closed yet, only the first and last reach the backend
+static int archive_refs;
+
+void saveio_set_backend(const save_backend* new_backend)
+{
+    backend = new_backend ? new_backend : &save_backend_default;
+}
+
+const save_backend* saveio_get_backend(void)
+{
+    return backend;
+}
+
+static void record(saveio_op op, u64 start, Result ret, u64 bytes)
+{
+    saveio_op_stats* s = &stats.ops[op];
+    u64 us = trace_ticks_to_us(trace_now() - start);
+
+    int bucket = 0;
+    while(bucket < SAVEIO_HISTOGRAM_BUCKETS - 1 && (us >> (bucket + 1))) bucket++;
+
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+    if(R_FAILED(ret)) __atomic_fetch_add(&s->errors, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->total_us, us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->histogram[bucket], 1, __ATOMIC_RELAXED);
+
+    u64 max = __atomic_load_n(&s->max_us, __ATOMIC_RELAXED);
+    while(us > max && !__atomic_compare_exchange_n(&s->max_us, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+Result saveio_open_archive(void)
+{
+    if(archive_refs++) return 0;
+
+    u64 start = trace_now();
+    Result ret = backend->open_archive();
+    record(SAVEIO_OPEN_ARCHIVE, start, ret, 0);
+    if(R_FAILED(ret)) archive_refs = 0;
+    return ret;
+}
+
+Result saveio_close_archive(void)
+{
+    if(archive_refs == 0 || --archive_refs) return 0;
+
+    u64 start = trace_now();
+    Result ret = backend->close_archive();
+    record(SAVEIO_CLOSE_ARCHIVE, start, ret, 0);
+    return ret;
+}
+
+Result saveio_open(Handle* file, const char* path, u32 flags)
+{
+    u64 start = trace_now();
+    Result ret = backend->open(file, path, flags);
+    record(SAVEIO_OPEN, start, ret, 0);
+    return ret;
+}
+
+Result saveio_read(Handle file, u32* bytes_read, u64 offset, void* buffer, u32 size)
+{
+    u64 start = trace_now();
+    *bytes_read = 0;
+    Result ret = backend->read(file, bytes_read, offset, buffer, size);
+    record(SAVEIO_READ, start, ret, *bytes_read);
+    return ret;
+}
+
+Result saveio_write(Handle file, u32* bytes_written, u64 offset, const void* buffer, u32 size, u32 flags)
+{
+    u64 start = trace_now();
+    *bytes_written = 0;
+    Result ret = backend->write(file, bytes_written, offset, buffer, size, flags);
+    record(SAVEIO_WRITE, start, ret, *bytes_written);
+    if(flags & FS_WRITE_FLUSH) __atomic_fetch_add(&stats.flushes, 1, __ATOMIC_RELAXED);
+    return ret;
+}
+
+Result saveio_get_size(Handle file, u64* size)
+{
+    u64 start = trace_now();
+    Result ret = backend->get_size(file, size);
+    record(SAVEIO_GET_SIZE, start, ret, 0);
+    return ret;
+}
+
+Result saveio_close(Handle file)
+{
+    u64 start = trace_now();
+    Result ret = backend->close(file);
+    record(SAVEIO_CLOSE, start, ret, 0);
+    return ret;
+}
+
+Result saveio_remove(const char* path)
+{
+    u64 start = trace_now();
+    Result ret = backend->remove(path);
+    record(SAVEIO_REMOVE, start, ret, 0);
+    return ret;
+}
+
+Result saveio_create(const char* path, u64 size)
+{
+    u64 start = trace_now();
+    Result ret = backend->create(path, size);
+    record(SAVEIO_CREATE, start, ret, size);
+    return ret;
+}
+
+typedef struct {
+    save_list_entry entry;
+    void* arg;
+    u64 entry_ticks;
+} timed_list;
+
+static Result timed_list_entry(const char* path, bool directory, u64 size, void* arg)
+{
+    timed_list* list = arg;
+
+    u64 start = trace_now();
+    Result ret = list->entry(path, directory, size, list->arg);
+    list->entry_ticks += trace_now() - start;
+    return ret;
+}
+
+Result saveio_list(const char* path, save_list_entry entry, void* arg)
+{
+    timed_list list = { entry, arg, 0 };
+
+    u64 start = trace_now();
+    Result ret = backend->list(path, timed_list_entry, &list);
+    // what the entries did is counted as their own operations
+    record(SAVEIO_LIST, start + list.entry_ticks, ret, 0);
+    return ret;
+}
+
+Result saveio_commit(void)
+{
+    u64 start = trace_now();
+    Result ret = backend->commit();
+    record(SAVEIO_COMMIT, start, ret, 0);
+    return ret;
+}
+
+Result saveio_format(u32 blocks, u32 directories, u32 files, u32 directory_buckets, u32 file_buckets, bool duplicate_data)
+{
+    u64 start = trace_now();
+    Result ret = backend->format(blocks, directories, files, directory_buckets, file_buckets, duplicate_data);
+    record(SAVEIO_FORMAT, start, ret, 0);
+    return ret;
+}
+
+void saveio_stats_get(saveio_stats* out)
+{
+    // not a snapshot across counters, which is fine for reporting
+    memcpy(out, &stats, sizeof(*out));
+}
+
+void saveio_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void saveio_stats_print(FILE* f)
+{
+    saveio_stats s;
+    saveio_stats_get(&s);
+
+    fprintf(f, "backend: %s, flushes: %lu\n", backend->name, (unsigned long)s.flushes);
+    fprintf(f, "%-14s %6s %6s %10s %9s %9s\n", "op", "count", "errors", "bytes", "total us", "max us");
+
+    for(int op = 0; op < SAVEIO_OP_COUNT; op++)
+    {
+        const saveio_op_stats* o = &s.ops[op];
+        if(o->count == 0) continue;
+
+        fprintf(f, "%-14s %6lu %6lu %10llu %9llu %9llu\n", op_names[op], (unsigned long)o->count, (unsigned long)o->errors,
+            (unsigned long long)o->bytes, (unsigned long long)o->total_us, (unsigned long long)o->max_us);
+
+        fprintf(f, "   ");
+        for(int bucket = 0; bucket < SAVEIO_HISTOGRAM_BUCKETS; bucket++)
+        {
+            if(o->histogram[bucket] == 0) continue;
+
+            // each bucket is labelled with its lower bound
+            unsigned long low = bucket ? 1UL << bucket : 0;
+            if(low >= 1000) fprintf(f, " %lums:%lu", low / 1000, (unsigned long)o->histogram[bucket]);
+            else fprintf(f, " %luus:%lu", low, (unsigned long)o->histogram[bucket]);
+        }
+        fprintf(f, "\n");
+    }
+}
+
+int saveio_stats_dump(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if(f == NULL) return 1;
+
+    saveio_stats_print(f);
+
+    return fclose(f) ? 2 : 0;
+}
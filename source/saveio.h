@@ -0,0 +1,104 @@
+#ifndef _SAVEIO_H_
+#define _SAVEIO_H_
+
+#include <stdio.h>
+
+#include <3ds.h>
+
+#define SAVEIO_DUMP_PATH "sdmc:/salt_sploit_installer/saveio.txt"
+
+// Latency buckets are powers of two in microseconds: bucket 0 is < 2us, bucket n is [2^n, 2^(n+1)) us,
+// and the last bucket holds everything slower.
+#define SAVEIO_HISTOGRAM_BUCKETS 22
+
+// Called by list() for every entry of a directory, path is the entry's full path in the archive.
+typedef Result (*save_list_entry)(const char* path, bool directory, u64 size, void* arg);
+
+// Where save data lives. On the 3DS this is the game's save archive through save_session,
+// elsewhere it's a directory (see saveio_set_root()).
+typedef struct {
+    const char* name;
+    Result (*open_archive)(void);
+    Result (*close_archive)(void);
+    Result (*open)(Handle* file, const char* path, u32 flags);
+    Result (*read)(Handle file, u32* bytes_read, u64 offset, void* buffer, u32 size);
+    Result (*write)(Handle file, u32* bytes_written, u64 offset, const void* buffer, u32 size, u32 flags);
+    Result (*get_size)(Handle file, u64* size);
+    Result (*close)(Handle file);
+    Result (*remove)(const char* path);
+    // creates a file of size zero-filled bytes, failing if it already exists
+    Result (*create)(const char* path, u64 size);
+    // calls entry for everything in the directory at path ("/" for the root), stopping at its first failure
+    Result (*list)(const char* path, save_list_entry entry, void* arg);
+    Result (*commit)(void);
+    Result (*format)(u32 blocks, u32 directories, u32 files, u32 directory_buckets, u32 file_buckets, bool duplicate_data);
+} save_backend;
+
+typedef enum
+{
+    SAVEIO_OPEN_ARCHIVE,
+    SAVEIO_CLOSE_ARCHIVE,
+    SAVEIO_OPEN,
+    SAVEIO_READ,
+    SAVEIO_WRITE,
+    SAVEIO_GET_SIZE,
+    SAVEIO_CLOSE,
+    SAVEIO_REMOVE,
+    SAVEIO_CREATE,
+    SAVEIO_LIST,
+    SAVEIO_COMMIT,
+    SAVEIO_FORMAT,
+    SAVEIO_OP_COUNT,
+} saveio_op;
+
+typedef struct {
+    u32 count;
+    u32 errors;
+    u64 bytes;
+    u64 total_us;
+    u64 max_us;
+    u32 histogram[SAVEIO_HISTOGRAM_BUCKETS];
+} saveio_op_stats;
+
+typedef struct {
+    saveio_op_stats ops[SAVEIO_OP_COUNT];
+    // writes made with FS_WRITE_FLUSH
+    u32 flushes;
+} saveio_stats;
+
+extern const save_backend save_backend_default;
+
+// Every call below goes to the current backend and is counted and timed on the way.
+void saveio_set_backend(const save_backend* backend);
+const save_backend* saveio_get_backend(void);
+#ifndef _3DS
+// The directory that stands in for the save archive, "save" by default.
+void saveio_set_root(const char* dir);
+#endif
+// Which title's save the archive calls go to: 0, the default, is the running title's own save. Other titles' saves
+// are ARCHIVE_USER_SAVEDATA, which only opens when the running title's access rights reach them. Elsewhere,
+// they're directories next to the root, "<root>_<program ID>".
+void saveio_set_title(u64 program_id, u8 media_type);
+
+// Opens nest: while the archive is open, further opens share it and it's closed by the last close.
+Result saveio_open_archive(void);
+Result saveio_close_archive(void);
+Result saveio_open(Handle* file, const char* path, u32 flags);
+Result saveio_read(Handle file, u32* bytes_read, u64 offset, void* buffer, u32 size);
+Result saveio_write(Handle file, u32* bytes_written, u64 offset, const void* buffer, u32 size, u32 flags);
+Result saveio_get_size(Handle file, u64* size);
+Result saveio_close(Handle file);
+Result saveio_remove(const char* path);
+Result saveio_create(const char* path, u64 size);
+// Only the listing itself is timed, not the time spent in entry.
+Result saveio_list(const char* path, save_list_entry entry, void* arg);
+Result saveio_commit(void);
+Result saveio_format(u32 blocks, u32 directories, u32 files, u32 directory_buckets, u32 file_buckets, bool duplicate_data);
+
+void saveio_stats_get(saveio_stats* out);
+void saveio_stats_reset(void);
+// Counts, bytes, times and the non-empty histogram buckets of every operation that was used.
+void saveio_stats_print(FILE* f);
+int saveio_stats_dump(const char* path);
+
+#endif // _SAVEIO_H_
@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "services.h"
+#include "crc32c.h"
+#include "install.h"
+#include "romfsio.h"
+
+static Result save_session_init(void)
+{
+    Result ret = srvGetServiceHandleDirect(&save_session, "fs:USER");
+    if(R_SUCCEEDED(ret)) ret = FSUSER_Initialize(save_session);
+    if(R_FAILED(ret) && save_session)
+    {
+        svcCloseHandle(save_session);
+        save_session = 0;
+    }
+
+    return ret;
+}
+
+static void save_session_exit(void)
+{
+    svcCloseHandle(save_session);
+    save_session = 0;
+}
+
+static Result httpc_init(void)
+{
+    return httpcInit(0);
+}
+
+static void romfs_exit(void)
+{
+    romfsExit();
+}
+
+static const struct {
+    u32 depends;
+    Result (*init)(void);
+    void (*exit)(void);
+} service_table[SERVICE_COUNT] = {
+    [SERVICE_FS] = { 0, fsInit, fsExit },
+    [SERVICE_SAVE_SESSION] = { 1 << SERVICE_FS, save_session_init, save_session_exit },
+    [SERVICE_HTTPC] = { 0, httpc_init, httpcExit },
+    [SERVICE_CFGU] = { 0, cfguInit, cfguExit },
+    [SERVICE_AM] = { 0, amInit, amExit },
+    [SERVICE_ROMFS] = { 1 << SERVICE_FS, romfsInit, romfs_exit },
+    [SERVICE_ROMFS_IMAGE] = { 1 << SERVICE_FS, romfsio_init, romfsio_exit },
+};
+
+static struct {
+    LightLock lock;
+    bool initialized;
+    Result result;
+} service_state[SERVICE_COUNT];
+
+static LightLock order_lock;
+static service_t init_order[SERVICE_COUNT];
+static int init_count;
+
+void services_init(void)
+{
+    // once here, so the install, provisioning and bench jobs never race to build the table
+    crc32c_init();
+
+    LightLock_Init(&order_lock);
+    for(int i = 0; i < SERVICE_COUNT; i++) LightLock_Init(&service_state[i].lock);
+}
+
+Result service_require(service_t service)
+{
+    Result ret = 0;
+
+    for(int i = 0; i < SERVICE_COUNT; i++)
+    {
+        if(!(service_table[service].depends & (1 << i))) continue;
+
+        ret = service_require(i);
+        if(R_FAILED(ret)) return ret;
+    }
+
+    LightLock_Lock(&service_state[service].lock);
+
+    if(!service_state[service].initialized)
+    {
+        ret = service_table[service].init();
+        if(R_SUCCEEDED(ret))
+        {
+            service_state[service].initialized = true;
+
+            LightLock_Lock(&order_lock);
+            init_order[init_count++] = service;
+            LightLock_Unlock(&order_lock);
+        }
+    }
+
+    LightLock_Unlock(&service_state[service].lock);
+
+    return ret;
+}
+
+bool service_initialized(service_t service)
+{
+    return service_state[service].initialized;
+}
+
+void services_exit(void)
+{
+    while(init_count > 0)
+    {
+        service_t service = init_order[--init_count];
+
+        service_table[service].exit();
+        service_state[service].initialized = false;
+    }
+}
+
+typedef struct {
+    service_task task;
+    void* arg;
+    Result result;
+} parallel_task;
+
+static void parallel_thread(void* arg)
+{
+    parallel_task* task = arg;
+    task->result = task->task(task->arg);
+}
+
+void services_run_parallel(const service_task* tasks, int count, void* arg, Result* results)
+{
+    parallel_task state[SERVICES_MAX_TASKS];
+    Thread threads[SERVICES_MAX_TASKS];
+    s32 prio = 0x30;
+
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    if(count > SERVICES_MAX_TASKS) count = SERVICES_MAX_TASKS;
+
+    for(int i = 0; i < count; i++)
+    {
+        state[i].task = tasks[i];
+        state[i].arg = arg;
+        state[i].result = 0;
+
+        threads[i] = threadCreate(parallel_thread, &state[i], 0x4000, prio, -2, false);
+        // run it here if no thread could be created
+        if(threads[i] == NULL) parallel_thread(&state[i]);
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        if(threads[i])
+        {
+            threadJoin(threads[i], U64_MAX);
+            threadFree(threads[i]);
+        }
+
+        results[i] = state[i].result;
+    }
+}
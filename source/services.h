@@ -0,0 +1,32 @@
+#ifndef _SERVICES_H_
+#define _SERVICES_H_
+
+#include <3ds.h>
+
+typedef enum
+{
+    SERVICE_FS,
+    SERVICE_SAVE_SESSION, // the game's own fs:USER session, in save_session
+    SERVICE_HTTPC,
+    SERVICE_CFGU,
+    SERVICE_AM,
+    SERVICE_ROMFS,
+    SERVICE_ROMFS_IMAGE, // direct reads of the RomFS image, see romfsio.h
+    SERVICE_COUNT,
+} service_t;
+
+typedef Result (*service_task)(void* arg);
+
+void services_init(void);
+// Initializes the service and its dependencies on first use. Safe to call from any thread.
+Result service_require(service_t service);
+bool service_initialized(service_t service);
+// Shuts down every initialized service, in reverse order of initialization.
+void services_exit(void);
+
+#define SERVICES_MAX_TASKS 8
+
+// Runs each task (up to SERVICES_MAX_TASKS) on its own thread and waits for all of them, results[i] is the result of tasks[i].
+void services_run_parallel(const service_task* tasks, int count, void* arg, Result* results);
+
+#endif // _SERVICES_H_
@@ -0,0 +1,25 @@
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <3ds.h>
+
+#define SHA256_HASH_SIZE 32
+
+typedef struct {
+    u32 state[8];
+    u64 length;
+    u8 block[64];
+    u32 block_len;
+} sha256_context;
+
+void sha256_init(sha256_context *ctx);
+void sha256_update(sha256_context *ctx, const void *data, size_t size);
+void sha256_final(sha256_context *ctx, u8 *hash);
+
+void sha256(const void *data, size_t size, u8 *hash);
+
+// hex is SHA256_HASH_SIZE*2+1 bytes. sha256_from_hex() returns 0 on success.
+void sha256_to_hex(const u8 *hash, char *hex);
+int sha256_from_hex(const char *hex, u8 *hash);
+
+#endif // _SHA256_H_
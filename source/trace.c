@@ -0,0 +1,176 @@
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _3DS
+#include <3ds.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+#include "trace.h"
+
+static trace_event trace_events[TRACE_MAX_EVENTS];
+static uint32_t trace_count;
+
+uint64_t trace_now(void)
+{
+#ifdef _3DS
+    return svcGetSystemTick();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+uint64_t trace_ticks_to_us(uint64_t ticks)
+{
+#ifdef _3DS
+    return ticks * 1000000ULL / SYSCLOCK_ARM11;
+#else
+    return ticks / 1000;
+#endif
+}
+
+static uint32_t trace_thread_id(void)
+{
+#ifdef _3DS
+    u32 id = 0;
+    svcGetThreadId(&id, CUR_THREAD_HANDLE);
+    return id;
+#else
+    return (uint32_t)(uintptr_t)pthread_self();
+#endif
+}
+
+int trace_begin(const char* name, const char* detail)
+{
+    uint32_t span = __atomic_fetch_add(&trace_count, 1, __ATOMIC_RELAXED);
+    if(span >= TRACE_MAX_EVENTS) return -1;
+
+    trace_event* event = &trace_events[span];
+    event->name = name;
+    event->detail[0] = 0;
+    if(detail) strncpy(event->detail, detail, sizeof(event->detail) - 1);
+    event->bytes = 0;
+    event->thread = trace_thread_id();
+    event->end = 0;
+    event->start = trace_now();
+
+    return span;
+}
+
+void trace_end(int span, uint64_t bytes)
+{
+    if(span < 0) return;
+
+    trace_events[span].bytes = bytes;
+    trace_events[span].end = trace_now();
+}
+
+static uint32_t trace_event_count(void)
+{
+    uint32_t count = __atomic_load_n(&trace_count, __ATOMIC_RELAXED);
+    return count > TRACE_MAX_EVENTS ? TRACE_MAX_EVENTS : count;
+}
+
+void trace_reset(void)
+{
+    __atomic_store_n(&trace_count, 0, __ATOMIC_RELAXED);
+}
+
+static uint32_t trace_total_from(uint32_t first, const char* name, uint64_t* ticks, uint64_t* bytes)
+{
+    uint32_t count = trace_event_count();
+    uint32_t calls = 0;
+
+    *ticks = 0;
+    if(bytes) *bytes = 0;
+
+    for(uint32_t i = first; i < count; i++)
+    {
+        if(!trace_events[i].end || strcmp(trace_events[i].name, name)) continue;
+
+        calls++;
+        *ticks += trace_events[i].end - trace_events[i].start;
+        if(bytes) *bytes += trace_events[i].bytes;
+    }
+
+    return calls;
+}
+
+uint32_t trace_total(const char* name, uint64_t* us, uint64_t* bytes)
+{
+    uint64_t ticks = 0;
+    uint32_t calls = trace_total_from(0, name, &ticks, bytes);
+
+    if(us) *us = trace_ticks_to_us(ticks);
+    return calls;
+}
+
+void trace_summary(char* out, size_t out_size)
+{
+    uint32_t count = trace_event_count();
+    size_t len = 0;
+
+    out[0] = 0;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        const char* name = trace_events[i].name;
+        uint32_t j;
+        uint64_t ticks = 0, bytes = 0;
+
+        if(!trace_events[i].end) continue;
+
+        // only summarize each name at its first occurrence
+        for(j = 0; j < i; j++)
+            if(trace_events[j].end && strcmp(trace_events[j].name, name) == 0) break;
+        if(j < i) continue;
+
+        uint32_t calls = trace_total_from(i, name, &ticks, &bytes);
+
+        int ret = snprintf(&out[len], out_size - len, "%-14s%3lu %6lu ms %6lu KB\n", name, (unsigned long)calls,
+            (unsigned long)(trace_ticks_to_us(ticks) / 1000), (unsigned long)(bytes / 1024));
+        if(ret < 0 || (size_t)ret >= out_size - len) break;
+        len += ret;
+    }
+}
+
+int trace_write_json(const char* path)
+{
+    uint32_t count = trace_event_count();
+    uint64_t origin = count ? trace_events[0].start : 0;
+
+    FILE* f = fopen(path, "w");
+    if(f == NULL) return 1;
+
+    for(uint32_t i = 0; i < count; i++)
+        if(trace_events[i].start < origin) origin = trace_events[i].start;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    for(uint32_t i = 0, written = 0; i < count; i++)
+    {
+        const trace_event* event = &trace_events[i];
+        if(!event->end) continue;
+
+        fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"install\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%llu,\"dur\":%llu,\"args\":{\"bytes\":%llu,\"detail\":\"",
+            written++ ? "," : "", event->name, (unsigned long)event->thread,
+            (unsigned long long)trace_ticks_to_us(event->start - origin), (unsigned long long)trace_ticks_to_us(event->end - event->start),
+            (unsigned long long)event->bytes);
+
+        for(const char* ptr = event->detail; *ptr; ptr++)
+        {
+            if(*ptr == '"' || *ptr == '\\') fputc('\\', f);
+            if((unsigned char)*ptr >= 0x20) fputc(*ptr, f);
+        }
+
+        fprintf(f, "\"}}");
+    }
+
+    fprintf(f, "\n]}\n");
+
+    return fclose(f) ? 2 : 0;
+}
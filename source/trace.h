@@ -0,0 +1,38 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRACE_MAX_EVENTS 512
+#define TRACE_PATH "sdmc:/salt_sploit_installer/trace.json"
+
+// Spans are timed with svcGetSystemTick() on the 3DS and CLOCK_MONOTONIC elsewhere,
+// and can be recorded from any thread.
+typedef struct {
+    const char* name;
+    char detail[64];
+    uint64_t start;
+    uint64_t end;
+    uint64_t bytes;
+    uint32_t thread;
+} trace_event;
+
+uint64_t trace_now(void);
+uint64_t trace_ticks_to_us(uint64_t ticks);
+
+// name must be a string literal (or otherwise outlive the trace), detail is copied and may be NULL.
+// Returns the span to pass to trace_end(), or -1 when the trace is full.
+int trace_begin(const char* name, const char* detail);
+void trace_end(int span, uint64_t bytes);
+
+// Drops every recorded span. Only call this while nothing is being traced.
+void trace_reset(void);
+// Total time and bytes of the finished spans called name. Returns how many there were; us and bytes may be NULL.
+uint32_t trace_total(const char* name, uint64_t* us, uint64_t* bytes);
+// Per-name totals, one line each: "name count time bytes".
+void trace_summary(char* out, size_t out_size);
+// Chrome trace-event JSON, which chrome://tracing and Perfetto can load.
+int trace_write_json(const char* path);
+
+#endif // _TRACE_H_
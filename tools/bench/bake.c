@@ -0,0 +1,400 @@
+// Renders prebaked save images (see source/saveimage.h) for every exploit, title and version in romfs/, for
+// every firmware there's a payload for and every slot asked for. Each image is an offline install by the same
+// pipeline as the bench, into an empty save of its own, packed in the order the install wrote its files. The
+// renders don't share anything, so each one is a process of its own, as many at once as there are CPUs.
+//
+// payloads/{firmware}.bin is the uncompressed payload of a firmware, for example payloads/NEW-11-0-35-32-USA.bin.
+// The images are named the way the installer looks for them: copy the output directory to SAVEIMAGE_DIR.
+//
+//   bake_images --payloads dir --out dir [--romfs dir] [--work dir] [--slots 1,2,3,all] [--jobs n] [--exploit name]
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+
+#include <3ds.h>
+
+#include "install.h"
+#include "jobs.h"
+#include "saveimage.h"
+#include "saveio.h"
+#include "services.h"
+#include "trace.h"
+
+#define BAKE_MAX_TARGETS 4096
+#define BAKE_MAX_FIRMWARES 64
+
+typedef struct {
+    char exploitname[64];
+    u64 program_id;
+    int version;
+    int firmware;
+    // -1 for every slot
+    int slot;
+} bake_target;
+
+typedef struct {
+    char name[32];
+    int version[6];
+} bake_firmware;
+
+static bake_target targets[BAKE_MAX_TARGETS];
+static int target_count;
+static bake_firmware firmwares[BAKE_MAX_FIRMWARES];
+static int firmware_count;
+
+static const char* romfs = "romfs";
+static const char* payloads;
+static const char* out;
+static const char* work = "bake_work";
+static const char* only_exploit;
+static int slots[SAVE_SLOT_COUNT + 1] = { 0, 1, 2 };
+static int slot_count = 3;
+
+static u64 now_us(void)
+{
+    return trace_ticks_to_us(trace_now());
+}
+
+// Parses "NEW-11-0-35-32-USA" the same way as a headless run. Returns 1 when it isn't a firmware.
+static int parse_firmware(const char* name, int* fw)
+{
+    char model[4], region[4];
+
+    if(sscanf(name, "%3[A-Z]-%d-%d-%d-%d-%3s", model, &fw[1], &fw[2], &fw[3], &fw[4], region) != 6) return 1;
+
+    if(strcmp(model, "NEW") == 0) fw[0] = 1;
+    else if(strcmp(model, "OLD") == 0) fw[0] = 0;
+    else return 1;
+
+    for(fw[5] = 0; fw[5] < 7; fw[5]++)
+        if(strcmp(regions[fw[5]], region) == 0) return 0;
+
+    return 1;
+}
+
+// Every {firmware}.bin in the payload directory.
+static int find_firmwares(void)
+{
+    DIR* dir = opendir(payloads);
+    if(dir == NULL) return 1;
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) && firmware_count < BAKE_MAX_FIRMWARES)
+    {
+        bake_firmware* firmware = &firmwares[firmware_count];
+        size_t length = strlen(entry->d_name);
+        if(length < 5 || length - 4 >= sizeof(firmware->name) || strcmp(&entry->d_name[length - 4], ".bin")) continue;
+
+        memcpy(firmware->name, entry->d_name, length - 4);
+        firmware->name[length - 4] = 0;
+        if(parse_firmware(firmware->name, firmware->version) == 0) firmware_count++;
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+static void add_target(const char* exploitname, u64 program_id, int version, int firmware, int slot)
+{
+    if(target_count == BAKE_MAX_TARGETS) return;
+
+    bake_target* t = &targets[target_count++];
+    snprintf(t->exploitname, sizeof(t->exploitname), "%s", exploitname);
+    t->program_id = program_id;
+    t->version = version;
+    t->firmware = firmware;
+    t->slot = slot;
+}
+
+// Every title listed in exploitlist_config with each of its versions, for every firmware and slot.
+static int find_targets(void)
+{
+    char line[256];
+    FILE* f = fopen("romfs:/exploitlist_config", "r");
+    if(f == NULL) return 1;
+
+    while(fgets(line, sizeof(line) - 1, f))
+    {
+        remove_newline(line);
+
+        char exploitname[64] = {0};
+        u64 program_ids[16];
+        int program_id_count = 0;
+        unsigned long flags_bitmask = 0;
+
+        char* strptr = strtok(line, " ");
+        if(strptr == NULL || strtok(NULL, " ") == NULL || (strptr = strtok(NULL, " ")) == NULL) continue;
+        sscanf(strptr, "0x%lx", &flags_bitmask);
+        if(snprintf(exploitname, sizeof(exploitname), "%s", line) >= (int)sizeof(exploitname)) continue;
+        if(only_exploit && strcmp(exploitname, only_exploit)) continue;
+
+        // collected first, load_exploitversion() uses strtok() too
+        while((strptr = strtok(NULL, " ")) && program_id_count < 16)
+        {
+            unsigned long long program_id = 0;
+            sscanf(strptr, "%016llx", &program_id);
+            if(program_id) program_ids[program_id_count++] = program_id;
+        }
+
+        for(int i = 0; i < program_id_count; i++)
+        {
+            u64 program_id = program_ids[i];
+            u32 remaster = 0;
+            char displayversion[64] = {0};
+
+            for(int version = 0; load_exploitversion(exploitname, &program_id, version, &remaster, displayversion) == 0; version++)
+            {
+                for(int firmware = 0; firmware < firmware_count; firmware++)
+                {
+                    // exploits that select a firmware have no slots, the installer always installs them as slot 1
+                    if(flags_bitmask & 0x10) add_target(exploitname, program_id, version, firmware, 0);
+                    else for(int s = 0; s < slot_count; s++) add_target(exploitname, program_id, version, firmware, slots[s]);
+                }
+            }
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static int parse_slots(const char* list)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", list);
+
+    slot_count = 0;
+    for(char* slot = strtok(buf, ","); slot; slot = strtok(NULL, ","))
+    {
+        int value = strcmp(slot, "all") == 0 ? -1 : atoi(slot) - 1;
+        if(value >= SAVE_SLOT_COUNT || (value < 0 && strcmp(slot, "all")) || slot_count == SAVE_SLOT_COUNT + 1) return 1;
+
+        slots[slot_count++] = value;
+    }
+
+    return slot_count == 0;
+}
+
+static int copy_file(const char* from, const char* to)
+{
+    static u8 buffer[0x10000];
+    size_t size;
+    int ret = 0;
+
+    FILE* in = fopen(from, "rb");
+    FILE* f = fopen(to, "wb");
+    if(in == NULL || f == NULL) ret = 1;
+
+    while(ret == 0 && (size = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        if(fwrite(buffer, 1, size, f) != size) ret = 1;
+
+    if(in) fclose(in);
+    if(f && fclose(f)) ret = 1;
+    return ret;
+}
+
+// Reads back every file the install wrote, in the order of its manifest, and writes them as an image.
+static int pack(install_context* ctx, const char* path, u32* file_count, u32* data_size)
+{
+    static saveimage_entry entries[SAVEIMAGE_MAX_FILES];
+    static const void* data[SAVEIMAGE_MAX_FILES];
+    char line[512];
+    u32 count = 0;
+
+    FILE* f = fopen(INSTALL_MANIFEST_PATH, "r");
+    if(f == NULL) return 1;
+
+    // the first line describes the install
+    fgets(line, sizeof(line), f);
+    memset(entries, 0, sizeof(entries));
+    while(fgets(line, sizeof(line), f))
+    {
+        char file[SAVEIMAGE_PATH_SIZE];
+        if(sscanf(line, "%127s size=", file) != 1) continue;
+        if(count == SAVEIMAGE_MAX_FILES)
+        {
+            fclose(f);
+            return 5;
+        }
+
+        void* buffer = NULL;
+        size_t size = 0;
+        if(read_savedata(file, &buffer, &size))
+        {
+            fclose(f);
+            return 6;
+        }
+
+        snprintf(entries[count].path, sizeof(entries[count].path), "%s", file);
+        entries[count].size = size;
+        data[count++] = buffer;
+        *data_size += size;
+    }
+    fclose(f);
+
+    *file_count = count;
+    return count ? saveimage_write(path, ctx->flags_bitmask, entries, data, count) : 3;
+}
+
+// Renders one image, in a process of its own: every render has its own SD card and save directories.
+static int render(int index)
+{
+    static install_context ctx;
+    const bake_target* t = &targets[index];
+    const bake_firmware* firmware = &firmwares[t->firmware];
+    char sdmc[512], save[512], path[1600], slot[12], name[256];
+
+    snprintf(sdmc, sizeof(sdmc), "%s/%d/sdmc", work, index);
+    snprintf(save, sizeof(save), "%s/%d/save", work, index);
+    snprintf(path, sizeof(path), "rm -rf '%s/%d' && mkdir -p '%s/salt_sploit_installer' '%s'", work, index, sdmc, save);
+    if(system(path)) return 2;
+
+    ctru_host_configure(romfs, sdmc);
+    saveio_set_root(save);
+    status_init();
+    services_init();
+    jobs_init();
+
+    char from[1024];
+    snprintf(from, sizeof(from), "%s/%s.bin", payloads, firmware->name);
+    snprintf(path, sizeof(path), "sdmc:/salt_sploit_installer/%s.bin", firmware->name);
+    if(copy_file(from, path))
+    {
+        fprintf(stderr, "Failed to copy %s.\n", from);
+        return 2;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.program_id = t->program_id;
+    Result ret = load_exploitlist_config("romfs:/exploitlist_config", &ctx.program_id, ctx.exploitname, ctx.titlename, &ctx.flags_bitmask);
+    if(ret == 0) ret = load_exploitversion(ctx.exploitname, &ctx.program_id, t->version, &ctx.selected_remaster, ctx.displayversion);
+    if(ret == 0 && strcmp(ctx.exploitname, t->exploitname)) ret = 3;
+    if(ret)
+    {
+        fprintf(stderr, "Failed to load the config for %s/%016llx version %d.\n", t->exploitname, (unsigned long long)t->program_id, t->version);
+        return 1;
+    }
+
+    memcpy(ctx.firmware_version, firmware->version, sizeof(ctx.firmware_version));
+    ctx.all_slots = t->slot < 0;
+    ctx.selected_slot = t->slot < 0 ? 0 : t->slot;
+    ctx.offline = true;
+
+    u64 start = now_us();
+    ret = install_start(&ctx, 0);
+    if(R_SUCCEEDED(ret))
+    {
+        state_t state;
+        while((state = install_poll(&ctx)) != STATE_INSTALLED_PAYLOAD && state != STATE_ERROR) usleep(200);
+        ret = ctx.result;
+    }
+
+    // named after the version the install resolved, like the installer does
+    format_slot(t->slot, slot, sizeof(slot));
+    saveimage_name(ctx.exploitname, ctx.program_id, ctx.displayversion, firmware->name, slot, name, sizeof(name));
+    if(ret)
+    {
+        char text[STATUS_SIZE];
+        status_get(text, sizeof(text));
+        fprintf(stderr, "%s: install failed with %08lX: %s\n", name, (unsigned long)(u32)ret, text);
+        return 1;
+    }
+
+    u32 file_count = 0, data_size = 0;
+    snprintf(path, sizeof(path), "%s/%s", out, name);
+    ret = pack(&ctx, path, &file_count, &data_size);
+    if(ret)
+    {
+        fprintf(stderr, "%s: packing failed with %ld.\n", name, (long)ret);
+        return 1;
+    }
+
+    jobs_exit();
+    arena_free(&install_arena);
+    services_exit();
+
+    snprintf(path, sizeof(path), "rm -rf '%s/%d'", work, index);
+    system(path);
+
+    printf("%-72s %3lu file(s) %7.1f KB %7.1f ms\n", name, (unsigned long)file_count, data_size / 1024.0, (now_us() - start) / 1000.0);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for(int i = 1; i + 1 < argc; i++)
+    {
+        if(strcmp(argv[i], "--payloads") == 0) payloads = argv[++i];
+        else if(strcmp(argv[i], "--out") == 0) out = argv[++i];
+        else if(strcmp(argv[i], "--romfs") == 0) romfs = argv[++i];
+        else if(strcmp(argv[i], "--work") == 0) work = argv[++i];
+        else if(strcmp(argv[i], "--jobs") == 0) jobs = atol(argv[++i]);
+        else if(strcmp(argv[i], "--exploit") == 0) only_exploit = argv[++i];
+        else if(strcmp(argv[i], "--slots") == 0 && parse_slots(argv[++i]))
+        {
+            fprintf(stderr, "Slots are 1 to 3 or \"all\", separated by commas.\n");
+            return 2;
+        }
+    }
+
+    if(payloads == NULL || out == NULL)
+    {
+        fprintf(stderr, "usage: bake_images --payloads dir --out dir [--romfs dir] [--work dir] [--slots 1,2,3,all] [--jobs n] [--exploit name]\n");
+        return 2;
+    }
+    if(jobs < 1) jobs = 1;
+
+    char command[1024];
+    snprintf(command, sizeof(command), "mkdir -p '%s' '%s'", out, work);
+    if(system(command)) return 2;
+
+    ctru_host_configure(romfs, work);
+    if(find_firmwares() || firmware_count == 0)
+    {
+        fprintf(stderr, "No {firmware}.bin payloads in %s.\n", payloads);
+        return 2;
+    }
+    if(find_targets() || target_count == 0)
+    {
+        fprintf(stderr, "Nothing to render from %s/exploitlist_config.\n", romfs);
+        return 2;
+    }
+
+    // the children inherit whatever is still buffered
+    fflush(stdout);
+
+    u64 start = now_us();
+    int running = 0, failures = 0;
+    for(int next = 0; next < target_count || running > 0; )
+    {
+        if(next < target_count && running < jobs)
+        {
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                int ret = render(next);
+                fflush(stdout);
+                _exit(ret);
+            }
+            if(pid < 0) failures++;
+            else running++;
+            next++;
+            continue;
+        }
+
+        int child_status = 0;
+        if(wait(&child_status) < 0) break;
+        running--;
+        if(!WIFEXITED(child_status) || WEXITSTATUS(child_status)) failures++;
+    }
+
+    u64 us = now_us() - start;
+    printf("%d image(s) in %.2f s with %ld job(s), %.1f images/s, %d failure(s)\n", target_count - failures, us / 1000000.0, jobs, us ? (target_count - failures) * 1000000.0 / us : 0.0, failures);
+    return failures ? 1 : 0;
+}
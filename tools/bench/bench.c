@@ -0,0 +1,631 @@
+// Runs the full install pipeline for every exploit/title/version/model in romfs/,
+// against a directory-backed save archive and tools/payload_server.py, and checks
+// the results against stored thresholds.
+//
+// --verify reads every save file back and checks it against the install's manifest, which
+// adds reads, so the thresholds aren't checked then. --backup does the same for backing up
+// the save before each install (which then starts from the previous run's save instead of an
+// empty one) and restoring the backup afterwards.
+//
+// --fleet benchmarks provisioning instead: every title is installed on one console at once, each to its own save,
+// against installing the same titles one by one, for each model.
+//
+// --server can be given up to MIRRORS_MAX times, each one a line of server.txt ("{url} [{connect_ms} [{first_byte_ms}]]")
+// that the install races. The download times are the race's then, so the thresholds aren't checked, but --deadline
+// fails every run whose download took longer. --pin pins the payload's sha256 in hashes.txt.
+//
+// --dry-run has every install write its plan first (see source/plan.h) and fails the runs whose save calls don't
+// match the plan's estimate of them. It can't be combined with --backup, whose calls the plan doesn't cover.
+//
+//   bench --server http://127.0.0.1:8123 --work bench_work [--romfs dir] [--thresholds file] [--repeat n] [--update] [--dump] [--verify] [--backup] [--fleet]
+//         [--pin] [--deadline ms] [--dry-run]
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <3ds.h>
+
+#include "backup.h"
+#include "fleet.h"
+#include "install.h"
+#include "jobs.h"
+#include "mirrors.h"
+#include "saveio.h"
+#include "services.h"
+#include "trace.h"
+
+#define BENCH_MAX_CASES 64
+#define BENCH_MAX_THRESHOLDS 512
+#define BENCH_PAYLOAD_SIZE 0x10000
+
+typedef struct {
+    char name[128];
+    char exploitname[64];
+    u64 program_id;
+    int version;
+    int model;
+} bench_case;
+
+typedef struct {
+    Result ret;
+    u64 stage_us[8];
+    u64 total_us;
+    u64 restore_us;
+    saveio_stats io;
+    u64 peak;
+    // what the dry run estimated, with --dry-run
+    plan_cost estimate;
+} bench_result;
+
+typedef struct {
+    char name[128];
+    char metric[32];
+    u64 limit;
+} bench_threshold;
+
+static const char* const metric_names[] = { "total_ms", "bytes_read", "bytes_written", "commits", "peak_kb" };
+#define METRIC_COUNT (int)(sizeof(metric_names) / sizeof(metric_names[0]))
+
+static bench_case cases[BENCH_MAX_CASES];
+static int case_count;
+static bool verify;
+static bool backup;
+static bool pin;
+static bool dry_run;
+static int repeat = 3;
+
+static bench_threshold thresholds[BENCH_MAX_THRESHOLDS];
+static int threshold_count;
+
+static u64 metric_value(const bench_result* r, int metric)
+{
+    switch(metric)
+    {
+        case 0: return r->total_us / 1000;
+        case 1: return r->io.ops[SAVEIO_READ].bytes;
+        case 2: return r->io.ops[SAVEIO_WRITE].bytes;
+        case 3: return r->io.ops[SAVEIO_COMMIT].count;
+        default: return r->peak / 1024;
+    }
+}
+
+// Every title listed in exploitlist_config, with each of its versions, for Old3DS and New3DS.
+static int find_cases(void)
+{
+    char line[256];
+    FILE* f = fopen("romfs:/exploitlist_config", "r");
+    if(f == NULL) return 1;
+
+    while(fgets(line, sizeof(line) - 1, f))
+    {
+        remove_newline(line);
+
+        char exploitname[64] = {0};
+        u64 program_ids[16];
+        int program_id_count = 0;
+
+        char* strptr = strtok(line, " ");
+        if(strptr == NULL || strtok(NULL, " ") == NULL || strtok(NULL, " ") == NULL) continue;
+        strncpy(exploitname, strptr, sizeof(exploitname) - 1);
+
+        // collected first, load_exploitversion() uses strtok() too
+        while((strptr = strtok(NULL, " ")) && program_id_count < 16)
+        {
+            unsigned long long program_id = 0;
+            sscanf(strptr, "%016llx", &program_id);
+            if(program_id) program_ids[program_id_count++] = program_id;
+        }
+
+        for(int i = 0; i < program_id_count; i++)
+        {
+            u64 program_id = program_ids[i];
+
+            u32 remaster = 0;
+            char displayversion[64] = {0};
+            for(int version = 0; load_exploitversion(exploitname, &program_id, version, &remaster, displayversion) == 0; version++)
+            {
+                for(int model = 0; model < 2 && case_count < BENCH_MAX_CASES; model++)
+                {
+                    bench_case* c = &cases[case_count++];
+                    snprintf(c->name, sizeof(c->name), "%s/%016llx/%s/%s", exploitname, (unsigned long long)program_id, displayversion, model ? "New3DS" : "Old3DS");
+                    snprintf(c->exploitname, sizeof(c->exploitname), "%s", exploitname);
+                    c->program_id = program_id;
+                    c->version = version;
+                    c->model = model;
+                }
+            }
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// A deterministic payload, mostly made of similar ARM instructions like real code.
+static int write_payload(const char* work, const int* firmware_version)
+{
+    char firmware[32], path[512];
+    static u8 payload[BENCH_PAYLOAD_SIZE];
+    u32 seed = 0x5A17;
+
+    for(u32 i = 0; i < sizeof(payload); i += 4)
+    {
+        seed = seed * 1103515245 + 12345;
+        u32 word = (seed >> 16) & 0x3 ? 0xE1A00000 | ((seed >> 8) & 0xFF) : seed;
+        memcpy(&payload[i], &word, 4);
+    }
+
+    format_firmware(firmware_version, firmware, sizeof(firmware));
+    snprintf(path, sizeof(path), "mkdir -p '%s/payloads/%s'", work, firmware);
+    if(system(path)) return 1;
+
+    snprintf(path, sizeof(path), "%s/payloads/%s/otherapp.bin", work, firmware);
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) return 1;
+
+    size_t written = fwrite(payload, 1, sizeof(payload), f);
+    fclose(f);
+    if(written != sizeof(payload)) return 1;
+    if(!pin) return 0;
+
+    u8 hash[SHA256_HASH_SIZE];
+    char hex[SHA256_HASH_SIZE*2 + 1];
+    sha256(payload, sizeof(payload), hash);
+    sha256_to_hex(hash, hex);
+
+    f = fopen("sdmc:/salt_sploit_installer/hashes.txt", "a");
+    if(f == NULL) return 1;
+    fprintf(f, "%s %s\n", firmware, hex);
+    return fclose(f);
+}
+
+// The save calls the plan's estimate line has, in its order.
+#define ESTIMATED_OPS 7
+static const saveio_op estimated_ops[ESTIMATED_OPS] = { SAVEIO_OPEN_ARCHIVE, SAVEIO_OPEN, SAVEIO_WRITE, SAVEIO_REMOVE, SAVEIO_CREATE, SAVEIO_COMMIT, SAVEIO_READ };
+static const char* const estimated_names[ESTIMATED_OPS] = { "archive open", "open", "write", "remove", "create", "commit", "read" };
+
+static Result wait_install(install_context* ctx)
+{
+    state_t state;
+    while((state = install_poll(ctx)) != STATE_INSTALLED_PAYLOAD && state != STATE_ERROR) usleep(200);
+    return ctx->result;
+}
+
+// The save calls of the estimate line that source/plan.c's plan_print() ends PLAN_PATH with.
+static Result read_estimate(plan_cost* out)
+{
+    char line[512];
+    unsigned long long romfs_bytes = 0, written = 0, ms = 0;
+    unsigned long calls = 0, ops[ESTIMATED_OPS] = { 0 };
+    bool found = false;
+
+    memset(out, 0, sizeof(*out));
+
+    FILE* f = fopen(PLAN_PATH, "r");
+    if(f == NULL) return 1;
+    while(!found && fgets(line, sizeof(line), f))
+    {
+        found = sscanf(line, "estimate romfs_read=%llu written=%llu save_calls=%lu archive_opens=%lu opens=%lu writes=%lu removes=%lu creates=%lu commits=%lu reads=%lu time_ms=%llu",
+            &romfs_bytes, &written, &calls, &ops[0], &ops[1], &ops[2], &ops[3], &ops[4], &ops[5], &ops[6], &ms) == 11;
+    }
+    fclose(f);
+    if(!found) return 4;
+
+    for(int i = 0; i < ESTIMATED_OPS; i++) out->ops[estimated_ops[i]] = ops[i];
+    out->bytes[SAVEIO_WRITE] = written;
+    out->romfs_bytes = romfs_bytes;
+    out->us = ms * 1000;
+    return 0;
+}
+
+static Result run_case(const bench_case* c, const int* firmware_version, bench_result* r)
+{
+    static install_context ctx;
+    char firmware[32], path[256];
+
+    memset(&ctx, 0, sizeof(ctx));
+    memset(r, 0, sizeof(*r));
+
+    ctx.program_id = c->program_id;
+    Result ret = load_exploitlist_config("romfs:/exploitlist_config", &ctx.program_id, ctx.exploitname, ctx.titlename, &ctx.flags_bitmask);
+    if(ret == 0) ret = load_exploitversion(ctx.exploitname, &ctx.program_id, c->version, &ctx.selected_remaster, ctx.displayversion);
+    if(ret)
+    {
+        status_set("Failed to load the config for %s.", c->name);
+        return ret;
+    }
+
+    memcpy(ctx.firmware_version, firmware_version, sizeof(ctx.firmware_version));
+    ctx.firmware_version[0] = c->model;
+    ctx.verify = verify;
+    ctx.backup = backup;
+
+    // every run starts from an empty save, unless there's one to back up, and downloads the full payload
+    format_firmware(ctx.firmware_version, firmware, sizeof(firmware));
+    snprintf(path, sizeof(path), "sdmc:/salt_sploit_installer/%s.bin", firmware);
+    remove(path);
+    if(!backup) saveio_format(0x200, 10, 10, 11, 11, true);
+
+    // the plan of the install below, from the same save
+    if(dry_run)
+    {
+        ctx.dry_run = true;
+        remove(PLAN_PATH);
+        ret = install_start(&ctx, 0);
+        if(R_SUCCEEDED(ret)) ret = wait_install(&ctx);
+        if(ret == 0) ret = read_estimate(&r->estimate);
+        if(ret)
+        {
+            r->ret = ret;
+            return ret;
+        }
+
+        ctx.dry_run = false;
+        remove(path);
+    }
+
+    trace_reset();
+    saveio_stats_reset();
+
+    u64 start = trace_now();
+    ret = install_start(&ctx, 0);
+    if(R_FAILED(ret)) return ret;
+
+    wait_install(&ctx);
+    r->total_us = trace_ticks_to_us(trace_now() - start);
+
+    for(int i = 0; i < install_stage_count; i++) trace_total(install_stages[i].name, &r->stage_us[i], NULL);
+    saveio_stats_get(&r->io);
+    r->peak = install_arena.peak;
+    r->ret = ctx.result;
+
+    if(backup && r->ret == 0)
+    {
+        backup_path(ctx.program_id, path, sizeof(path));
+
+        start = trace_now();
+        r->ret = backup_restore(path, -1);
+        r->restore_us = trace_ticks_to_us(trace_now() - start);
+    }
+
+    return r->ret;
+}
+
+// Installs to every title of provision at once, from empty saves, and returns how long that took.
+static u64 run_fleet_once(fleet* provision, const int* firmware_version)
+{
+    static install_context ctx;
+    char firmware[32], path[256];
+
+    memset(&ctx, 0, sizeof(ctx));
+    memcpy(ctx.firmware_version, firmware_version, sizeof(ctx.firmware_version));
+    ctx.verify = verify;
+    ctx.backup = backup;
+
+    format_firmware(ctx.firmware_version, firmware, sizeof(firmware));
+    snprintf(path, sizeof(path), "sdmc:/salt_sploit_installer/%s.bin", firmware);
+    remove(path);
+    remove(FLEET_RESULT_PATH);
+    for(int i = 0; i < provision->count && !backup; i++)
+    {
+        saveio_set_title(provision->titles[i].program_id, provision->titles[i].media_type);
+        if(R_SUCCEEDED(saveio_open_archive())) saveio_close_archive();
+        saveio_format(0x200, 10, 10, 11, 11, true);
+    }
+    saveio_set_title(0, 0);
+
+    trace_reset();
+    saveio_stats_reset();
+
+    u64 start = trace_now();
+    if(R_FAILED(fleet_start(provision, &ctx))) return 0;
+
+    state_t state;
+    while((state = install_poll(&ctx)) != STATE_INSTALLED_PAYLOAD && state != STATE_ERROR) usleep(200);
+    return trace_ticks_to_us(trace_now() - start);
+}
+
+// The first version of every title installed one by one, then all of them provisioned at once, for each model.
+static int run_fleet(int* firmware_version)
+{
+    static u64 program_ids[BENCH_MAX_CASES];
+    static fleet provision;
+    u32 title_count = 0;
+    int failures = 0;
+
+    for(int i = 0; i < case_count; i++)
+        if(cases[i].version == 0 && cases[i].model == 0) program_ids[title_count++] = cases[i].program_id;
+    ctru_host_set_titles(program_ids, title_count);
+
+    if(fleet_scan("romfs:/exploitlist_config", &provision) || provision.count == 0)
+    {
+        printf("  FAIL: no titles to provision\n");
+        return 1;
+    }
+
+    printf("%-10s %6s %13s %10s %8s %10s %9s\n", "console", "titles", "one by one", "fleet", "speedup", "titles/s", "written");
+
+    for(int model = 0; model < 2; model++)
+    {
+        firmware_version[0] = model;
+
+        u64 sequential_us = 0;
+        for(int i = 0; i < case_count; i++)
+        {
+            if(cases[i].version || cases[i].model != model) continue;
+
+            u64 best_us = 0;
+            for(int n = 0; n < repeat; n++)
+            {
+                bench_result r;
+                if(run_case(&cases[i], firmware_version, &r))
+                {
+                    char text[STATUS_SIZE];
+                    status_get(text, sizeof(text));
+                    printf("  FAIL: %s returned %08lX: %s\n", cases[i].name, (unsigned long)(u32)r.ret, text);
+                    failures++;
+                    break;
+                }
+                if(n == 0 || r.total_us < best_us) best_us = r.total_us;
+            }
+            sequential_us += best_us;
+        }
+
+        u64 fleet_us = 0;
+        saveio_stats io;
+        for(int n = 0; n < repeat; n++)
+        {
+            u64 us = run_fleet_once(&provision, firmware_version);
+            if(n == 0 || us < fleet_us)
+            {
+                fleet_us = us;
+                saveio_stats_get(&io);
+            }
+        }
+
+        printf("%-10s %6d %10llu ms %7llu ms %7.2fx %10.1f %6llu KB\n", model ? "New3DS" : "Old3DS", provision.count,
+            (unsigned long long)(sequential_us / 1000), (unsigned long long)(fleet_us / 1000),
+            fleet_us ? (double)sequential_us / fleet_us : 0.0, fleet_us ? provision.installed * 1e6 / fleet_us : 0.0,
+            (unsigned long long)(io.ops[SAVEIO_WRITE].bytes / 1024));
+
+        for(int i = 0; i < provision.count; i++)
+        {
+            const fleet_title* title = &provision.titles[i];
+            if(title->result == 0 && !title->skipped) continue;
+
+            printf("  FAIL: %s/%016llx %s %08lX\n", title->exploitname, (unsigned long long)title->program_id, title->skipped ? "was skipped" : "returned", (unsigned long)(u32)title->result);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+static unsigned long long stage_ms(const bench_result* r, const char* name)
+{
+    for(int i = 0; i < install_stage_count; i++)
+        if(strcmp(install_stages[i].name, name) == 0) return r->stage_us[i] / 1000;
+
+    return 0;
+}
+
+static int load_thresholds(const char* path)
+{
+    char line[256];
+    FILE* f = fopen(path, "r");
+    if(f == NULL) return 1;
+
+    while(fgets(line, sizeof(line) - 1, f) && threshold_count < BENCH_MAX_THRESHOLDS)
+    {
+        bench_threshold* t = &thresholds[threshold_count];
+        unsigned long long limit = 0;
+
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%127s %31s %llu", t->name, t->metric, &limit) != 3) continue;
+
+        t->limit = limit;
+        threshold_count++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static const bench_threshold* find_threshold(const char* name, const char* metric)
+{
+    for(int i = 0; i < threshold_count; i++)
+        if(strcmp(thresholds[i].name, name) == 0 && strcmp(thresholds[i].metric, metric) == 0) return &thresholds[i];
+
+    return NULL;
+}
+
+// Times get room for noise, everything else has to stay exactly where it is or go down.
+static int write_thresholds(const char* path, const bench_result* results)
+{
+    FILE* f = fopen(path, "w");
+    if(f == NULL) return 1;
+
+    fprintf(f, "# run metric limit, written by \"bench --update\"\n");
+    for(int i = 0; i < case_count; i++)
+    {
+        for(int metric = 0; metric < METRIC_COUNT; metric++)
+        {
+            u64 value = metric_value(&results[i], metric);
+            if(metric == 0) value = value * 2 + 50;
+
+            fprintf(f, "%s %s %llu\n", cases[i].name, metric_names[metric], (unsigned long long)value);
+        }
+    }
+
+    return fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+    const char* servers[MIRRORS_MAX] = { "http://127.0.0.1:8123" };
+    int server_count = 0;
+    u64 deadline = 0;
+    const char* work = "bench_work";
+    const char* romfs = "romfs";
+    const char* thresholds_path = "tools/bench/thresholds.txt";
+    bool update = false;
+    bool dump = false;
+    bool provision = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--update") == 0) update = true;
+        else if(strcmp(argv[i], "--dump") == 0) dump = true;
+        else if(strcmp(argv[i], "--verify") == 0) verify = true;
+        else if(strcmp(argv[i], "--backup") == 0) backup = true;
+        else if(strcmp(argv[i], "--fleet") == 0) provision = true;
+        else if(strcmp(argv[i], "--pin") == 0) pin = true;
+        else if(strcmp(argv[i], "--dry-run") == 0) dry_run = true;
+        else if(i + 1 == argc) break;
+        else if(strcmp(argv[i], "--server") == 0 && server_count < MIRRORS_MAX) servers[server_count++] = argv[++i];
+        else if(strcmp(argv[i], "--deadline") == 0) deadline = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "--work") == 0) work = argv[++i];
+        else if(strcmp(argv[i], "--romfs") == 0) romfs = argv[++i];
+        else if(strcmp(argv[i], "--thresholds") == 0) thresholds_path = argv[++i];
+        else if(strcmp(argv[i], "--repeat") == 0) repeat = atoi(argv[++i]);
+    }
+
+    if(repeat < 1) repeat = 1;
+    if(server_count == 0) server_count = 1;
+    if(dry_run && backup)
+    {
+        fprintf(stderr, "--dry-run can't be combined with --backup.\n");
+        return 2;
+    }
+
+    static char sdmc[512], save[512], command[1100];
+    snprintf(sdmc, sizeof(sdmc), "%s/sdmc", work);
+    snprintf(save, sizeof(save), "%s/save", work);
+    snprintf(command, sizeof(command), "mkdir -p '%s/salt_sploit_installer' '%s'", sdmc, save);
+    if(system(command)) return 2;
+
+    ctru_host_configure(romfs, sdmc);
+    saveio_set_root(save);
+    status_init();
+    services_init();
+    jobs_init();
+
+    FILE* f = fopen("sdmc:/salt_sploit_installer/server.txt", "w");
+    if(f == NULL) return 2;
+    for(int i = 0; i < server_count; i++) fprintf(f, "%s\n", servers[i]);
+    fclose(f);
+    remove("sdmc:/salt_sploit_installer/hashes.txt");
+
+    int firmware_version[6] = { 0, 11, 0, 35, 32, 1 };
+    for(int model = 0; model < 2; model++)
+    {
+        firmware_version[0] = model;
+        if(write_payload(work, firmware_version))
+        {
+            fprintf(stderr, "Failed to write the benchmark payload.\n");
+            return 2;
+        }
+    }
+
+    if(find_cases() || case_count == 0)
+    {
+        fprintf(stderr, "No exploits found in %s/exploitlist_config.\n", romfs);
+        return 2;
+    }
+
+    if(provision)
+    {
+        int failures = run_fleet(firmware_version);
+
+        jobs_exit();
+        arena_free(&install_arena);
+        services_exit();
+
+        printf("%d failure(s)\n", failures);
+        return failures ? 1 : 0;
+    }
+
+    if(!update && load_thresholds(thresholds_path)) fprintf(stderr, "No thresholds at %s, nothing is checked.\n", thresholds_path);
+
+    static bench_result results[BENCH_MAX_CASES];
+    int failures = 0;
+
+    printf("%-48s %8s %8s %8s %8s %8s %8s %8s %9s %5s %7s %7s %7s\n", "run", "download", "compress", "backup", "install", "restore", "total", "read", "written", "opens", "flushes", "commits", "peak");
+
+    for(int i = 0; i < case_count; i++)
+    {
+        bench_result* best = &results[i];
+
+        // the fastest of the repeats, the counters are the same every time
+        for(int n = 0; n < repeat; n++)
+        {
+            bench_result r;
+            run_case(&cases[i], firmware_version, &r);
+            if(n == 0 || r.ret || r.total_us < best->total_us) *best = r;
+            if(r.ret) break;
+        }
+
+        printf("%-48s %5llu ms %5llu ms %5llu ms %5llu ms %5llu ms %5llu ms %5llu KB %6llu KB %5lu %7lu %7lu %4llu KB\n", cases[i].name,
+            stage_ms(best, "stage_download"), stage_ms(best, "stage_compress"), stage_ms(best, "stage_backup"), stage_ms(best, "stage_install"),
+            (unsigned long long)(best->restore_us / 1000),
+            (unsigned long long)(best->total_us / 1000), (unsigned long long)(best->io.ops[SAVEIO_READ].bytes / 1024), (unsigned long long)(best->io.ops[SAVEIO_WRITE].bytes / 1024),
+            (unsigned long)best->io.ops[SAVEIO_OPEN].count, (unsigned long)best->io.flushes, (unsigned long)best->io.ops[SAVEIO_COMMIT].count, (unsigned long long)(best->peak / 1024));
+        if(dump) saveio_stats_print(stdout);
+
+        if(best->ret)
+        {
+            char text[STATUS_SIZE];
+            status_get(text, sizeof(text));
+            printf("  FAIL: install returned %08lX: %s\n", (unsigned long)(u32)best->ret, text);
+            failures++;
+            continue;
+        }
+
+        for(int n = 0; n < ESTIMATED_OPS && dry_run; n++)
+        {
+            saveio_op op = estimated_ops[n];
+            if(best->estimate.ops[op] == best->io.ops[op].count) continue;
+
+            printf("  FAIL: the plan estimated %lu %s call(s), the install made %lu\n", (unsigned long)best->estimate.ops[op], estimated_names[n],
+                (unsigned long)best->io.ops[op].count);
+            failures++;
+        }
+        if(dry_run && best->estimate.bytes[SAVEIO_WRITE] != best->io.ops[SAVEIO_WRITE].bytes)
+        {
+            printf("  FAIL: the plan estimated %llu bytes written, the install wrote %llu\n", (unsigned long long)best->estimate.bytes[SAVEIO_WRITE],
+                (unsigned long long)best->io.ops[SAVEIO_WRITE].bytes);
+            failures++;
+        }
+
+        if(deadline && stage_ms(best, "stage_download") > deadline)
+        {
+            printf("  FAIL: the download took over %llu ms\n", (unsigned long long)deadline);
+            failures++;
+        }
+
+        for(int metric = 0; metric < METRIC_COUNT && !update && !verify && !backup && server_count == 1; metric++)
+        {
+            const bench_threshold* t = find_threshold(cases[i].name, metric_names[metric]);
+            u64 value = metric_value(best, metric);
+            if(t == NULL || value <= t->limit) continue;
+
+            printf("  FAIL: %s %llu is over the threshold of %llu\n", metric_names[metric], (unsigned long long)value, (unsigned long long)t->limit);
+            failures++;
+        }
+    }
+
+    if(update && write_thresholds(thresholds_path, results))
+    {
+        fprintf(stderr, "Failed to write %s.\n", thresholds_path);
+        return 2;
+    }
+
+    jobs_exit();
+    arena_free(&install_arena);
+    services_exit();
+
+    printf("%d run(s), %d failure(s)\n", case_count, failures);
+    return failures ? 1 : 0;
+}
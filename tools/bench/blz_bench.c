@@ -0,0 +1,306 @@
+// Checks every BLZ kernel set of source/blz.c against the scalar one, which is the original byte-by-byte code,
+// and times them: BLZ_Code() on generated payload-like, text, zero and random buffers (and on any files given),
+// and BLZ_Invert() on 1 MB. Each set is source/blz.c built with its own flags and renamed, see the Makefile.
+//
+//   blz_bench [--repeat n] [file...]
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// only ever passed as NULL here, for heap allocations without progress
+typedef struct BLZ_Context BLZ_Context;
+
+#define BLZ_BENCH_SIZE 0x20000
+#define BLZ_BENCH_INVERT_SIZE 0x100000
+#define BLZ_BENCH_FUZZ_RUNS 2000
+
+#define BLZ_VARIANT(name) \
+    unsigned char* BLZ_Code_##name(unsigned char* raw_buffer, int raw_len, unsigned int* new_len, int best, const BLZ_Context* context); \
+    void BLZ_Invert_##name(unsigned char* buffer, int length); \
+    const char* BLZ_Kernels_##name(void);
+
+BLZ_VARIANT(scalar)
+BLZ_VARIANT(word)
+BLZ_VARIANT(sse2)
+#ifdef BLZ_BENCH_AVX2
+BLZ_VARIANT(avx2)
+#endif
+
+typedef struct {
+    unsigned char* (*code)(unsigned char* raw_buffer, int raw_len, unsigned int* new_len, int best, const BLZ_Context* context);
+    void (*invert)(unsigned char* buffer, int length);
+    const char* (*kernels)(void);
+    int supported;
+} blz_variant;
+
+static blz_variant variants[] = {
+    { BLZ_Code_scalar, BLZ_Invert_scalar, BLZ_Kernels_scalar, 1 },
+    { BLZ_Code_word, BLZ_Invert_word, BLZ_Kernels_word, 1 },
+    { BLZ_Code_sse2, BLZ_Invert_sse2, BLZ_Kernels_sse2, 1 },
+#ifdef BLZ_BENCH_AVX2
+    { BLZ_Code_avx2, BLZ_Invert_avx2, BLZ_Kernels_avx2, 0 },
+#endif
+};
+#define VARIANT_COUNT (int)(sizeof(variants) / sizeof(variants[0]))
+
+typedef struct {
+    char name[64];
+    unsigned char* data;
+    int size;
+} blz_input;
+
+static int repeat = 3;
+static unsigned int seed = 0x5A17;
+
+static unsigned int next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static unsigned long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ARM code with mostly MOV r0, #imm, like tools/bench/bench.c's payload
+static void fill_payload(unsigned char* out, int size)
+{
+    for(int i = 0; i + 4 <= size; i += 4)
+    {
+        unsigned int r = next_random();
+        unsigned int word = (r >> 8) & 0x3 ? 0xE1A00000 | (r & 0xFF) : r * 2654435761u;
+        memcpy(&out[i], &word, 4);
+    }
+}
+
+static void fill_text(unsigned char* out, int size)
+{
+    static const char* const words[] = { "salt ", "sploit ", "installer ", "save ", "slot ", "payload ", "romfs ", "\n" };
+
+    for(int i = 0; i < size; )
+        for(const char* w = words[next_random() % 8]; *w && i < size; w++) out[i++] = *w;
+}
+
+static void fill_random(unsigned char* out, int size)
+{
+    for(int i = 0; i < size; i++) out[i] = next_random();
+}
+
+static blz_input* add_input(blz_input* inputs, int* count, const char* name, int size)
+{
+    blz_input* in = &inputs[(*count)++];
+    snprintf(in->name, sizeof(in->name), "%s", name);
+    in->data = calloc(size ? size : 1, 1);
+    in->size = size;
+    return in;
+}
+
+static int load_file(blz_input* inputs, int* count, const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    const char* name = strrchr(path, '/');
+    blz_input* in = add_input(inputs, count, name ? name + 1 : path, size);
+    size_t got = fread(in->data, 1, size, f);
+    fclose(f);
+
+    return got != (size_t)size;
+}
+
+// Compresses in with v, into a buffer of its own. Returns NULL when BLZ_Code() fails or changed its input.
+static unsigned char* code(const blz_variant* v, const unsigned char* in, int size, unsigned int* out_size, int best)
+{
+    unsigned char* raw = malloc(size ? size : 1);
+    memcpy(raw, in, size);
+
+    unsigned char* out = v->code(raw, size, out_size, best, NULL);
+    if(out && memcmp(raw, in, size))
+    {
+        free(out);
+        out = NULL;
+    }
+
+    free(raw);
+    return out;
+}
+
+// Whether every kernel set gives the scalar output, for in in both modes.
+static int check(const unsigned char* in, int size, const char* name)
+{
+    int failures = 0;
+
+    for(int best = 0; best < 2; best++)
+    {
+        unsigned int expected_size = 0;
+        unsigned char* expected = code(&variants[0], in, size, &expected_size, best);
+
+        for(int i = 1; i < VARIANT_COUNT; i++)
+        {
+            if(!variants[i].supported) continue;
+
+            unsigned int out_size = 0;
+            unsigned char* out = code(&variants[i], in, size, &out_size, best);
+            if(out == NULL || expected == NULL || out_size != expected_size || memcmp(out, expected, out_size))
+            {
+                printf("  FAIL: %s differs from scalar on %s (%d bytes, %s)\n", variants[i].kernels(), name, size, best ? "best" : "normal");
+                failures++;
+            }
+            free(out);
+        }
+
+        free(expected);
+    }
+
+    return failures;
+}
+
+// Short buffers over small alphabets, which have plenty of matches of every length and offset, and of the
+// boundaries the wide kernels have to leave to the narrow ones.
+static int fuzz(void)
+{
+    unsigned char buffer[600];
+    int failures = 0;
+
+    for(int run = 0; run < BLZ_BENCH_FUZZ_RUNS && failures == 0; run++)
+    {
+        int size = next_random() % sizeof(buffer);
+        int alphabet = 1 + next_random() % 4;
+        for(int i = 0; i < size; i++) buffer[i] = 'a' + next_random() % alphabet;
+
+        char name[32];
+        snprintf(name, sizeof(name), "fuzz run %d", run);
+        failures += check(buffer, size, name);
+    }
+
+    return failures;
+}
+
+static int check_invert(void)
+{
+    static unsigned char buffer[300], expected[300];
+    int failures = 0;
+
+    for(int size = 0; size <= (int)sizeof(buffer); size++)
+    {
+        fill_random(buffer, size);
+        for(int i = 0; i < size; i++) expected[i] = buffer[size - 1 - i];
+
+        for(int i = 0; i < VARIANT_COUNT; i++)
+        {
+            if(!variants[i].supported) continue;
+
+            unsigned char copy[sizeof(buffer)];
+            memcpy(copy, buffer, size);
+            variants[i].invert(copy, size);
+            if(memcmp(copy, expected, size) == 0) continue;
+
+            printf("  FAIL: %s BLZ_Invert() is wrong on %d bytes\n", variants[i].kernels(), size);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    static blz_input inputs[64];
+    int input_count = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else if(input_count < 60 && load_file(inputs, &input_count, argv[i]))
+        {
+            fprintf(stderr, "Failed to read %s.\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if(repeat < 1) repeat = 1;
+
+#ifdef BLZ_BENCH_AVX2
+    __builtin_cpu_init();
+    variants[VARIANT_COUNT - 1].supported = __builtin_cpu_supports("avx2");
+#endif
+
+    fill_payload(add_input(inputs, &input_count, "payload", BLZ_BENCH_SIZE)->data, BLZ_BENCH_SIZE);
+    fill_text(add_input(inputs, &input_count, "text", BLZ_BENCH_SIZE)->data, BLZ_BENCH_SIZE);
+    add_input(inputs, &input_count, "zeros", BLZ_BENCH_SIZE);
+    fill_random(add_input(inputs, &input_count, "random", BLZ_BENCH_SIZE)->data, BLZ_BENCH_SIZE);
+
+    int failures = check_invert() + fuzz();
+
+    printf("%-24s %8s", "BLZ_Code", "size");
+    for(int i = 0; i < VARIANT_COUNT; i++) printf(" %10s", variants[i].kernels());
+    printf(" %8s\n", "speedup");
+
+    for(int n = 0; n < input_count; n++)
+    {
+        blz_input* in = &inputs[n];
+        failures += check(in->data, in->size, in->name);
+
+        unsigned long long best_us[VARIANT_COUNT] = {0}, fastest = 0;
+        for(int i = 0; i < VARIANT_COUNT; i++)
+        {
+            if(!variants[i].supported) continue;
+
+            for(int r = 0; r < repeat; r++)
+            {
+                unsigned int out_size;
+                unsigned long long start = now_us();
+                free(code(&variants[i], in->data, in->size, &out_size, 0));
+                unsigned long long us = now_us() - start;
+                if(r == 0 || us < best_us[i]) best_us[i] = us;
+            }
+            if(fastest == 0 || best_us[i] < fastest) fastest = best_us[i];
+        }
+
+        printf("%-24s %5d KB", in->name, in->size / 1024);
+        for(int i = 0; i < VARIANT_COUNT; i++)
+        {
+            if(variants[i].supported) printf(" %7.2f ms", best_us[i] / 1000.0);
+            else printf(" %10s", "-");
+        }
+        printf(" %7.2fx\n", fastest ? (double)best_us[0] / fastest : 0.0);
+    }
+
+    static unsigned char invert_buffer[BLZ_BENCH_INVERT_SIZE];
+    fill_random(invert_buffer, sizeof(invert_buffer));
+
+    unsigned long long invert_us[VARIANT_COUNT] = {0}, fastest = 0;
+    for(int i = 0; i < VARIANT_COUNT; i++)
+    {
+        if(!variants[i].supported) continue;
+
+        for(int r = 0; r < repeat; r++)
+        {
+            unsigned long long start = now_us();
+            for(int k = 0; k < 16; k++) variants[i].invert(invert_buffer, sizeof(invert_buffer));
+            unsigned long long us = now_us() - start;
+            if(r == 0 || us < invert_us[i]) invert_us[i] = us;
+        }
+        if(fastest == 0 || invert_us[i] < fastest) fastest = invert_us[i];
+    }
+
+    printf("%-24s %5d KB", "BLZ_Invert x16", BLZ_BENCH_INVERT_SIZE / 1024);
+    for(int i = 0; i < VARIANT_COUNT; i++)
+    {
+        if(variants[i].supported) printf(" %7.2f ms", invert_us[i] / 1000.0);
+        else printf(" %10s", "-");
+    }
+    printf(" %7.2fx\n", fastest ? (double)invert_us[0] / fastest : 0.0);
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
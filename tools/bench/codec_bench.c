@@ -0,0 +1,240 @@
+// Round-trips every payload codec of source/codec.h at every level and times it. Each input is encoded in one
+// piece and streamed in random pieces, which has to give the same output, and decoded back with the codec's own
+// decoder: generated payload-like, text, zero and random buffers (and any files given), plus short buffers over
+// small alphabets and the sizes around the codecs' boundaries.
+//
+//   codec_bench [--repeat n] [--codec name] [file...]
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <3ds.h>
+
+#include "arena.h"
+#include "codec.h"
+
+// plain host paths, without ctru_host.c
+#undef fopen
+
+#define CODEC_BENCH_SIZE 0x20000
+#define CODEC_BENCH_FUZZ_RUNS 300
+
+typedef struct {
+    char name[64];
+    u8* data;
+    u32 size;
+} codec_input;
+
+static int repeat = 3;
+static unsigned int seed = 0x5A17;
+static arena scratch;
+
+static unsigned int next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static unsigned long long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ARM code with mostly MOV r0, #imm, like tools/bench/bench.c's payload
+static void fill_payload(u8* out, u32 size)
+{
+    for(u32 i = 0; i + 4 <= size; i += 4)
+    {
+        unsigned int r = next_random();
+        unsigned int word = (r >> 8) & 0x3 ? 0xE1A00000 | (r & 0xFF) : r * 2654435761u;
+        memcpy(&out[i], &word, 4);
+    }
+}
+
+static void fill_text(u8* out, u32 size)
+{
+    static const char* const words[] = { "salt ", "sploit ", "installer ", "save ", "slot ", "payload ", "romfs ", "\n" };
+
+    for(u32 i = 0; i < size; )
+        for(const char* w = words[next_random() % 8]; *w && i < size; w++) out[i++] = *w;
+}
+
+static void fill_random(u8* out, u32 size)
+{
+    for(u32 i = 0; i < size; i++) out[i] = next_random();
+}
+
+static codec_input* add_input(codec_input* inputs, int* count, const char* name, u32 size)
+{
+    codec_input* in = &inputs[(*count)++];
+    snprintf(in->name, sizeof(in->name), "%s", name);
+    in->data = calloc(size ? size : 1, 1);
+    in->size = size;
+    return in;
+}
+
+static int load_file(codec_input* inputs, int* count, const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) return 1;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    const char* name = strrchr(path, '/');
+    codec_input* in = add_input(inputs, count, name ? name + 1 : path, size);
+    size_t got = fread(in->data, 1, size, f);
+    fclose(f);
+
+    return got != (size_t)size;
+}
+
+// Encodes in, in pieces of at most piece bytes (random sizes when it's 0). The output lives in scratch.
+static Result encode(const codec* c, int level, u8* in, u32 size, u32 piece, u8** out, u32* out_size)
+{
+    codec_stream stream;
+    Result ret = codec_begin(&stream, c, level, in, size, &scratch, NULL);
+
+    for(u32 done = 0; !ret && done < size; )
+    {
+        u32 chunk = piece ? piece : 1 + next_random() % 0x3000;
+        if(chunk > size - done) chunk = size - done;
+
+        ret = codec_update(&stream, chunk);
+        done += chunk;
+    }
+
+    return ret ? ret : codec_end(&stream, out, out_size);
+}
+
+// Whether c at level gives the same output streamed as in one piece, within its bound, that decodes back to in.
+static int check(const codec* c, int level, u8* in, u32 size, const char* name)
+{
+    u8 *whole = NULL, *streamed = NULL;
+    u32 whole_size = 0, streamed_size = 0;
+    const char* failure = NULL;
+
+    arena_reset(&scratch);
+    u8* decoded = arena_alloc(&scratch, size + 4);
+
+    if(encode(c, level, in, size, size, &whole, &whole_size)) failure = "encoding failed";
+    else if(whole_size > c->bound(size)) failure = "output is over the bound";
+    else if(encode(c, level, in, size, 0, &streamed, &streamed_size)) failure = "streamed encoding failed";
+    else if(streamed_size != whole_size || memcmp(streamed, whole, whole_size)) failure = "streamed output differs";
+    else if(c->decode(whole, whole_size, decoded, size) != (int)size || memcmp(decoded, in, size)) failure = "doesn't decode back";
+
+    if(failure == NULL) return 0;
+
+    printf("  FAIL: %s level %d %s on %s (%lu bytes)\n", c->name, level, failure, name, (unsigned long)size);
+    return 1;
+}
+
+// Short buffers over small alphabets, which have matches of every length and offset.
+static int fuzz(const codec* c, int level)
+{
+    static u8 buffer[5000];
+    int failures = 0;
+
+    for(int run = 0; run < CODEC_BENCH_FUZZ_RUNS && failures == 0; run++)
+    {
+        u32 size = next_random() % sizeof(buffer);
+        int alphabet = 1 + next_random() % 4;
+        for(u32 i = 0; i < size; i++) buffer[i] = 'a' + next_random() % alphabet;
+
+        char name[32];
+        snprintf(name, sizeof(name), "fuzz run %d", run);
+        failures += check(c, level, buffer, size, name);
+    }
+
+    // the sizes around the flag bytes, the padding and LZ11's longest match
+    static const u32 sizes[] = { 0, 1, 2, 3, 4, 7, 8, 9, 17, 18, 19, 0x1000, 0x1001, 0x10110, 0x10111, 0x20000 };
+    static u8 zeros[0x20000];
+    for(u32 i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%lu zeros", (unsigned long)sizes[i]);
+        failures += check(c, level, zeros, sizes[i], name);
+    }
+
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    static codec_input inputs[64];
+    int input_count = 0;
+    const char* only = NULL;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--codec") == 0 && i + 1 < argc) only = argv[++i];
+        else if(input_count < 60 && load_file(inputs, &input_count, argv[i]))
+        {
+            fprintf(stderr, "Failed to read %s.\n", argv[i]);
+            return 2;
+        }
+    }
+
+    if(repeat < 1) repeat = 1;
+    arena_init(&scratch, 0x100000);
+
+    fill_payload(add_input(inputs, &input_count, "payload", CODEC_BENCH_SIZE)->data, CODEC_BENCH_SIZE);
+    fill_text(add_input(inputs, &input_count, "text", CODEC_BENCH_SIZE)->data, CODEC_BENCH_SIZE);
+    add_input(inputs, &input_count, "zeros", CODEC_BENCH_SIZE);
+    fill_random(add_input(inputs, &input_count, "random", CODEC_BENCH_SIZE)->data, CODEC_BENCH_SIZE);
+
+    int failures = 0;
+    printf("%-16s %-8s %8s %9s %7s %10s %10s\n", "input", "codec", "size", "encoded", "ratio", "encode", "decode");
+
+    for(int id = 0; id < codec_count(); id++)
+    {
+        const codec* c = codec_get(id);
+        if(only && strcmp(c->name, only)) continue;
+
+        for(int level = 1; level <= c->max_level; level++)
+        {
+            failures += fuzz(c, level);
+
+            for(int n = 0; n < input_count; n++)
+            {
+                codec_input* in = &inputs[n];
+                failures += check(c, level, in->data, in->size, in->name);
+
+                unsigned long long encode_us = 0, decode_us = 0;
+                u32 out_size = 0;
+                for(int r = 0; r < repeat; r++)
+                {
+                    u8* out = NULL;
+                    arena_reset(&scratch);
+                    u8* decoded = arena_alloc(&scratch, in->size + 4);
+
+                    unsigned long long start = now_us();
+                    if(encode(c, level, in->data, in->size, in->size, &out, &out_size)) break;
+                    unsigned long long us = now_us() - start;
+                    if(r == 0 || us < encode_us) encode_us = us;
+
+                    start = now_us();
+                    c->decode(out, out_size, decoded, in->size);
+                    us = now_us() - start;
+                    if(r == 0 || us < decode_us) decode_us = us;
+                }
+
+                char codec_name[16];
+                snprintf(codec_name, sizeof(codec_name), "%s:%d%s", c->name, level, level == c->default_level ? "*" : "");
+                printf("%-16s %-8s %5lu KB %6.1f KB %6.1f%% %7.2f ms %7.2f ms\n", in->name, codec_name, (unsigned long)(in->size / 1024), out_size / 1024.0,
+                    in->size ? out_size * 100.0 / in->size : 0.0, encode_us / 1000.0, decode_us / 1000.0);
+            }
+        }
+    }
+
+    arena_free(&scratch);
+
+    printf("%d failure(s)\n", failures);
+    return failures ? 1 : 0;
+}
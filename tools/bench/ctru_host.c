@@ -0,0 +1,788 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <strings.h>
+#include <netdb.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <3ds.h>
+
+#undef fopen
+#undef mkdir
+#undef remove
+#undef rename
+
+// results for the few failures the pipeline looks at, the values don't matter beyond being failures
+#define HOST_ERR_IO         ((Result)0xC8804464)
+#define HOST_ERR_HTTP       ((Result)0xD8A0A03C)
+#define HOST_HTTP_HEADERS_SIZE 0x2000
+
+static const char* romfs_dir = "romfs";
+static const char* sdmc_dir = "sdmc";
+
+void ctru_host_configure(const char* romfs, const char* sdmc)
+{
+    romfs_dir = romfs;
+    sdmc_dir = sdmc;
+}
+
+static const char* host_path(const char* path, char* out, size_t out_size)
+{
+    if(strncmp(path, "romfs:/", 7) == 0) snprintf(out, out_size, "%s/%s", romfs_dir, path + 7);
+    else if(strncmp(path, "sdmc:/", 6) == 0) snprintf(out, out_size, "%s/%s", sdmc_dir, path + 6);
+    else return path;
+
+    return out;
+}
+
+FILE* ctru_host_fopen(const char* path, const char* mode)
+{
+    char buf[1024];
+    return fopen(host_path(path, buf, sizeof(buf)), mode);
+}
+
+int ctru_host_mkdir(const char* path, mode_t mode)
+{
+    char buf[1024];
+    return mkdir(host_path(path, buf, sizeof(buf)), mode);
+}
+
+int ctru_host_remove(const char* path)
+{
+    char buf[1024];
+    return remove(host_path(path, buf, sizeof(buf)));
+}
+
+int ctru_host_rename(const char* old_path, const char* new_path)
+{
+    char old_buf[1024], new_buf[1024];
+    return rename(host_path(old_path, old_buf, sizeof(old_buf)), host_path(new_path, new_buf, sizeof(new_buf)));
+}
+
+// svc
+
+Result svcCloseHandle(Handle handle)
+{
+    return 0;
+}
+
+Result svcGetThreadPriority(s32* out, Handle handle)
+{
+    *out = 0x30;
+    return 0;
+}
+
+Result svcGetThreadId(u32* out, Handle handle)
+{
+    *out = (u32)(uintptr_t)pthread_self();
+    return 0;
+}
+
+u64 svcGetSystemTick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)((double)ts.tv_sec * SYSCLOCK_ARM11 + (double)ts.tv_nsec * SYSCLOCK_ARM11 / 1e9);
+}
+
+Result srvGetServiceHandleDirect(Handle* out, const char* name)
+{
+    *out = 1;
+    return 0;
+}
+
+void osSetSpeedupEnable(bool enable) {}
+
+// synchronization and threads
+
+void LightLock_Init(LightLock* lock)
+{
+    pthread_mutex_init(lock, NULL);
+}
+
+void LightLock_Lock(LightLock* lock)
+{
+    pthread_mutex_lock(lock);
+}
+
+void LightLock_Unlock(LightLock* lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+void CondVar_Init(CondVar* cv)
+{
+    pthread_cond_init(cv, NULL);
+}
+
+void CondVar_Wait(CondVar* cv, LightLock* lock)
+{
+    pthread_cond_wait(cv, lock);
+}
+
+int CondVar_WaitTimeout(CondVar* cv, LightLock* lock, s64 timeout_ns)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ns / 1000000000;
+    ts.tv_nsec += timeout_ns % 1000000000;
+    if(ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    return pthread_cond_timedwait(cv, lock, &ts) != 0;
+}
+
+void CondVar_Signal(CondVar* cv)
+{
+    pthread_cond_signal(cv);
+}
+
+void CondVar_Broadcast(CondVar* cv)
+{
+    pthread_cond_broadcast(cv);
+}
+
+struct ctru_host_thread {
+    pthread_t thread;
+    ThreadFunc entrypoint;
+    void* arg;
+};
+
+static void* host_thread_main(void* arg)
+{
+    struct ctru_host_thread* thread = arg;
+    thread->entrypoint(thread->arg);
+    return NULL;
+}
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stack_size, int prio, int affinity, bool detached)
+{
+    struct ctru_host_thread* thread = calloc(1, sizeof(*thread));
+    if(thread == NULL) return NULL;
+
+    thread->entrypoint = entrypoint;
+    thread->arg = arg;
+    if(pthread_create(&thread->thread, NULL, host_thread_main, thread))
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+Result threadJoin(Thread thread, u64 timeout_ns)
+{
+    return pthread_join(thread->thread, NULL) ? HOST_ERR_IO : 0;
+}
+
+void threadFree(Thread thread)
+{
+    free(thread);
+}
+
+// fs
+
+Result fsInit(void) { return 0; }
+void fsExit(void) {}
+Result romfsInit(void) { return 0; }
+Result romfsExit(void) { return 0; }
+
+Result FSUSER_Initialize(Handle session)
+{
+    return 0;
+}
+
+FS_Path fsMakePath(FS_PathType type, const void* path)
+{
+    return (FS_Path){type, type == PATH_ASCII ? strlen(path) + 1 : 1, path};
+}
+
+// romfs_dir as a level-3 RomFS image, laid out like the ones 3dstool and 3dsxtool build: header, directory hash
+// table, directory table, file hash table, file table and the file data, 16-byte aligned.
+
+#define HOST_ROMFS_HANDLE 0x524F4D46
+#define HOST_ROMFS_MAX_DIRS 512
+#define HOST_ROMFS_MAX_FILES 2048
+#define HOST_ROMFS_NONE 0xFFFFFFFF
+
+typedef struct {
+    char name[256];
+    // files only
+    char path[768];
+    u64 data_offset;
+    u64 data_size;
+    // directory indices, except for the siblings and children of the same kind
+    int parent;
+    int sibling;
+    int child_dir;
+    int child_file;
+    u32 offset;
+} host_romfs_entry;
+
+static host_romfs_entry romfs_dirs[HOST_ROMFS_MAX_DIRS];
+static host_romfs_entry romfs_files[HOST_ROMFS_MAX_FILES];
+static int romfs_dir_count, romfs_file_count;
+static u8* romfs_image;
+static size_t romfs_image_size;
+
+static int host_romfs_scan(int parent, const char* path)
+{
+    struct dirent** names;
+    int count = scandir(path, &names, NULL, alphasort);
+    if(count < 0) return 1;
+
+    int* last_dir = &romfs_dirs[parent].child_dir;
+    int* last_file = &romfs_dirs[parent].child_file;
+    int ret = 0;
+
+    for(int i = 0; i < count; i++)
+    {
+        char child[768];
+        struct stat st;
+        snprintf(child, sizeof(child), "%s/%s", path, names[i]->d_name);
+
+        host_romfs_entry* entry = NULL;
+        if(ret == 0 && names[i]->d_name[0] != '.' && stat(child, &st) == 0)
+        {
+            if(S_ISDIR(st.st_mode) && romfs_dir_count < HOST_ROMFS_MAX_DIRS)
+            {
+                *last_dir = romfs_dir_count;
+                entry = &romfs_dirs[romfs_dir_count++];
+                last_dir = &entry->sibling;
+            }
+            else if(S_ISREG(st.st_mode) && romfs_file_count < HOST_ROMFS_MAX_FILES)
+            {
+                *last_file = romfs_file_count;
+                entry = &romfs_files[romfs_file_count++];
+                last_file = &entry->sibling;
+                snprintf(entry->path, sizeof(entry->path), "%s", child);
+                entry->data_size = st.st_size;
+            }
+            else ret = 1;
+        }
+
+        if(entry)
+        {
+            snprintf(entry->name, sizeof(entry->name), "%s", names[i]->d_name);
+            entry->parent = parent;
+            entry->sibling = entry->child_dir = entry->child_file = -1;
+            if(S_ISDIR(st.st_mode)) ret = host_romfs_scan(entry - romfs_dirs, child);
+        }
+
+        free(names[i]);
+    }
+
+    free(names);
+    return ret;
+}
+
+static u32 host_romfs_hash(u32 parent, const char* name)
+{
+    u32 hash = parent ^ 123456789;
+    for(; *name; name++) hash = ((hash >> 5) | (hash << 27)) ^ (u8)*name;
+    return hash;
+}
+
+static u32 host_romfs_entry_size(const host_romfs_entry* entry, u32 header_size)
+{
+    return header_size + ((strlen(entry->name) * 2 + 3) & ~3);
+}
+
+static void host_romfs_put32(u8* p, u32 value)
+{
+    memcpy(p, &value, 4);
+}
+
+// Writes every entry of one kind, with its hash chain, header_size being 0x18 for directories and 0x20 for files.
+static void host_romfs_write_table(host_romfs_entry* entries, int count, u32 header_size, u8* hash_table, u32 buckets, u8* table)
+{
+    memset(hash_table, 0xFF, buckets * 4);
+
+    for(int i = 0; i < count; i++)
+    {
+        host_romfs_entry* entry = &entries[i];
+        u8* p = &table[entry->offset];
+        u32 bucket = host_romfs_hash(romfs_dirs[entry->parent].offset, entry->name) % buckets;
+
+        u32 next_hash;
+        memcpy(&next_hash, &hash_table[bucket * 4], 4);
+        host_romfs_put32(&hash_table[bucket * 4], entry->offset);
+
+        u32 sibling = entry->sibling < 0 ? HOST_ROMFS_NONE : entries[entry->sibling].offset;
+        host_romfs_put32(p, romfs_dirs[entry->parent].offset);
+        host_romfs_put32(p + 4, sibling);
+        if(header_size == 0x18)
+        {
+            host_romfs_put32(p + 8, entry->child_dir < 0 ? HOST_ROMFS_NONE : romfs_dirs[entry->child_dir].offset);
+            host_romfs_put32(p + 12, entry->child_file < 0 ? HOST_ROMFS_NONE : romfs_files[entry->child_file].offset);
+        }
+        else
+        {
+            memcpy(p + 8, &entry->data_offset, 8);
+            memcpy(p + 16, &entry->data_size, 8);
+        }
+        host_romfs_put32(p + header_size - 8, next_hash);
+        host_romfs_put32(p + header_size - 4, strlen(entry->name) * 2);
+
+        for(size_t n = 0; entry->name[n]; n++)
+        {
+            u16 unit = (u8)entry->name[n];
+            memcpy(p + header_size + n * 2, &unit, 2);
+        }
+    }
+}
+
+static Result host_romfs_build(void)
+{
+    romfs_dir_count = 1;
+    romfs_file_count = 0;
+    memset(&romfs_dirs[0], 0, sizeof(romfs_dirs[0]));
+    romfs_dirs[0].sibling = romfs_dirs[0].child_dir = romfs_dirs[0].child_file = -1;
+    if(host_romfs_scan(0, romfs_dir)) return HOST_ERR_IO;
+
+    u32 dir_table_size = 0, file_table_size = 0;
+    u64 data_size = 0;
+    for(int i = 0; i < romfs_dir_count; i++)
+    {
+        romfs_dirs[i].offset = dir_table_size;
+        dir_table_size += host_romfs_entry_size(&romfs_dirs[i], 0x18);
+    }
+    for(int i = 0; i < romfs_file_count; i++)
+    {
+        romfs_files[i].offset = file_table_size;
+        file_table_size += host_romfs_entry_size(&romfs_files[i], 0x20);
+        romfs_files[i].data_offset = data_size;
+        data_size = (data_size + romfs_files[i].data_size + 15) & ~(u64)15;
+    }
+
+    u32 dir_buckets = romfs_dir_count, file_buckets = romfs_file_count ? romfs_file_count : 1;
+    u32 header[10];
+    header[0] = sizeof(header);
+    header[1] = sizeof(header);
+    header[2] = dir_buckets * 4;
+    header[3] = header[1] + header[2];
+    header[4] = dir_table_size;
+    header[5] = header[3] + header[4];
+    header[6] = file_buckets * 4;
+    header[7] = header[5] + header[6];
+    header[8] = file_table_size;
+    header[9] = (header[7] + header[8] + 15) & ~15;
+
+    romfs_image_size = header[9] + data_size;
+    romfs_image = calloc(1, romfs_image_size);
+    if(romfs_image == NULL) return HOST_ERR_IO;
+
+    memcpy(romfs_image, header, sizeof(header));
+    host_romfs_write_table(romfs_dirs, romfs_dir_count, 0x18, &romfs_image[header[1]], dir_buckets, &romfs_image[header[3]]);
+    host_romfs_write_table(romfs_files, romfs_file_count, 0x20, &romfs_image[header[5]], file_buckets, &romfs_image[header[7]]);
+
+    for(int i = 0; i < romfs_file_count; i++)
+    {
+        FILE* f = fopen(romfs_files[i].path, "rb");
+        size_t got = f ? fread(&romfs_image[header[9] + romfs_files[i].data_offset], 1, romfs_files[i].data_size, f) : 0;
+        if(f) fclose(f);
+        if(got != romfs_files[i].data_size) return HOST_ERR_IO;
+    }
+
+    return 0;
+}
+
+Result FSUSER_OpenFileDirectly(Handle* out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes)
+{
+    if(archiveId != ARCHIVE_ROMFS || openFlags != FS_OPEN_READ) return HOST_ERR_IO;
+
+    if(romfs_image == NULL)
+    {
+        Result ret = host_romfs_build();
+        if(ret)
+        {
+            free(romfs_image);
+            romfs_image = NULL;
+            return ret;
+        }
+    }
+
+    *out = HOST_ROMFS_HANDLE;
+    return 0;
+}
+
+Result FSFILE_Read(Handle handle, u32* bytesRead, u64 offset, void* buffer, u32 size)
+{
+    if(handle != HOST_ROMFS_HANDLE) return HOST_ERR_IO;
+
+    *bytesRead = 0;
+    if(offset >= romfs_image_size) return 0;
+    if(size > romfs_image_size - offset) size = romfs_image_size - offset;
+
+    memcpy(buffer, &romfs_image[offset], size);
+    *bytesRead = size;
+    return 0;
+}
+
+Result FSFILE_Close(Handle handle)
+{
+    return handle == HOST_ROMFS_HANDLE ? 0 : HOST_ERR_IO;
+}
+
+// httpc, as HTTP/1.0 over a plain socket. The socket is non-blocking and every wait on it is cut in slices, so
+// that httpcCancelConnection() from another thread ends it.
+
+#define HOST_HTTP_POLL_MS 20
+
+struct ctru_host_http {
+    char host[256];
+    char port[8];
+    char path[768];
+    char request[HOST_HTTP_HEADERS_SIZE];
+    size_t request_size;
+
+    int socket;
+    int cancelled;
+    // the headers are read on the first call that needs them, like httpc does
+    bool answered;
+    u32 status_code;
+    char headers[HOST_HTTP_HEADERS_SIZE];
+    size_t headers_size;
+    // body bytes that came in with the headers
+    char* pending;
+    size_t pending_size;
+
+    u32 downloaded;
+    u32 content_size;
+    bool done;
+};
+
+static u64 host_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Waits for events on the socket until deadline_ms (0 for none), or until the connection is cancelled.
+static Result http_wait(struct ctru_host_http* http, short events, u64 deadline_ms)
+{
+    for(;;)
+    {
+        if(__atomic_load_n(&http->cancelled, __ATOMIC_ACQUIRE)) return HOST_ERR_HTTP;
+        if(deadline_ms && host_now_ms() >= deadline_ms) return (Result)HTTPC_RESULTCODE_TIMEDOUT;
+
+        struct pollfd fd = { http->socket, events, 0 };
+        int n = poll(&fd, 1, HOST_HTTP_POLL_MS);
+        if(n > 0) return 0;
+        if(n < 0 && errno != EINTR) return HOST_ERR_HTTP;
+    }
+}
+
+Result httpcInit(u32 sharedmem_size) { return 0; }
+void httpcExit(void) {}
+
+Result httpcOpenContext(httpcContext* context, HTTPC_RequestMethod method, const char* url, u32 use_defaultproxy)
+{
+    if(strncmp(url, "http://", 7)) return HOST_ERR_HTTP;
+
+    struct ctru_host_http* http = calloc(1, sizeof(*http));
+    if(http == NULL) return HOST_ERR_IO;
+
+    const char* host = url + 7;
+    const char* path = strchr(host, '/');
+    if(path == NULL) path = host + strlen(host);
+
+    size_t host_size = path - host;
+    if(host_size >= sizeof(http->host)) host_size = sizeof(http->host) - 1;
+    memcpy(http->host, host, host_size);
+
+    char* port = strchr(http->host, ':');
+    if(port)
+    {
+        *port = 0;
+        strncpy(http->port, port + 1, sizeof(http->port) - 1);
+    }
+    else strcpy(http->port, "80");
+
+    snprintf(http->path, sizeof(http->path), "%s", *path ? path : "/");
+    http->request_size = snprintf(http->request, sizeof(http->request), "GET %s HTTP/1.0\r\nHost: %s:%s\r\n", http->path, http->host, http->port);
+    http->socket = -1;
+
+    context->http = http;
+    return 0;
+}
+
+Result httpcCloseContext(httpcContext* context)
+{
+    if(context->http == NULL) return 0;
+
+    if(context->http->socket >= 0) close(context->http->socket);
+    free(context->http);
+    context->http = NULL;
+
+    return 0;
+}
+
+Result httpcCancelConnection(httpcContext* context)
+{
+    __atomic_store_n(&context->http->cancelled, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+Result httpcAddRequestHeaderField(httpcContext* context, const char* name, const char* value)
+{
+    struct ctru_host_http* http = context->http;
+    int ret = snprintf(&http->request[http->request_size], sizeof(http->request) - http->request_size, "%s: %s\r\n", name, value);
+    if(ret < 0 || (size_t)ret >= sizeof(http->request) - http->request_size) return HOST_ERR_HTTP;
+
+    http->request_size += ret;
+    return 0;
+}
+
+static Result http_connect(struct ctru_host_http* http)
+{
+    struct addrinfo hints = {0}, *addrs = NULL;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if(getaddrinfo(http->host, http->port, &hints, &addrs)) return HOST_ERR_HTTP;
+
+    Result ret = HOST_ERR_HTTP;
+    for(struct addrinfo* addr = addrs; addr && ret != 0; addr = addr->ai_next)
+    {
+        http->socket = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK, addr->ai_protocol);
+        if(http->socket < 0) continue;
+
+        int error = 0;
+        socklen_t error_size = sizeof(error);
+        if(connect(http->socket, addr->ai_addr, addr->ai_addrlen) == 0) ret = 0;
+        else if(errno == EINPROGRESS && http_wait(http, POLLOUT, 0) == 0 &&
+            getsockopt(http->socket, SOL_SOCKET, SO_ERROR, &error, &error_size) == 0 && error == 0) ret = 0;
+
+        if(ret == 0) break;
+        close(http->socket);
+        http->socket = -1;
+    }
+
+    freeaddrinfo(addrs);
+    return ret;
+}
+
+Result httpcBeginRequest(httpcContext* context)
+{
+    struct ctru_host_http* http = context->http;
+
+    Result ret = http_connect(http);
+    if(R_FAILED(ret)) return ret;
+
+    if(http->request_size + 2 >= sizeof(http->request)) return HOST_ERR_HTTP;
+    strcpy(&http->request[http->request_size], "\r\n");
+    http->request_size += 2;
+
+    for(size_t sent = 0; sent < http->request_size;)
+    {
+        ret = http_wait(http, POLLOUT, 0);
+        if(R_FAILED(ret)) return ret;
+
+        ssize_t n = send(http->socket, http->request + sent, http->request_size - sent, MSG_NOSIGNAL);
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if(n <= 0) return HOST_ERR_HTTP;
+        sent += n;
+    }
+
+    return 0;
+}
+
+static const char* http_header(struct ctru_host_http* http, const char* name, size_t* size)
+{
+    size_t name_size = strlen(name);
+
+    for(const char* line = strstr(http->headers, "\r\n"); line && line[2]; line = strstr(line + 2, "\r\n"))
+    {
+        line += 2;
+        if(strncasecmp(line, name, name_size) || line[name_size] != ':') continue;
+
+        const char* start = line + name_size + 1;
+        while(*start == ' ') start++;
+
+        *size = strcspn(start, "\r\n");
+        return start;
+    }
+
+    return NULL;
+}
+
+// Reads up to the end of the headers, on the first call.
+static Result http_answer(struct ctru_host_http* http, u64 deadline_ms)
+{
+    if(http->answered) return 0;
+    if(http->socket < 0) return HOST_ERR_HTTP;
+
+    char* end = NULL;
+    while(end == NULL)
+    {
+        if(http->headers_size == sizeof(http->headers) - 1) return HOST_ERR_HTTP;
+
+        Result ret = http_wait(http, POLLIN, deadline_ms);
+        if(R_FAILED(ret)) return ret;
+
+        ssize_t n = recv(http->socket, http->headers + http->headers_size, sizeof(http->headers) - 1 - http->headers_size, 0);
+        if(n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if(n <= 0) return HOST_ERR_HTTP;
+
+        http->headers_size += n;
+        http->headers[http->headers_size] = 0;
+        end = strstr(http->headers, "\r\n\r\n");
+    }
+
+    http->pending = end + 4;
+    http->pending_size = http->headers + http->headers_size - http->pending;
+    end[2] = 0;
+
+    unsigned long code = 0;
+    if(sscanf(http->headers, "HTTP/%*s %lu", &code) != 1) return HOST_ERR_HTTP;
+    http->status_code = code;
+
+    size_t size = 0;
+    const char* length = http_header(http, "Content-Length", &size);
+    if(length) http->content_size = strtoul(length, NULL, 10);
+
+    http->answered = true;
+    return 0;
+}
+
+Result httpcGetResponseStatusCode(httpcContext* context, u32* out)
+{
+    Result ret = http_answer(context->http, 0);
+    if(R_FAILED(ret)) return ret;
+
+    *out = context->http->status_code;
+    return 0;
+}
+
+Result httpcGetResponseStatusCodeTimeout(httpcContext* context, u32* out, u64 timeout)
+{
+    Result ret = http_answer(context->http, host_now_ms() + timeout / 1000000);
+    if(R_FAILED(ret)) return ret;
+
+    *out = context->http->status_code;
+    return 0;
+}
+
+Result httpcGetResponseHeader(httpcContext* context, const char* name, char* value, u32 valuebuf_maxsize)
+{
+    Result ret = http_answer(context->http, 0);
+    if(R_FAILED(ret)) return ret;
+
+    size_t size = 0;
+    const char* start = http_header(context->http, name, &size);
+    if(start == NULL) return HOST_ERR_HTTP;
+
+    if(size >= valuebuf_maxsize) size = valuebuf_maxsize - 1;
+    memcpy(value, start, size);
+    value[size] = 0;
+    return 0;
+}
+
+Result httpcGetDownloadSizeState(httpcContext* context, u32* downloadedsize, u32* contentsize)
+{
+    Result ret = http_answer(context->http, 0);
+    if(R_FAILED(ret)) return ret;
+
+    if(downloadedsize) *downloadedsize = context->http->downloaded;
+    if(contentsize) *contentsize = context->http->content_size;
+    return 0;
+}
+
+Result httpcReceiveData(httpcContext* context, u8* buffer, u32 size)
+{
+    struct ctru_host_http* http = context->http;
+    u32 received = 0;
+
+    Result ret = http_answer(http, 0);
+    if(R_FAILED(ret)) return ret;
+
+    while(received < size && !http->done)
+    {
+        if(http->content_size && http->downloaded == http->content_size)
+        {
+            http->done = true;
+            break;
+        }
+
+        u32 want = size - received;
+        if(http->content_size && want > http->content_size - http->downloaded) want = http->content_size - http->downloaded;
+
+        ssize_t n;
+        if(http->pending_size)
+        {
+            n = want < http->pending_size ? want : http->pending_size;
+            memcpy(buffer + received, http->pending, n);
+            http->pending += n;
+            http->pending_size -= n;
+        }
+        else
+        {
+            ret = http_wait(http, POLLIN, 0);
+            if(R_FAILED(ret)) return ret;
+
+            n = recv(http->socket, buffer + received, want, 0);
+            if(n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if(n < 0) return HOST_ERR_HTTP;
+            if(n == 0) http->done = true;
+        }
+
+        received += n;
+        http->downloaded += n;
+    }
+
+    if(http->content_size && http->downloaded == http->content_size) http->done = true;
+
+    return http->done ? 0 : (Result)HTTPC_RESULTCODE_DOWNLOADPENDING;
+}
+
+// other services
+
+Result cfguInit(void) { return 0; }
+void cfguExit(void) {}
+Result amInit(void) { return 0; }
+void amExit(void) {}
+
+static const u64* host_titles;
+static u32 host_title_count;
+
+void ctru_host_set_titles(const u64* program_ids, u32 count)
+{
+    host_titles = program_ids;
+    host_title_count = count;
+}
+
+Result AM_GetTitleCount(FS_MediaType mediatype, u32* count)
+{
+    if(mediatype != MEDIATYPE_SD) return HOST_ERR_IO;
+
+    *count = host_title_count;
+    return 0;
+}
+
+Result AM_GetTitleList(u32* titlesRead, FS_MediaType mediatype, u32 titleCount, u64* titleIds)
+{
+    if(mediatype != MEDIATYPE_SD) return HOST_ERR_IO;
+
+    *titlesRead = titleCount < host_title_count ? titleCount : host_title_count;
+    memcpy(titleIds, host_titles, *titlesRead * sizeof(u64));
+    return 0;
+}
+
+// no updates are installed
+Result AM_GetTitleInfo(FS_MediaType mediatype, u32 titleCount, u64* titleIds, AM_TitleEntry* titleInfo)
+{
+    return HOST_ERR_IO;
+}
@@ -0,0 +1,182 @@
+#ifndef _CTRU_HOST_3DS_H_
+#define _CTRU_HOST_3DS_H_
+
+// Host stand-in for the parts of libctru the install pipeline uses, so that
+// source/install.c and friends can be built and benchmarked on a PC.
+// "romfs:/" and "sdmc:/" map to directories and httpc is a plain HTTP/1.0
+// client (see ctru_host.c).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef s32 Result;
+typedef u32 Handle;
+
+#define R_SUCCEEDED(res) ((res) >= 0)
+#define R_FAILED(res) ((res) < 0)
+
+#define U64_MAX UINT64_MAX
+#define CUR_THREAD_HANDLE 0xFFFF8000
+#define SYSCLOCK_ARM11 268111856LL
+
+// svc
+
+Result svcCloseHandle(Handle handle);
+Result svcGetThreadPriority(s32* out, Handle handle);
+Result svcGetThreadId(u32* out, Handle handle);
+u64 svcGetSystemTick(void);
+Result srvGetServiceHandleDirect(Handle* out, const char* name);
+// the host has no clock to raise
+void osSetSpeedupEnable(bool enable);
+
+// synchronization and threads
+
+typedef pthread_mutex_t LightLock;
+
+void LightLock_Init(LightLock* lock);
+void LightLock_Lock(LightLock* lock);
+void LightLock_Unlock(LightLock* lock);
+
+typedef pthread_cond_t CondVar;
+
+void CondVar_Init(CondVar* cv);
+void CondVar_Wait(CondVar* cv, LightLock* lock);
+// non-zero when it timed out
+int CondVar_WaitTimeout(CondVar* cv, LightLock* lock, s64 timeout_ns);
+void CondVar_Signal(CondVar* cv);
+void CondVar_Broadcast(CondVar* cv);
+
+typedef struct ctru_host_thread* Thread;
+typedef void (*ThreadFunc)(void* arg);
+
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stack_size, int prio, int affinity, bool detached);
+Result threadJoin(Thread thread, u64 timeout_ns);
+void threadFree(Thread thread);
+
+// fs, the save archive itself is source/saveio.c's directory backend
+
+typedef enum
+{
+    MEDIATYPE_NAND = 0,
+    MEDIATYPE_SD = 1,
+    MEDIATYPE_GAME_CARD = 2,
+} FS_MediaType;
+
+typedef enum
+{
+    ARCHIVE_ROMFS = 0x3,
+    ARCHIVE_SDMC = 0x9,
+} FS_ArchiveID;
+
+typedef enum
+{
+    PATH_INVALID = 0,
+    PATH_EMPTY = 1,
+    PATH_BINARY = 2,
+    PATH_ASCII = 3,
+} FS_PathType;
+
+typedef struct {
+    FS_PathType type;
+    u32 size;
+    const void* data;
+} FS_Path;
+
+#define FS_OPEN_READ   (1 << 0)
+#define FS_OPEN_WRITE  (1 << 1)
+#define FS_OPEN_CREATE (1 << 2)
+
+#define FS_WRITE_FLUSH       (1 << 0)
+#define FS_WRITE_UPDATE_TIME (1 << 8)
+
+Result fsInit(void);
+void fsExit(void);
+Result FSUSER_Initialize(Handle session);
+FS_Path fsMakePath(FS_PathType type, const void* path);
+
+// ARCHIVE_ROMFS is a level-3 RomFS image of the configured romfs directory, built on first open
+Result FSUSER_OpenFileDirectly(Handle* out, FS_ArchiveID archiveId, FS_Path archivePath, FS_Path filePath, u32 openFlags, u32 attributes);
+Result FSFILE_Read(Handle handle, u32* bytesRead, u64 offset, void* buffer, u32 size);
+Result FSFILE_Close(Handle handle);
+
+Result romfsInit(void);
+Result romfsExit(void);
+
+// httpc
+
+typedef enum
+{
+    HTTPC_METHOD_GET = 1,
+} HTTPC_RequestMethod;
+
+#define HTTPC_RESULTCODE_DOWNLOADPENDING 0xd840a02b
+#define HTTPC_RESULTCODE_TIMEDOUT 0xd820a069
+
+typedef struct {
+    struct ctru_host_http* http;
+} httpcContext;
+
+Result httpcInit(u32 sharedmem_size);
+void httpcExit(void);
+Result httpcOpenContext(httpcContext* context, HTTPC_RequestMethod method, const char* url, u32 use_defaultproxy);
+Result httpcCloseContext(httpcContext* context);
+Result httpcAddRequestHeaderField(httpcContext* context, const char* name, const char* value);
+Result httpcBeginRequest(httpcContext* context);
+Result httpcGetResponseStatusCode(httpcContext* context, u32* out);
+Result httpcGetResponseStatusCodeTimeout(httpcContext* context, u32* out, u64 timeout);
+// safe to call from another thread while a request on the context blocks, which then fails
+Result httpcCancelConnection(httpcContext* context);
+Result httpcGetResponseHeader(httpcContext* context, const char* name, char* value, u32 valuebuf_maxsize);
+Result httpcGetDownloadSizeState(httpcContext* context, u32* downloadedsize, u32* contentsize);
+Result httpcReceiveData(httpcContext* context, u8* buffer, u32 size);
+
+// other services, which only need to come up and go down
+
+typedef struct {
+    u64 titleID;
+    u64 size;
+    u16 version;
+    u8 unk[6];
+} AM_TitleEntry;
+
+Result cfguInit(void);
+void cfguExit(void);
+Result amInit(void);
+void amExit(void);
+
+// am lists the titles set with ctru_host_set_titles() as installed on SD, and no game card
+Result AM_GetTitleCount(FS_MediaType mediatype, u32* count);
+Result AM_GetTitleList(u32* titlesRead, FS_MediaType mediatype, u32 titleCount, u64* titleIds);
+Result AM_GetTitleInfo(FS_MediaType mediatype, u32 titleCount, u64* titleIds, AM_TitleEntry* titleInfo);
+
+// Where "romfs:/" and "sdmc:/" live on the host.
+void ctru_host_configure(const char* romfs_dir, const char* sdmc_dir);
+// The titles installed on SD, none by default. program_ids has to stay around.
+void ctru_host_set_titles(const u64* program_ids, u32 count);
+
+// libc file calls with "romfs:/" or "sdmc:/" paths are redirected to the configured directories.
+FILE* ctru_host_fopen(const char* path, const char* mode);
+int ctru_host_mkdir(const char* path, mode_t mode);
+int ctru_host_remove(const char* path);
+int ctru_host_rename(const char* old_path, const char* new_path);
+
+#define fopen ctru_host_fopen
+#define mkdir ctru_host_mkdir
+#define remove ctru_host_remove
+#define rename ctru_host_rename
+
+#endif // _CTRU_HOST_3DS_H_
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+# Compiles the memory maps in mmap/{program id}.xml into the binary tables source/memmap.c loads,
+# at romfs/{exploit}/{program id}/memmap.bin for the exploit exploitlist_config lists the title under.
+# A map for a single version, mmap/{program id}_{version}.xml, goes to romfs/{exploit}/{program id}/{version}/.
+#
+# The layout is in source/memmap.h. A map is rejected when its entries overlap (as addresses or as
+# offsets), fall outside [0x100000, data_address + data_size), don't match its <num>, or leave the
+# hook address unmapped.
+#
+#   tools/memmap_compile.py [--mmap mmap] [--romfs romfs] [--check]
+
+import argparse
+import glob
+import os
+import struct
+import sys
+import xml.etree.ElementTree as ET
+
+MAGIC = b"SALTMMAP"
+MAX_RANGES = 16
+# where an application's code is mapped
+CODE_BASE = 0x100000
+HEADER_FIELDS = ("data_address", "data_size", "text_end", "processHookAddress", "processAppCodeAddress", "processLinearOffset")
+
+
+class MapError(Exception):
+    pass
+
+
+def crc32c(data):
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+    return crc ^ 0xFFFFFFFF
+
+
+def number(element, name):
+    child = element.find(name)
+    if child is None or child.text is None:
+        raise MapError("missing <%s>" % name)
+    try:
+        return int(child.text.strip(), 0)
+    except ValueError:
+        raise MapError("<%s> isn't a number: %s" % (name, child.text.strip()))
+
+
+def parse(path):
+    # a map is a <header> and a <map> next to each other, without a root element
+    with open(path, "rb") as f:
+        text = f.read().decode("utf-8")
+    try:
+        root = ET.fromstring("<mmap>%s</mmap>" % text)
+    except ET.ParseError as e:
+        raise MapError(str(e))
+
+    header = root.find("header")
+    entries = root.find("map")
+    if header is None or entries is None:
+        raise MapError("missing <header> or <map>")
+
+    fields = {name: number(header, name) for name in HEADER_FIELDS}
+    ranges = [(number(e, "src"), number(e, "size"), number(e, "dst")) for e in entries.findall("entry")]
+    return fields, number(header, "num"), ranges
+
+
+def validate(fields, num, ranges):
+    if num != len(ranges):
+        raise MapError("<num> is %d but there are %d entries" % (num, len(ranges)))
+    if not 0 < len(ranges) <= MAX_RANGES:
+        raise MapError("%d entries, 1 to %d are supported" % (len(ranges), MAX_RANGES))
+
+    for name, value in fields.items():
+        if not 0 <= value < 1 << 32:
+            raise MapError("%s 0x%X is out of range" % (name, value))
+
+    end = fields["data_address"] + fields["data_size"]
+    for i, (src, size, dst) in enumerate(ranges):
+        if size <= 0:
+            raise MapError("entry %d has size 0x%X" % (i, size))
+        if src < CODE_BASE or src + size > end:
+            raise MapError("entry %d [0x%X, 0x%X) is outside [0x%X, 0x%X)" % (i, src, src + size, CODE_BASE, end))
+        if not (-(1 << 31) <= dst and dst + size <= 1 << 31):
+            raise MapError("entry %d dst %s0x%X is out of range" % (i, "-" if dst < 0 else "", abs(dst)))
+
+    for key, what in ((lambda r: r[0], "addresses"), (lambda r: r[2], "offsets")):
+        ordered = sorted(ranges, key=key)
+        for a, b in zip(ordered, ordered[1:]):
+            if key(a) + a[1] > key(b):
+                raise MapError("entries at src 0x%X and 0x%X overlap as %s" % (a[0], b[0], what))
+
+    if fields["text_end"] > fields["data_address"]:
+        raise MapError("text_end 0x%X is past data_address 0x%X" % (fields["text_end"], fields["data_address"]))
+
+    hook = fields["processHookAddress"]
+    if not any(src <= hook < src + size for src, size, _ in ranges):
+        raise MapError("processHookAddress 0x%X isn't mapped" % hook)
+
+
+def compile_map(fields, ranges):
+    body = b"".join(struct.pack("<IIi", src, size, dst) for src, size, dst in sorted(ranges))
+    header = MAGIC + struct.pack("<II", len(ranges), crc32c(body))
+    header += struct.pack("<6I", *(fields[name] for name in HEADER_FIELDS))
+    return header + body
+
+
+# program id -> exploit name, from exploitlist_config
+def exploits(romfs):
+    owners = {}
+    with open(os.path.join(romfs, "exploitlist_config")) as f:
+        for line in f:
+            words = line.split()
+            for program_id in words[3:]:
+                owners.setdefault(int(program_id, 16), words[0])
+    return owners
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile mmap/*.xml into romfs memory map tables.")
+    parser.add_argument("--mmap", default="mmap", help="directory with the {program id}.xml maps")
+    parser.add_argument("--romfs", default="romfs")
+    parser.add_argument("--check", action="store_true", help="only check that the tables in romfs are up to date")
+    args = parser.parse_args()
+
+    owners = exploits(args.romfs)
+    failed = 0
+
+    for path in sorted(glob.glob(os.path.join(args.mmap, "*.xml"))):
+        name, _, version = os.path.splitext(os.path.basename(path))[0].partition("_")
+        try:
+            program_id = int(name, 16)
+        except ValueError:
+            print("%s: the name isn't a program id" % path, file=sys.stderr)
+            failed += 1
+            continue
+
+        if program_id not in owners:
+            print("%s: no exploit lists %016x" % (path, program_id), file=sys.stderr)
+            failed += 1
+            continue
+
+        try:
+            fields, num, ranges = parse(path)
+            validate(fields, num, ranges)
+        except MapError as e:
+            print("%s: %s" % (path, e), file=sys.stderr)
+            failed += 1
+            continue
+
+        out_dir = os.path.join(args.romfs, owners[program_id], "%016x" % program_id, version)
+        if not os.path.isdir(out_dir):
+            print("%s: there's no %s" % (path, out_dir), file=sys.stderr)
+            failed += 1
+            continue
+
+        table = compile_map(fields, ranges)
+        out = os.path.join(out_dir, "memmap.bin")
+        current = open(out, "rb").read() if os.path.exists(out) else None
+        if current == table:
+            continue
+
+        if args.check:
+            print("%s: out of date, run tools/memmap_compile.py" % out, file=sys.stderr)
+            failed += 1
+            continue
+
+        with open(out, "wb") as f:
+            f.write(table)
+        print("%s -> %s (%d ranges)" % (path, out, len(ranges)))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
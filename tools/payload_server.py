@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+# Local stand-in for the payload server, for testing the installer without smea.mtheall.com.
+#
+# Layout of --root: {root}/{firmware}/*.bin, e.g. "payloads/NEW-11-0-35-32-USA/otherapp_r2.bin".
+# The newest .bin (by mtime) is the current build, older ones are kept as delta bases.
+#
+#   GET /get_payload.php?version={firmware}[&base={sha256}]  -> 302 to /payload/{firmware}
+#   GET /payload/{firmware}
+#     A-IM: saltdiff + X-Base-SHA256 matching the current build -> 304
+#     A-IM: saltdiff + X-Base-SHA256 matching an older build   -> 226 with a SALTDIF1 delta
+#     otherwise                                                -> 200 with the full payload
+# Every payload response carries X-Payload-SHA256 of the current build.
+#
+# Several of them with different --latency stand in for racing mirrors. --corrupt serves every build with its bytes
+# inverted, and the sha256 of that, like a bad mirror whose hash matches what it serves.
+
+import argparse
+import glob
+import hashlib
+import http.server
+import os
+import struct
+import time
+import urllib.parse
+
+DELTA_MAGIC = b"SALTDIF1"
+BLOCK = 16
+
+
+def make_delta(base, target):
+    index = {}
+    for off in range(0, len(base) - BLOCK + 1):
+        index.setdefault(base[off:off + BLOCK], off)
+
+    ops = bytearray()
+    pending = bytearray()
+
+    def flush():
+        if pending:
+            ops.extend(struct.pack("<BI", 1, len(pending)))
+            ops.extend(pending)
+            pending.clear()
+
+    pos = 0
+    while pos < len(target):
+        off = index.get(target[pos:pos + BLOCK]) if pos + BLOCK <= len(target) else None
+        if off is None:
+            pending.append(target[pos])
+            pos += 1
+            continue
+
+        length = BLOCK
+        while pos + length < len(target) and off + length < len(base) and target[pos + length] == base[off + length]:
+            length += 1
+
+        flush()
+        ops.extend(struct.pack("<BII", 0, off, length))
+        pos += length
+
+    flush()
+
+    header = DELTA_MAGIC + struct.pack("<II", len(base), len(target))
+    header += hashlib.sha256(base).digest() + hashlib.sha256(target).digest()
+    return header + bytes(ops)
+
+
+class PayloadHandler(http.server.BaseHTTPRequestHandler):
+    root = "."
+    latency = 0.0
+    corrupt = False
+    deltas = {}
+
+    def builds(self, firmware):
+        paths = sorted(glob.glob(os.path.join(self.root, firmware, "*.bin")), key=os.path.getmtime)
+        builds = [open(p, "rb").read() for p in paths]
+        if self.corrupt:
+            builds = [bytes(b ^ 0xFF for b in build) for build in builds]
+        return builds
+
+    def reply(self, code, body=b"", headers=()):
+        self.send_response(code)
+        for name, value in headers:
+            self.send_header(name, value)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        if self.latency:
+            time.sleep(self.latency)
+
+        url = urllib.parse.urlparse(self.path)
+        query = urllib.parse.parse_qs(url.query)
+
+        if url.path == "/get_payload.php":
+            firmware = query.get("version", [""])[0]
+            if not self.builds(firmware):
+                return self.reply(404)
+            host = self.headers.get("Host", "%s:%d" % self.server.server_address)
+            return self.reply(302, headers=[("Location", "http://%s/payload/%s" % (host, firmware))])
+
+        if url.path.startswith("/payload/"):
+            builds = self.builds(url.path[len("/payload/"):])
+            if not builds:
+                return self.reply(404)
+
+            current = builds[-1]
+            current_hash = hashlib.sha256(current).hexdigest()
+            headers = [("X-Payload-SHA256", current_hash)]
+
+            base_hash = self.headers.get("X-Base-SHA256", "").lower()
+            if "saltdiff" in self.headers.get("A-IM", "") and base_hash:
+                if base_hash == current_hash:
+                    return self.reply(304, headers=headers)
+
+                for base in builds[:-1]:
+                    if hashlib.sha256(base).hexdigest() != base_hash:
+                        continue
+                    key = (base_hash, current_hash)
+                    if key not in self.deltas:
+                        self.deltas[key] = make_delta(base, current)
+                    return self.reply(226, self.deltas[key], headers + [("IM", "saltdiff")])
+
+            return self.reply(200, current, headers)
+
+        self.reply(404)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local stand-in for the payload server.")
+    parser.add_argument("--root", default="payloads", help="directory with {firmware}/*.bin builds")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--latency", type=float, default=0.0, help="seconds to delay every response")
+    parser.add_argument("--corrupt", action="store_true", help="serve every build with its bytes inverted")
+    args = parser.parse_args()
+
+    PayloadHandler.root = args.root
+    PayloadHandler.latency = args.latency
+    PayloadHandler.corrupt = args.corrupt
+    http.server.ThreadingHTTPServer(("", args.port), PayloadHandler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,558 @@
+#!/usr/bin/env python3
+# Packages the romfs/ source tree into the directory the .3dsx's RomFS is built from, see romfs_doc.md.
+#
+# Every config is checked the way the installer parses it: exploitlist_config, each title's config.ini, the save
+# directories its flags ask for and the files their config.ini copies, for every save slot, and each memmap.bin.
+# The save files are then deduplicated by content into assets/{sha256}, LZ11-compressed when that's worth it
+# (which the installer decodes as it reads them), and the save configs are rewritten to point there. Everything
+# else is copied as it is. {out}.index lists every packed file and where it came from.
+#
+# Hashes are kept in {cache}/hashes.txt by path, size and mtime, and compressed assets in {cache}/assets-v1 by
+# content, so only new or changed files are hashed and only new contents compressed, on every core at once. The
+# output is only written where it changed.
+#
+#   tools/romfs_pack.py [--romfs romfs] [--out build/romfs] [--cache build/romfs_cache] [--jobs n] [--check]
+
+import argparse
+import concurrent.futures
+import hashlib
+import os
+import re
+import struct
+import sys
+import time
+
+ASSET_DIR = "assets"
+LZ11_SUFFIX = ".lz11"
+# an asset is only stored compressed when that saves at least this fraction of it
+MIN_SAVING = 0.125
+SLOT_COUNT = 3
+# the installer's line and path buffers
+MAX_LINE = 254
+MAX_NAME = 63
+
+MEMMAP_MAGIC = b"SALTMMAP"
+MEMMAP_MAX_RANGES = 16
+
+LZ11_WINDOW = 0x1000
+LZ11_MAX_MATCH = 0x10110
+LZ11_MIN_MATCH = 3
+LZ11_DEPTH = 64
+# bump when the encoder's output changes, so the cache is rebuilt
+CACHE_VERSION = "assets-v1"
+
+
+class PackError(Exception):
+    pass
+
+
+def crc32c(data):
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82F63B78 if crc & 1 else 0)
+    return crc ^ 0xFFFFFFFF
+
+
+def match_length(data, a, b, limit):
+    length = 0
+    while length + 64 <= limit and data[a + length:a + length + 64] == data[b + length:b + length + 64]:
+        length += 64
+    while length < limit and data[a + length] == data[b + length]:
+        length += 1
+    return length
+
+
+def lz11_token(length, disp):
+    disp -= 1
+    if length <= 0x10:
+        return bytes((((length - 1) << 4) | (disp >> 8), disp & 0xFF))
+    if length <= 0x110:
+        length -= 0x11
+        return bytes((length >> 4, ((length & 0xF) << 4) | (disp >> 8), disp & 0xFF))
+    length -= 0x111
+    return bytes((0x10 | (length >> 12), (length >> 4) & 0xFF, ((length & 0xF) << 4) | (disp >> 8), disp & 0xFF))
+
+
+# Nintendo's LZ11, as source/lzss.c decodes it: greedy matches out of hash chains of the last LZ11_DEPTH positions.
+def lz11_encode(data):
+    size = len(data)
+    if size < 1 << 24:
+        out = bytearray((0x11, size & 0xFF, (size >> 8) & 0xFF, size >> 16))
+    else:
+        out = bytearray(b"\x11\0\0\0" + struct.pack("<I", size))
+
+    chains = {}
+
+    def insert(pos):
+        if pos + LZ11_MIN_MATCH <= size:
+            chain = chains.setdefault(data[pos:pos + LZ11_MIN_MATCH], [])
+            chain.append(pos)
+            if len(chain) > 2 * LZ11_DEPTH:
+                del chain[:LZ11_DEPTH]
+
+    pos = 0
+    flag_pos = 0
+    bit = 0
+    while pos < size:
+        best, best_disp = 0, 0
+        limit = min(LZ11_MAX_MATCH, size - pos)
+        for candidate in reversed(chains.get(data[pos:pos + LZ11_MIN_MATCH], ())[-LZ11_DEPTH:]):
+            if pos - candidate > LZ11_WINDOW:
+                break
+            length = match_length(data, candidate, pos, limit)
+            if length > best:
+                best, best_disp = length, pos - candidate
+                if length == limit:
+                    break
+
+        if bit == 0:
+            flag_pos = len(out)
+            out.append(0)
+            bit = 0x80
+
+        if best >= LZ11_MIN_MATCH:
+            out[flag_pos] |= bit
+            out += lz11_token(best, best_disp)
+            for p in range(pos, pos + best):
+                insert(p)
+            pos += best
+        else:
+            out.append(data[pos])
+            insert(pos)
+            pos += 1
+
+        bit >>= 1
+
+    # the decoders read whole words
+    while len(out) & 3:
+        out.append(0)
+    return bytes(out)
+
+
+def lz11_decode(src):
+    size = src[1] | (src[2] << 8) | (src[3] << 16)
+    pos = 4
+    if size == 0:
+        size = struct.unpack_from("<I", src, 4)[0]
+        pos = 8
+
+    out = bytearray()
+    while len(out) < size:
+        flags = src[pos]
+        pos += 1
+        for bit in range(7, -1, -1):
+            if len(out) >= size:
+                break
+            if not flags & (1 << bit):
+                out.append(src[pos])
+                pos += 1
+                continue
+
+            kind = src[pos] >> 4
+            if kind == 0:
+                length = (((src[pos] & 0xF) << 4) | (src[pos + 1] >> 4)) + 0x11
+                token = 3
+            elif kind == 1:
+                length = (((src[pos] & 0xF) << 12) | (src[pos + 1] << 4) | (src[pos + 2] >> 4)) + 0x111
+                token = 4
+            else:
+                length = kind + 1
+                token = 2
+            disp = (((src[pos + token - 2] & 0xF) << 8) | src[pos + token - 1]) + 1
+            pos += token
+            for _ in range(length):
+                out.append(out[-disp])
+    return bytes(out)
+
+
+# One asset's job, on a worker process: the LZ11 stream when it's worth storing, None when the asset stays raw.
+def compress_asset(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    packed = lz11_encode(data)
+    if lz11_decode(packed) != data:
+        raise PackError("%s: LZ11 doesn't decode back" % path)
+    return packed if len(packed) <= len(data) * (1 - MIN_SAVING) else None
+
+
+class Source:
+    def __init__(self, root, cache):
+        self.root = root
+        self.cache = cache
+        self.files = {}
+        self.hashes = {}
+        self.rehashed = 0
+
+        for directory, dirs, names in os.walk(root):
+            dirs[:] = sorted(d for d in dirs if not d.startswith("."))
+            for name in sorted(names):
+                if name.startswith("."):
+                    continue
+                path = os.path.join(directory, name)
+                self.files[os.path.relpath(path, root).replace(os.sep, "/")] = path
+
+    # sha256 of every file, rehashing only those whose size or mtime changed since the last run
+    def hash_files(self):
+        index = os.path.join(self.cache, "hashes.txt")
+        known = {}
+        if os.path.exists(index):
+            with open(index) as f:
+                for line in f:
+                    fields = line.rstrip("\n").split(" ", 3)
+                    if len(fields) == 4:
+                        known[fields[3]] = (int(fields[0]), int(fields[1]), fields[2])
+
+        for rel, path in self.files.items():
+            st = os.stat(path)
+            entry = known.get(rel)
+            if entry is None or entry[:2] != (st.st_mtime_ns, st.st_size):
+                with open(path, "rb") as f:
+                    entry = (st.st_mtime_ns, st.st_size, hashlib.sha256(f.read()).hexdigest())
+                self.rehashed += 1
+            self.hashes[rel] = entry
+
+        write_if_changed(index, "".join("%d %d %s %s\n" % (*self.hashes[rel], rel) for rel in sorted(self.hashes)).encode())
+
+    def sha(self, rel):
+        return self.hashes[rel][2]
+
+    def size(self, rel):
+        return self.hashes[rel][1]
+
+    def read(self, rel):
+        with open(self.files[rel], "rb") as f:
+            return f.read()
+
+    def lines(self, rel):
+        return self.read(rel).decode("utf-8").splitlines()
+
+    # a "romfs:/" path as the installer sees it, relative to the root
+    def resolve(self, romfs_path):
+        if not romfs_path.startswith("romfs:/"):
+            raise PackError("%s isn't a romfs:/ path" % romfs_path)
+        return romfs_path[len("romfs:/"):].strip("/")
+
+    def is_dir(self, rel):
+        return os.path.isdir(os.path.join(self.root, rel))
+
+
+# "@!dN" for the slot, "@!pXXXXXXXX" for the payload offset, as convert_filepath() expands them
+def expand_path(path, slot, where):
+    embed = None
+    out = ""
+    for i, part in enumerate(path.split("@")):
+        if i == 0 or not part.startswith("!"):
+            out += part if i == 0 else "@" + part
+            continue
+        m = re.match(r"!d([0-9])(.*)$", part) or re.match(r"!p([0-9A-Fa-f]{8})(.*)$", part)
+        if m is None:
+            raise PackError("%s: bad \"@%s\" in %s" % (where, part[:10], path))
+        if part[1] == "d":
+            out += "%0*d" % (int(m.group(1)), slot) + m.group(2)
+        else:
+            embed = int(m.group(1), 16)
+            out += m.group(2)
+    return out, embed
+
+
+class Package:
+    def __init__(self, source):
+        self.source = source
+        self.errors = []
+        # save config -> [(input path, save path)], as they're written in it
+        self.save_configs = {}
+
+    def error(self, where, message):
+        self.errors.append("%s: %s" % (where, message))
+
+    def check_line(self, rel, number, line):
+        if len(line) > MAX_LINE:
+            self.error("%s:%d" % (rel, number), "the line is longer than %d characters" % MAX_LINE)
+
+    def validate(self):
+        src = self.source
+        if "exploitlist_config" not in src.files:
+            self.error("exploitlist_config", "missing")
+            return
+
+        owners = {}
+        for number, line in enumerate(src.lines("exploitlist_config"), 1):
+            where = "exploitlist_config:%d" % number
+            self.check_line("exploitlist_config", number, line)
+            words = line.split()
+            if not words:
+                continue
+            if len(words) < 4:
+                self.error(where, "expected \"{exploitname} {titlename} {flags} {program IDs...}\"")
+                continue
+            exploit, title, flags = words[:3]
+            if len(exploit) > MAX_NAME or len(title) > MAX_NAME:
+                self.error(where, "names are at most %d characters" % MAX_NAME)
+            if not re.match(r"0x[0-9A-Fa-f]+$", flags):
+                self.error(where, "flags %s aren't 0x-prefixed hex" % flags)
+                continue
+            # bits 5-6 pick the payload codec (source/codec.h), 3 isn't one
+            if int(flags, 16) & 0x60 == 0x60:
+                self.error(where, "flags %s name no payload codec" % flags)
+            for program_id in words[3:]:
+                if not re.match(r"[0-9A-Fa-f]{16}$", program_id):
+                    self.error(where, "%s isn't a 16 digit program ID" % program_id)
+                    continue
+                if int(program_id, 16) in owners:
+                    self.error(where, "%s is already listed for %s" % (program_id, owners[int(program_id, 16)]))
+                    continue
+                owners[int(program_id, 16)] = exploit
+                self.validate_title(exploit, program_id.lower(), int(flags, 16))
+
+        for rel in src.files:
+            if rel.endswith("/memmap.bin"):
+                self.validate_memmap(rel)
+
+    def validate_title(self, exploit, program_id, flags):
+        src = self.source
+        rel = "%s/%s/config.ini" % (exploit, program_id)
+        if rel not in src.files:
+            self.error(rel, "missing")
+            return
+
+        section = None
+        remasters = {}
+        updates = []
+        for number, line in enumerate(src.lines(rel), 1):
+            where = "%s:%d" % (rel, number)
+            self.check_line(rel, number, line)
+            if not line:
+                continue
+            if line.startswith("["):
+                section = line
+                if section not in ("[remaster_versions]", "[updatetitle_versions]"):
+                    self.error(where, "unknown section %s" % section)
+                continue
+
+            name, _, value = line.partition("=")
+            if section == "[updatetitle_versions]":
+                if not re.match(r"v[0-9]+$", name) or not re.match(r"[0-9A-Fa-f]{4}$", value):
+                    self.error(where, "expected \"v{titleversion}={remaster_version}\"")
+                    continue
+                updates.append((where, int(value, 16)))
+            elif section == "[remaster_versions]":
+                directory, _, display = value.partition("@")
+                if not re.match(r"[0-9A-Fa-f]{4}$", name) or not display:
+                    self.error(where, "expected \"{remaster_version}={directory}@{display version}\"")
+                    continue
+                if len(directory) > MAX_NAME or len(display) > MAX_NAME:
+                    self.error(where, "the directory and display version are at most %d characters" % MAX_NAME)
+                remasters[int(name, 16)] = directory
+                self.validate_version(where, directory, flags)
+            else:
+                self.error(where, "outside of a section")
+
+        if not remasters:
+            self.error(rel, "no [remaster_versions]")
+        for where, remaster in updates:
+            if remaster not in remasters:
+                self.error(where, "remaster version %04X isn't in [remaster_versions]" % remaster)
+
+    def validate_version(self, where, directory, flags):
+        src = self.source
+        try:
+            version = src.resolve(directory)
+        except PackError as e:
+            self.error(where, str(e))
+            return
+        if not src.is_dir(version):
+            self.error(where, "there's no %s" % directory)
+            return
+
+        savedirs = (["Old3DS", "New3DS"] if flags & 0x2 else []) + (["common"] if flags & 0x4 else [])
+        slots = [0] if flags & 0x10 else range(SLOT_COUNT)
+        for savedir in savedirs:
+            rel = "%s/%s/config.ini" % (version, savedir)
+            if rel in self.save_configs:
+                continue
+            if rel not in src.files:
+                self.error(rel, "missing, the exploit's flags 0x%X use it" % flags)
+                continue
+
+            entries = []
+            for number, line in enumerate(src.lines(rel), 1):
+                line_where = "%s:%d" % (rel, number)
+                self.check_line(rel, number, line)
+                if not line:
+                    continue
+                name, _, value = line.partition("=")
+                if not name or not value:
+                    self.error(line_where, "expected \"{input path}={save path}\"")
+                    continue
+                entries.append((name, value))
+                for slot in slots:
+                    try:
+                        path, _ = expand_path(name, slot, line_where)
+                        save_path, embed = expand_path(value, slot, line_where)
+                    except PackError as e:
+                        self.error(line_where, str(e))
+                        break
+                    input_rel = self.input_path(rel, path)
+                    if input_rel not in src.files:
+                        self.error(line_where, "there's no %s for slot %d" % (input_rel, slot + 1))
+                        break
+                    if src.size(input_rel) == 0:
+                        self.error(line_where, "%s is empty" % input_rel)
+                    if not save_path.startswith("/"):
+                        self.error(line_where, "the save path %s isn't absolute" % save_path)
+                    if embed is not None and embed + 4 >= src.size(input_rel):
+                        self.error(line_where, "the payload offset 0x%X is past the end of %s" % (embed, input_rel))
+            self.save_configs[rel] = entries
+
+    def validate_memmap(self, rel):
+        data = self.source.read(rel)
+        if len(data) < 40 or data[:8] != MEMMAP_MAGIC:
+            self.error(rel, "not a memory map, see tools/memmap_compile.py")
+            return
+        count, crc = struct.unpack_from("<II", data, 8)
+        if not 0 < count <= MEMMAP_MAX_RANGES or len(data) != 40 + count * 12:
+            self.error(rel, "%d ranges don't match its size" % count)
+        elif crc32c(data[40:]) != crc:
+            self.error(rel, "its CRC doesn't match, recompile it with tools/memmap_compile.py")
+
+    # The save configs' inputs that are the same for every slot, which become assets: {source path: sha256}.
+    # Whatever a slot-dependent input names stays where it is.
+    def assets(self):
+        src = self.source
+        moved = {}
+        kept = set()
+
+        for rel, entries in self.save_configs.items():
+            for name, _ in entries:
+                if "@" not in name:
+                    input_rel = self.input_path(rel, name)
+                    moved[input_rel] = src.sha(input_rel)
+                    continue
+                for slot in range(SLOT_COUNT):
+                    kept.add(self.input_path(rel, expand_path(name, slot, rel)[0]))
+
+        return {rel: sha for rel, sha in moved.items() if rel not in kept}
+
+    def input_path(self, config, name):
+        return self.source.resolve(name) if name.startswith("romfs:/") else "%s/%s" % (config.rsplit("/", 1)[0], name)
+
+    # The save config with its asset inputs pointing at their blobs in ASSET_DIR.
+    def rewrite_config(self, rel, assets, blobs):
+        lines = []
+        for name, value in self.save_configs[rel]:
+            input_rel = self.input_path(rel, name)
+            if input_rel in assets:
+                name = "romfs:/%s/%s" % (ASSET_DIR, blobs[assets[input_rel]])
+            lines.append("%s=%s\n" % (name, value))
+        return "".join(lines).encode()
+
+
+def write_if_changed(path, data):
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            if f.read() == data:
+                return False
+    os.makedirs(os.path.dirname(path) or ".", exist_ok=True)
+    with open(path + ".tmp", "wb") as f:
+        f.write(data)
+    os.replace(path + ".tmp", path)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check and package romfs/ for the .3dsx.")
+    parser.add_argument("--romfs", default="romfs")
+    parser.add_argument("--out", default="build/romfs")
+    parser.add_argument("--cache", default="build/romfs_cache")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--check", action="store_true", help="only check the configs, without packaging anything")
+    args = parser.parse_args()
+
+    start = time.time()
+    os.makedirs(os.path.join(args.cache, CACHE_VERSION), exist_ok=True)
+
+    source = Source(args.romfs, args.cache)
+    source.hash_files()
+
+    package = Package(source)
+    package.validate()
+    for error in package.errors:
+        print(error, file=sys.stderr)
+    if package.errors:
+        print("%d error(s) in %s" % (len(package.errors), args.romfs), file=sys.stderr)
+        return 1
+    if args.check:
+        return 0
+
+    # compressed once per content, on every core
+    assets = package.assets()
+    contents = {}
+    for rel, sha in sorted(assets.items()):
+        contents.setdefault(sha, rel)
+
+    stored = {}
+    todo = []
+    for sha, rel in contents.items():
+        base = os.path.join(args.cache, CACHE_VERSION, sha)
+        if os.path.exists(base + LZ11_SUFFIX):
+            stored[sha] = base + LZ11_SUFFIX
+        elif os.path.exists(base + ".raw"):
+            stored[sha] = source.files[rel]
+        else:
+            todo.append(sha)
+
+    if todo:
+        with concurrent.futures.ProcessPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+            for sha, packed in zip(todo, pool.map(compress_asset, [source.files[contents[sha]] for sha in todo])):
+                base = os.path.join(args.cache, CACHE_VERSION, sha)
+                write_if_changed(base + (LZ11_SUFFIX if packed else ".raw"), packed or b"")
+                stored[sha] = base + LZ11_SUFFIX if packed else source.files[contents[sha]]
+
+    blobs = {sha: sha + (LZ11_SUFFIX if path.endswith(LZ11_SUFFIX) else "") for sha, path in stored.items()}
+
+    # packed path -> (contents, or the file they're in, and the source paths they stand for)
+    wanted = {}
+    for rel in source.files:
+        if rel in package.save_configs:
+            wanted[rel] = (package.rewrite_config(rel, assets, blobs), [rel])
+        elif rel not in assets:
+            wanted[rel] = (source.files[rel], [rel])
+    for sha, path in stored.items():
+        wanted["%s/%s" % (ASSET_DIR, blobs[sha])] = (path, sorted(rel for rel in assets if assets[rel] == sha))
+
+    written = 0
+    packed_size = 0
+    index = []
+    for rel, (data, users) in sorted(wanted.items()):
+        if isinstance(data, str):
+            with open(data, "rb") as f:
+                data = f.read()
+        written += write_if_changed(os.path.join(args.out, rel), data)
+        packed_size += len(data)
+        index.append("%s size=%d from=%s\n" % (rel, len(data), ",".join(users)))
+
+    # whatever isn't part of the package anymore
+    removed = 0
+    for directory, dirs, names in os.walk(args.out, topdown=False):
+        for name in names:
+            rel = os.path.relpath(os.path.join(directory, name), args.out).replace(os.sep, "/")
+            if rel not in wanted:
+                os.remove(os.path.join(directory, name))
+                removed += 1
+        if directory != args.out and not os.listdir(directory):
+            os.rmdir(directory)
+
+    write_if_changed(args.out.rstrip("/") + ".index", "".join(index).encode())
+
+    raw_size = sum(source.size(rel) for rel in source.files)
+    print("%s: %d files, %d assets in %d blobs (%d processed now), %d KB -> %d KB, %d written, %d removed, %d rehashed in %.2f s with %d job(s)" % (
+        args.out, len(source.files), len(assets), len(stored), len(todo), raw_size // 1024, packed_size // 1024, written, removed, source.rehashed,
+        time.time() - start, args.jobs))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())